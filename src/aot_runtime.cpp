@@ -0,0 +1,74 @@
+#include "aot_runtime.hpp"
+
+namespace cwt
+{
+  namespace
+  {
+    class aot_function : public lox_callable
+    {
+      public:
+        aot_function(aot_runtime& rt, std::string name, std::size_t arity, aot_runtime::function_t body)
+        : m_rt(rt), m_name(std::move(name)), m_arity(arity), m_body(body)
+        {
+        }
+        std::string to_string() override
+        {
+          std::string s{"<fn "};
+          s.append(m_name);
+          s.append(">");
+          return s;
+        }
+        std::size_t arity() override
+        {
+          return m_arity;
+        }
+        lox_obj call(interpreter&, std::span<const lox_obj> args) override
+        {
+          return m_body(m_rt, args);
+        }
+
+      private:
+        aot_runtime& m_rt;
+        std::string m_name;
+        std::size_t m_arity;
+        aot_runtime::function_t m_body;
+    };
+  }
+
+  aot_runtime::aot_runtime(std::ostream& out) 
+  : m_interpreter(out), m_env(m_interpreter.get_globals_ptr()), m_out(&out)
+  {
+    m_interpreter.set_source_map(&m_sources);
+    // a fiber would have to carry m_env along, yield and sleep stay harmless
+    m_interpreter.define_native("spawn", 1, [](interpreter&, std::span<const lox_obj>) -> lox_obj {
+      throw std::runtime_error("spawn: fibers are not supported in transpiled programs.");
+    });
+  }
+
+  void aot_runtime::add_source(std::string name, std::string text)
+  {
+    m_sources.add(std::move(name), std::move(text));
+  }
+
+  lox_obj aot_runtime::function(const std::string& name, std::size_t arity, function_t body)
+  {
+    std::shared_ptr<lox_callable> f = std::make_shared<aot_function>(*this, name, arity, body);
+    return lox_obj(std::move(f));
+  }
+
+  void aot_runtime::print(const lox_obj& value)
+  {
+    *m_out << value.to_string() << std::endl;
+  }
+
+  lox_obj aot_runtime::unsupported(const char* what)
+  {
+    throw std::runtime_error(what);
+  }
+
+  void aot_runtime::report(const std::exception& e)
+  {
+    report_runtime_error(e, &m_sources);
+  }
+
+} // namespace cwt
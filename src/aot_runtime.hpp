@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <iostream>
+#include <span>
+#include <string>
+
+#include "environment.hpp"
+#include "error.hpp"
+#include "interpreter.hpp"
+#include "lox_obj.hpp"
+#include "return.hpp"
+
+namespace cwt
+{
+  // operands in braces are evaluated left to right, function arguments are not
+  struct aot_operands
+  {
+    lox_obj left;
+    lox_obj right;
+  };
+
+  template<std::size_t N>
+  struct aot_call
+  {
+    lox_obj callee;
+    std::array<lox_obj, N> args;
+  };
+
+  struct aot_store
+  {
+    lox_obj target;
+    lox_obj key;
+    lox_obj value;
+  };
+
+  // what programs written by transpile (transpiler.hpp) run on. variables
+  // live in environments like in the interpreter, which also provides the
+  // operators, calls and builtins.
+  class aot_runtime
+  {
+    public:
+      using function_t = lox_obj (*)(aot_runtime&, std::span<const lox_obj>);
+
+      aot_runtime(std::ostream& out = std::cout);
+
+      // the files of the program, added in their original order so the
+      // locations in the generated code decode as before
+      void add_source(std::string name, std::string text);
+
+      lox_obj get(const std::string& name, source_loc loc) { return create_another(m_env->get(name, loc)); }
+      lox_obj assign(const std::string& name, source_loc loc, lox_obj value)
+      {
+        m_env->assign(name, loc, value);
+        return value;
+      }
+      void define(const std::string& name, const lox_obj& value) { m_env->define(name, value); }
+      lox_obj function(const std::string& name, std::size_t arity, function_t body);
+
+      bool truthy(const lox_obj& value) { return m_interpreter.is_truthy(value); }
+      lox_obj unary(token_type op, source_loc loc, const lox_obj& right) { return m_interpreter.unary(op, loc, right); }
+      lox_obj binary(token_type op, source_loc loc, const aot_operands& operands)
+      {
+        type_feedback feedback = type_feedback::none;
+        return m_interpreter.binary(op, loc, operands.left, operands.right, feedback);
+      }
+      template<std::size_t N>
+      lox_obj call(source_loc loc, const aot_call<N>& c)
+      {
+        return m_interpreter.call(c.callee, c.args, loc);
+      }
+
+      template<std::size_t N>
+      lox_obj array(std::array<lox_obj, N> elements) { return m_interpreter.make_array(elements); }
+      // each key followed by its value
+      template<std::size_t N>
+      lox_obj map(source_loc loc, std::array<lox_obj, N> entries) { return m_interpreter.make_map(entries, loc); }
+      lox_obj index(source_loc loc, const aot_operands& operands) { return m_interpreter.index(operands.left, operands.right, loc); }
+      lox_obj index_set(source_loc loc, aot_store store)
+      {
+        m_interpreter.index_set(store.target, store.key, store.value, loc);
+        return std::move(store.value);
+      }
+
+      void print(const lox_obj& value);
+      [[noreturn]] lox_obj unsupported(const char* what);
+      void report(const std::exception& e);
+
+      // the environment of a block or a function body, for as long as it exists
+      class scope
+      {
+        public:
+          scope(aot_runtime& rt) : m_rt(rt), m_outer(rt.m_env)
+          {
+            m_env.set_enclosing(m_outer);
+            m_rt.m_env = &m_env;
+          }
+          ~scope() { m_rt.m_env = m_outer; }
+          scope(const scope&) = delete;
+          scope& operator=(const scope&) = delete;
+
+        private:
+          aot_runtime& m_rt;
+          environment* m_outer;
+          environment m_env;
+      };
+
+    private:
+      interpreter m_interpreter;
+      environment* m_env;
+      std::ostream* m_out;
+      source_map m_sources;
+  };
+
+} // namespace cwt
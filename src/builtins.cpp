@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "builtins.hpp"
+#include "interpreter.hpp"
+#include "simd_numeric.hpp"
+
+namespace cwt
+{
+  namespace 
+  {
+    using args_t = std::span<const lox_obj>;
+
+    void argument_error(const std::string& fn, std::size_t idx, const std::string& expected)
+    {
+      std::string s{fn};
+      s.append(": argument ");
+      s.append(std::to_string(idx+1));
+      s.append(std::string_view("aeiou").find(expected.front()) == std::string_view::npos ? " must be a " : " must be an ");
+      s.append(expected);
+      s.append(".");
+      throw std::runtime_error(s);
+    }
+
+    double number_arg(const std::string& fn, args_t args, std::size_t idx)
+    {
+      if (args[idx].type() != value_type::number) { argument_error(fn, idx, "number"); }
+      return args[idx].number();
+    }
+
+    std::string string_arg(const std::string& fn, args_t args, std::size_t idx)
+    {
+      if (args[idx].type() != value_type::string) { argument_error(fn, idx, "string"); }
+      return args[idx].string();
+    }
+
+    lox_map& map_arg(const std::string& fn, args_t args, std::size_t idx)
+    {
+      if (args[idx].type() != value_type::map) { argument_error(fn, idx, "map"); }
+      return args[idx].as_map();
+    }
+
+    // the elements of an array of numbers, a boxed one is copied into scratch
+    std::span<const double> numbers_arg(const std::string& fn, args_t args, std::size_t idx, std::vector<double>& scratch)
+    {
+      if (args[idx].type() != value_type::array) { argument_error(fn, idx, "array of numbers"); }
+      const lox_array& a = args[idx].as_array();
+      if (a.numeric()) { return a.numbers(); }
+      scratch.reserve(a.size());
+      for (std::size_t i = 0 ; i < a.size() ; ++i)
+      {
+        const lox_obj v = a.get(i);
+        if (!v.is_number()) { argument_error(fn, idx, "array of numbers"); }
+        scratch.push_back(v.as_number());
+      }
+      return scratch;
+    }
+
+    void check_sizes(const std::string& fn, std::size_t left, std::size_t right)
+    {
+      if (left != right) { throw std::runtime_error(fn + ": arrays must have the same length."); }
+    }
+
+    simd::compare compare_arg(const std::string& fn, args_t args, std::size_t idx)
+    {
+      static constexpr std::pair<std::string_view, simd::compare> ops[] = {
+        {"<", simd::compare::less}, {"<=", simd::compare::less_equal}, {">", simd::compare::greater},
+        {">=", simd::compare::greater_equal}, {"==", simd::compare::equal}, {"!=", simd::compare::not_equal}
+      };
+      const std::string op = string_arg(fn, args, idx);
+      for (const auto& [name, c] : ops)
+      {
+        if (name == op) { return c; }
+      }
+      throw std::runtime_error(fn + ": unknown comparison '" + op + "'.");
+    }
+
+    // x op y for each element, y is an array of the same length or a number
+    void define_elementwise(interpreter& i, const std::string& name, simd::arith op)
+    {
+      i.define_native(name, 2, [name, op](interpreter&, args_t args) -> lox_obj {
+        std::vector<double> scratch;
+        const std::span<const double> x = numbers_arg(name, args, 0, scratch);
+        std::vector<double> out(x.size());
+        if (args[1].type() == value_type::number)
+        {
+          simd::elementwise(op, x, args[1].as_number(), out);
+        }
+        else
+        {
+          if (args[1].type() != value_type::array) { argument_error(name, 1, "number or array of numbers"); }
+          std::vector<double> other;
+          const std::span<const double> y = numbers_arg(name, args, 1, other);
+          check_sizes(name, x.size(), y.size());
+          simd::elementwise(op, x, y, out);
+        }
+        return lox_obj(std::make_shared<lox_array>(std::move(out)));
+      });
+    }
+
+    template<typename Func>
+    void define_math(interpreter& i, const std::string& name, Func func)
+    {
+      i.define_native(name, 1, [name, func](interpreter&, args_t args) -> lox_obj {
+        return func(number_arg(name, args, 0));
+      });
+    }
+  } // namespace 
+
+  void define_builtins(interpreter& i)
+  {
+    i.define_native("clock", 0, [](interpreter&, args_t) -> lox_obj {
+      using namespace std::chrono;
+      return duration<double>(steady_clock::now().time_since_epoch()).count();
+    });
+
+    i.define_native("len", 1, [](interpreter&, args_t args) -> lox_obj {
+      if (args[0].type() == value_type::array) { return static_cast<double>(args[0].as_array().size()); }
+      if (args[0].type() == value_type::map) { return static_cast<double>(args[0].as_map().size()); }
+      if (args[0].type() != value_type::string) { argument_error("len", 0, "string, array or map"); }
+      return static_cast<double>(args[0].string().size());
+    });
+    i.define_native("push", 2, [](interpreter&, args_t args) -> lox_obj {
+      if (args[0].type() != value_type::array) { argument_error("push", 0, "array"); }
+      args[0].as_array().push(args[1]);
+      return lox_obj();
+    });
+
+    // keys and values come in the order they were added
+    i.define_native("keys", 1, [](interpreter&, args_t args) -> lox_obj {
+      std::vector<lox_obj> keys;
+      map_arg("keys", args, 0).for_each([&keys](const lox_obj& key, const lox_obj&) { keys.push_back(create_another(key)); });
+      return lox_obj(std::make_shared<lox_array>(keys));
+    });
+    i.define_native("values", 1, [](interpreter&, args_t args) -> lox_obj {
+      std::vector<lox_obj> values;
+      map_arg("values", args, 0).for_each([&values](const lox_obj&, const lox_obj& value) { values.push_back(create_another(value)); });
+      return lox_obj(std::make_shared<lox_array>(values));
+    });
+    i.define_native("has", 2, [](interpreter&, args_t args) -> lox_obj {
+      return map_arg("has", args, 0).find(args[1]) != nullptr;
+    });
+    i.define_native("remove", 2, [](interpreter&, args_t args) -> lox_obj {
+      return map_arg("remove", args, 0).erase(args[1]);
+    });
+    // bulk operations on arrays of numbers, one native call instead of a
+    // loop in lox
+    i.define_native("sum", 1, [](interpreter&, args_t args) -> lox_obj {
+      std::vector<double> scratch;
+      return simd::sum(numbers_arg("sum", args, 0, scratch));
+    });
+    i.define_native("amin", 1, [](interpreter&, args_t args) -> lox_obj {
+      std::vector<double> scratch;
+      const std::span<const double> x = numbers_arg("amin", args, 0, scratch);
+      return x.empty() ? lox_obj() : lox_obj(simd::min(x));
+    });
+    i.define_native("amax", 1, [](interpreter&, args_t args) -> lox_obj {
+      std::vector<double> scratch;
+      const std::span<const double> x = numbers_arg("amax", args, 0, scratch);
+      return x.empty() ? lox_obj() : lox_obj(simd::max(x));
+    });
+    i.define_native("dot", 2, [](interpreter&, args_t args) -> lox_obj {
+      std::vector<double> left;
+      std::vector<double> right;
+      const std::span<const double> x = numbers_arg("dot", args, 0, left);
+      const std::span<const double> y = numbers_arg("dot", args, 1, right);
+      check_sizes("dot", x.size(), y.size());
+      return simd::dot(x, y);
+    });
+    // y = a * x + y in place
+    i.define_native("axpy", 3, [](interpreter&, args_t args) -> lox_obj {
+      const double a = number_arg("axpy", args, 0);
+      std::vector<double> scratch;
+      std::vector<double> boxed;
+      const std::span<const double> x = numbers_arg("axpy", args, 1, scratch);
+      numbers_arg("axpy", args, 2, boxed);
+      lox_array& y = args[2].as_array();
+      check_sizes("axpy", x.size(), y.size());
+      if (y.numeric())
+      {
+        simd::axpy(a, x, y.numbers());
+        return lox_obj();
+      }
+      simd::axpy(a, x, boxed);
+      for (std::size_t i = 0 ; i < boxed.size() ; ++i)
+      {
+        y.set(i, boxed[i]);
+      }
+      return lox_obj();
+    });
+    define_elementwise(i, "vadd", simd::arith::add);
+    define_elementwise(i, "vsub", simd::arith::sub);
+    define_elementwise(i, "vmul", simd::arith::mul);
+    define_elementwise(i, "vdiv", simd::arith::div);
+    // count(a, ">", 0) is how many elements are greater than 0
+    i.define_native("count", 3, [](interpreter&, args_t args) -> lox_obj {
+      std::vector<double> scratch;
+      const std::span<const double> x = numbers_arg("count", args, 0, scratch);
+      const simd::compare op = compare_arg("count", args, 1);
+      return static_cast<double>(simd::count_if(op, x, number_arg("count", args, 2)));
+    });
+
+    i.define_native("substr", 3, [](interpreter&, args_t args) -> lox_obj {
+      std::string s = string_arg("substr", args, 0);
+      double start = number_arg("substr", args, 1);
+      double count = number_arg("substr", args, 2);
+      // nan fails every comparison, check it before the casts
+      if (!std::isfinite(start) || !std::isfinite(count) || start != std::floor(start) || count != std::floor(count))
+      {
+        throw std::runtime_error("substr: start and count must be whole numbers.");
+      }
+      if (start < 0 || count < 0 || start > s.size()) 
+      {
+        throw std::runtime_error("substr: range out of bounds.");
+      }
+      count = std::min(count, static_cast<double>(s.size()) - start);
+      return s.substr(static_cast<std::size_t>(start), static_cast<std::size_t>(count));
+    });
+
+    i.define_native("str", 1, [](interpreter&, args_t args) -> lox_obj {
+      return args[0].to_string();
+    });
+    i.define_native("num", 1, [](interpreter&, args_t args) -> lox_obj {
+      std::string s = string_arg("num", args, 0);
+      std::size_t parsed = 0;
+      double value = 0;
+      try
+      {
+        value = std::stod(s, &parsed);
+      }
+      catch(const std::exception&)
+      {
+        parsed = 0;
+      }
+      if (parsed == 0 || parsed != s.size()) { return lox_obj(); }
+      return value;
+    });
+
+    define_math(i, "abs", [](double x) { return std::fabs(x); });
+    define_math(i, "sqrt", [](double x) { return std::sqrt(x); });
+    define_math(i, "floor", [](double x) { return std::floor(x); });
+    define_math(i, "ceil", [](double x) { return std::ceil(x); });
+    define_math(i, "round", [](double x) { return std::round(x); });
+    define_math(i, "sin", [](double x) { return std::sin(x); });
+    define_math(i, "cos", [](double x) { return std::cos(x); });
+    define_math(i, "exp", [](double x) { return std::exp(x); });
+    define_math(i, "log", [](double x) { return std::log(x); });
+
+    i.define_native("pow", 2, [](interpreter&, args_t args) -> lox_obj {
+      return std::pow(number_arg("pow", args, 0), number_arg("pow", args, 1));
+    });
+    i.define_native("min", 2, [](interpreter&, args_t args) -> lox_obj {
+      return std::min(number_arg("min", args, 0), number_arg("min", args, 1));
+    });
+    i.define_native("max", 2, [](interpreter&, args_t args) -> lox_obj {
+      return std::max(number_arg("max", args, 0), number_arg("max", args, 1));
+    });
+
+    i.define_native("spawn", 1, [](interpreter& interp, args_t args) -> lox_obj {
+      if (args[0].type() != value_type::callable) { argument_error("spawn", 0, "function"); }
+      std::shared_ptr<lox_callable> f = args[0].callable();
+      if (f->arity() != 0) { throw std::runtime_error("spawn: the function must not take arguments."); }
+      return static_cast<double>(interp.get_scheduler().spawn(std::move(f)));
+    });
+    i.define_native("yield", 0, [](interpreter& interp, args_t) -> lox_obj {
+      interp.get_scheduler().yield();
+      return lox_obj();
+    });
+    i.define_native("sleep", 1, [](interpreter& interp, args_t args) -> lox_obj {
+      interp.get_scheduler().sleep(number_arg("sleep", args, 0));
+      return lox_obj();
+    });
+  }
+
+} // namespace cwt
@@ -0,0 +1,12 @@
+#pragma once 
+
+namespace cwt
+{
+  class interpreter;
+
+  // registers clock(), string, array, map and math functions, bulk numeric
+  // operations on arrays and the fiber calls spawn(), yield() and sleep()
+  // in the interpreters globals
+  void define_builtins(interpreter& i);
+
+} // namespace cwt
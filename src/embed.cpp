@@ -0,0 +1,77 @@
+#include <stdexcept>
+
+#include "embed.hpp"
+#include "error.hpp"
+#include "parser.hpp"
+#include "scanner.hpp"
+
+namespace cwt
+{
+
+script_function::script_function(interpreter& interpreter, std::shared_ptr<lox_callable> callable)
+: m_interpreter(&interpreter), m_callable(std::move(callable))
+{
+
+}
+std::size_t script_function::arity() const
+{
+  return m_callable->arity();
+}
+lox_obj script_function::call(std::span<const lox_obj> args)
+{
+  if (args.size() != m_callable->arity())
+  {
+    std::string s{"Expected "};
+    s.append(std::to_string(m_callable->arity()));
+    s.append(" arguments but got ");
+    s.append(std::to_string(args.size()));
+    s.append(".");
+    throw std::runtime_error(s);
+  }
+  return m_callable->call(*m_interpreter, args);
+}
+
+script::script(const std::string& src)
+{
+  reset_errors();
+  const source_loc base = m_sources.add("<script>", src);
+  m_interpreter.set_source_map(&m_sources);
+  scanner scanner(src);
+  token_stream tokens = scanner.scan_stream();
+  parser<lox_obj> parser(tokens, base);
+  m_statements = parser.parse();
+  if (had_error())
+  {
+    throw std::runtime_error("script has syntax errors.");
+  }
+}
+void script::run()
+{
+  m_interpreter.execute(m_statements);
+}
+bool script::has_global(const std::string& name)
+{
+  return m_interpreter.get_globals_ptr()->contains(name);
+}
+lox_obj script::global(const std::string& name)
+{
+  return create_another(m_interpreter.get_globals_ptr()->get(name, source_loc{}));
+}
+script_function script::function(const std::string& name)
+{
+  lox_obj value = global(name);
+  if (value.type() != value_type::callable)
+  {
+    std::string s{"\'"};
+    s.append(name);
+    s.append("\' is not a function.");
+    throw std::runtime_error(s);
+  }
+  return script_function(m_interpreter, value.callable());
+}
+void script::define_native(const std::string& name, std::size_t arity, lox_native::function_t func)
+{
+  m_interpreter.define_native(name, arity, std::move(func));
+}
+
+} // namespace cwt
@@ -0,0 +1,57 @@
+#pragma once 
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "interpreter.hpp"
+
+namespace cwt
+{
+  // handle to a global lox function, resolved once and called many times
+  class script_function
+  {
+    public:
+      script_function(interpreter& interpreter, std::shared_ptr<lox_callable> callable);
+
+      std::size_t arity() const;
+      lox_obj call(std::span<const lox_obj> args);
+
+      template<typename... Args>
+      lox_obj operator()(Args... args)
+      {
+        std::array<lox_obj, sizeof...(Args)> buffer{lox_obj(args)...};
+        return call(std::span<const lox_obj>(buffer.data(), buffer.size()));
+      }
+
+    private:
+      interpreter* m_interpreter;
+      std::shared_ptr<lox_callable> m_callable;
+  };
+
+  // a loaded program: scanned and parsed on construction, run() executes the 
+  // top level once. the syntax tree is kept alive for as long as functions may be called.
+  class script
+  {
+    using stmt_t = std::unique_ptr<lox_statement<lox_obj>>;
+
+    public:
+      explicit script(const std::string& src);
+      script(const script&) = delete;
+      script& operator=(const script&) = delete;
+
+      void run();
+
+      bool has_global(const std::string& name);
+      lox_obj global(const std::string& name);
+      script_function function(const std::string& name);
+      void define_native(const std::string& name, std::size_t arity, lox_native::function_t func);
+
+    private:
+      source_map m_sources;
+      std::vector<stmt_t> m_statements;
+      interpreter m_interpreter;
+  };
+
+} // namespace cwt
@@ -1,5 +1,6 @@
 #include "environment.hpp"
 #include "error.hpp"
+#include "metrics.hpp"
 
 namespace cwt
 {
@@ -13,40 +14,72 @@ void environment::define(const std::string& name, const lox_obj& value)
 {
   // this allows redefinition of variables, 
   // add check if var already exists here ... 
-  m_data[name] = create_another(value);
+  LOX_COUNT(hash_probes);
+  if (m_spare.empty() || m_data.contains(name))
+  {
+    m_data[name] = create_another(value);
+    return;
+  }
+  map_t::node_type node = std::move(m_spare.back());
+  m_spare.pop_back();
+  node.key() = name;
+  node.mapped() = create_another(value);
+  m_data.insert(std::move(node));
 }
-void environment::assign(token name, const lox_obj& value)
+void environment::assign(const std::string& name, source_loc loc, const lox_obj& value)
 {
-  if (m_data.count(name.lexeme))
+  LOX_COUNT(hash_probes);
+  if (m_data.count(name))
   {
-    m_data[name.lexeme] = create_another(value);
+    LOX_COUNT(hash_probes);
+    m_data[name] = create_another(value);
   }
   else if (m_enclosing)
   {
-    m_enclosing->assign(name, value);
+    LOX_COUNT(lookup_depth);
+    m_enclosing->assign(name, loc, value);
   }
   else 
   {
     std::string s{"Undefined variable \'"};
-    s.append(name.lexeme);
+    s.append(name);
     s.append("\'.");
-    runtime_error(name, s);
+    runtime_error(loc, s);
   }
 }
-lox_obj& environment::get(token t)
+lox_obj& environment::get(const std::string& name, source_loc loc)
 {
-  if (m_data.count(t.lexeme))
+  LOX_COUNT(hash_probes);
+  if (m_data.count(name))
   {
-    return m_data[t.lexeme];
+    LOX_COUNT(hash_probes);
+    return m_data[name];
   }
   if (m_enclosing) 
   {
-    return m_enclosing->get(t);
+    LOX_COUNT(lookup_depth);
+    return m_enclosing->get(name, loc);
   }
   std::string s{"Undefined variable \'"};
-  s.append(t.lexeme);
+  s.append(name);
   s.append("\'.");
-  runtime_error(t, s);
+  runtime_error(loc, s);
+}
+
+bool environment::contains(const std::string& name) const
+{
+  return m_data.count(name) > 0;
+}
+
+void environment::recycle()
+{
+  while (!m_data.empty())
+  {
+    map_t::node_type node = m_data.extract(m_data.begin());
+    node.mapped() = lox_obj();
+    m_spare.push_back(std::move(node));
+  }
+  m_enclosing = nullptr;
 }
 
 } // namespace cwt
@@ -2,8 +2,9 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 
-#include "token.hpp"
+#include "source_map.hpp"
 #include "lox_obj.hpp"
 
 namespace cwt
@@ -13,10 +14,25 @@ namespace cwt
     public:
       void set_enclosing(environment* env) ;
       void define(const std::string& name, const lox_obj& value);
-      void assign(token name, const lox_obj& value);
-      lox_obj& get(token t);
+      void assign(const std::string& name, source_loc loc, const lox_obj& value);
+      lox_obj& get(const std::string& name, source_loc loc);
+      bool contains(const std::string& name) const;
+      // forgets every variable and the enclosing environment but keeps the
+      // storage of the variables, defining them again does not allocate
+      void recycle();
+      // every variable of this environment, not of the enclosing ones, in no particular order
+      template<typename Func>
+      void for_each(Func&& func) const
+      {
+        for (const auto& [name, value] : m_data)
+        {
+          func(name, value);
+        }
+      }
     private:
-      std::unordered_map<std::string, lox_obj> m_data;
-      environment* m_enclosing;
+      using map_t = std::unordered_map<std::string, lox_obj>;
+      map_t m_data;
+      std::vector<map_t::node_type> m_spare;
+      environment* m_enclosing = nullptr;
   };
 } // namespace cwt
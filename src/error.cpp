@@ -2,24 +2,93 @@
 #include <iostream> 
 
 #include "error.hpp"
+#include "metrics.hpp"
 
 namespace cwt 
 {
-  bool has_error = false;
-  bool has_runtime_error = false; 
+  namespace 
+  {
+    thread_local error_state thread_state;
+    thread_local error_state* current_state = &thread_state;
+  } // namespace 
+
+  scoped_error_state::scoped_error_state(error_state& state) : m_prev(current_state)
+  {
+    current_state = &state;
+  }
+  scoped_error_state::~scoped_error_state()
+  {
+    current_state = m_prev;
+  }
+
+  error_state& current_error_state()
+  {
+    return *current_state;
+  }
+
+  std::ostream& error_stream()
+  {
+    return current_state->diagnostics ? *current_state->diagnostics : std::cerr;
+  }
+
+  lox_error::lox_error(source_loc loc, const std::string& msg) : std::runtime_error(msg), m_loc(loc) {}
+
+  source_loc lox_error::loc() const noexcept
+  {
+    return m_loc;
+  }
+
+  budget_exhausted::budget_exhausted(source_loc loc, std::string msg) : m_loc(loc), m_msg(std::move(msg)) {}
+
+  const char* budget_exhausted::what() const noexcept
+  {
+    return m_msg.c_str();
+  }
+
+  source_loc budget_exhausted::loc() const noexcept
+  {
+    return m_loc;
+  }
+
+  void runtime_error(source_loc loc, const std::string& msg)
+  {
+    current_state->has_runtime_error = true;
+    LOX_COUNT(errors_thrown);
+    throw lox_error(loc, msg);
+  }
+
+  void report_runtime_error(const std::exception& e, const source_map* sources)
+  {
+    const lox_error* err = dynamic_cast<const lox_error*>(&e);
+    if (err && sources && sources->decode(err->loc()))
+    {
+      error_stream() << "[RUNTIME] " << sources->describe(err->loc()) << ": " << e.what() << '\n' 
+                     << sources->excerpt(err->loc()) << '\n';
+    }
+    else 
+    {
+      error_stream() << "[RUNTIME] " << e.what() << '\n';
+    }
+  }
 
-  void runtime_error(const token& t, const std::string& msg)
+  void report_budget_exhausted(const budget_exhausted& e, const source_map* sources)
   {
-    std::string s{t.to_string()};
-    s.append(" Operands must be two numbers or two strings.");
-    has_runtime_error = true;
-    throw std::runtime_error(s);
+    current_state->has_runtime_error = true;
+    if (sources && sources->decode(e.loc()))
+    {
+      error_stream() << "[BUDGET] " << sources->describe(e.loc()) << ": " << e.what() << '\n'
+                     << sources->excerpt(e.loc()) << '\n';
+    }
+    else
+    {
+      error_stream() << "[BUDGET] " << e.what() << '\n';
+    }
   }
 
   void report(const std::size_t line, const std::string& where, const std::string& msg)
   {
-    std::cerr << "[REPORT] " << where << ':' << line << ": " << msg << '\n';
-    has_error = true;
+    error_stream() << "[REPORT] " << where << ':' << line << ": " << msg << '\n';
+    current_state->has_error = true;
   }
 
   void error(const std::size_t line, const std::string& msg) 
@@ -27,4 +96,20 @@ namespace cwt
     report(line, "", msg);
   }
 
+  bool had_error()
+  {
+    return current_state->has_error;
+  }
+
+  bool had_runtime_error()
+  {
+    return current_state->has_runtime_error;
+  }
+
+  void reset_errors()
+  {
+    current_state->has_error = false;
+    current_state->has_runtime_error = false;
+  }
+
 } // namespace cwt
@@ -1,13 +1,68 @@
 #pragma once 
 
+#include <ostream>
+#include <stdexcept>
 #include <string>
+#include "source_map.hpp"
 #include "token.hpp"
 
 namespace cwt
 {
+  // error flags and diagnostics sink of one isolate. every thread starts 
+  // with its own state, scoped_error_state rebinds it for a while.
+  struct error_state
+  {
+    bool has_error = false;
+    bool has_runtime_error = false;
+    std::ostream* diagnostics = nullptr; 
+  };
 
-  void runtime_error(const token& t, const std::string& msg);
+  class scoped_error_state
+  {
+    public:
+      scoped_error_state(error_state& state);
+      ~scoped_error_state();
+      scoped_error_state(const scoped_error_state&) = delete;
+      scoped_error_state& operator=(const scoped_error_state&) = delete;
+    private:
+      error_state* m_prev;
+  };
+
+  // runtime error of a lox program, the location is decoded when it is reported
+  class lox_error : public std::runtime_error
+  {
+    public:
+      lox_error(source_loc loc, const std::string& msg);
+      source_loc loc() const noexcept;
+    private:
+      source_loc m_loc;
+  };
+
+  // a run went over its budget (meter.hpp). it is no std::exception, so
+  // blocks and fibers let it pass and the whole run stops
+  class budget_exhausted
+  {
+    public:
+      budget_exhausted(source_loc loc, std::string msg);
+      const char* what() const noexcept;
+      source_loc loc() const noexcept;
+    private:
+      source_loc m_loc;
+      std::string m_msg;
+  };
+
+  error_state& current_error_state();
+  std::ostream& error_stream();
+
+  [[noreturn]] void runtime_error(source_loc loc, const std::string& msg);
+  // prints a caught error, with position and source excerpt if sources are given
+  void report_runtime_error(const std::exception& e, const source_map* sources);
+  void report_budget_exhausted(const budget_exhausted& e, const source_map* sources);
   void report(const std::size_t line, const std::string& where, const std::string& msg);
   void error(const std::size_t line, const std::string& msg);
 
+  bool had_error();
+  bool had_runtime_error();
+  void reset_errors();
+
 } // namespace cwt
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cstdint>
+
 #include "token.hpp"
 #include "lox_obj.hpp"
+#include "source_map.hpp"
 
 
 namespace cwt
@@ -19,6 +22,11 @@ namespace cwt
   template<typename T> struct expr_this;
   template<typename T> struct expr_unary;
   template<typename T> struct expr_variable;
+  template<typename T> struct expr_cached;
+  template<typename T> struct expr_array;
+  template<typename T> struct expr_index;
+  template<typename T> struct expr_index_set;
+  template<typename T> struct expr_map;
 
   template<typename T>
   struct expr_visitor 
@@ -36,34 +44,53 @@ namespace cwt
     virtual T visit(const expr_this<T>& e) { throw std::runtime_error("expr_visitor not implemented"); }
     virtual T visit(const expr_unary<T>& e) { throw std::runtime_error("expr_visitor not implemented"); }
     virtual T visit(const expr_variable<T>& e) { throw std::runtime_error("expr_visitor not implemented"); }
+    virtual T visit(const expr_cached<T>& e) { throw std::runtime_error("expr_visitor not implemented"); }
+    virtual T visit(const expr_array<T>& e) { throw std::runtime_error("expr_visitor not implemented"); }
+    virtual T visit(const expr_index<T>& e) { throw std::runtime_error("expr_visitor not implemented"); }
+    virtual T visit(const expr_index_set<T>& e) { throw std::runtime_error("expr_visitor not implemented"); }
+    virtual T visit(const expr_map<T>& e) { throw std::runtime_error("expr_visitor not implemented"); }
   };
 
   enum class expr_type
   {
-    _assign = 0, _binary, _call, _get, _grouping, _literal, _logical, _set, _super, _this, _unary, _variable
+    _assign = 0, _binary, _call, _get, _grouping, _literal, _logical, _set, _super, _this, _unary, _variable, _cached,
+    _array, _index, _index_set, _map
+  };
+
+  // what the operands of a node turned out to be so far. a node starts 
+  // out optimistic and falls back to generic for good once a non-number 
+  // shows up
+  enum class type_feedback : std::uint8_t
+  {
+    none = 0, number, generic
   };
 
   template<typename T>
   struct lox_expression
   {
+    lox_expression(source_loc loc, expr_type kind) : loc(loc), kind(kind) {}
     virtual ~lox_expression() = default;
     virtual T accept(expr_visitor<T>& v) = 0 ;
-    virtual expr_type type() = 0;
+    // stored in the node, so evaluators can switch on it without a virtual call
+    expr_type type() const noexcept { return kind; }
+
+    source_loc loc;
+    expr_type kind;
   };
 
   template<typename T> 
   struct expr_assign : public lox_expression<T>
   {
     using expr_t = std::unique_ptr<lox_expression<T>>;
-    expr_assign(token name, expr_t value) : name(name), value(std::move(value)) {}
+    expr_assign(std::string name, expr_t value, source_loc loc) 
+    : lox_expression<T>(loc, expr_type::_assign), name(std::move(name)), value(std::move(value)) {}
 
-    expr_type type() { return expr_type::_assign; };
     T accept(expr_visitor<T>& v) override
     {
       return v.visit(*this);
     } 
 
-    token name;
+    std::string name;
     expr_t value;
   };
 
@@ -71,32 +98,32 @@ namespace cwt
   struct expr_binary : public lox_expression<T>
   {
     using expr_t = std::unique_ptr<lox_expression<T>>;
-    expr_binary(expr_t left, token op, expr_t right) : left(std::move(left)), op(op), right(std::move(right)) {}
+    expr_binary(expr_t left, token_type op, expr_t right, source_loc loc) 
+    : lox_expression<T>(loc, expr_type::_binary), left(std::move(left)), op(op), right(std::move(right)) {}
 
-    expr_type type() { return expr_type::_binary; };
     T accept(expr_visitor<T>& v) override
     {
       return v.visit(*this);
     }
     expr_t left;
-    token op;
+    token_type op;
     expr_t right;
+    mutable type_feedback feedback = type_feedback::none;
   };
 
   template<typename T>
   struct expr_call : public lox_expression<T>
   {
     using expr_t = std::unique_ptr<lox_expression<T>>;
-    expr_call(expr_t callee, token paren, std::vector<expr_t> args) : callee(std::move(callee)), paren(paren), args(std::move(args)) {}
+    expr_call(expr_t callee, std::vector<expr_t> args, source_loc loc) 
+    : lox_expression<T>(loc, expr_type::_call), callee(std::move(callee)), args(std::move(args)) {}
 
-    expr_type type() { return expr_type::_call; };
     T accept(expr_visitor<T>& v) override
     {
       return v.visit(*this);
     }
 
     expr_t callee;
-    token paren;
     std::vector<expr_t> args; 
   };
 
@@ -104,25 +131,24 @@ namespace cwt
   struct expr_get : public lox_expression<T>
   {
     using expr_t = std::unique_ptr<lox_expression<T>>;
-    expr_get(expr_t obj, token name) : obj(std::move(obj)), name(name) {}
+    expr_get(expr_t obj, std::string name, source_loc loc) 
+    : lox_expression<T>(loc, expr_type::_get), obj(std::move(obj)), name(std::move(name)) {}
 
-    expr_type type() { return expr_type::_get; };
     T accept(expr_visitor<T>& v) override
     {
       return v.visit(*this);
     }
 
     expr_t obj;
-    token name; 
+    std::string name; 
   };
 
   template<typename T>
   struct expr_grouping : public lox_expression<T>
   {
     using expr_t = std::unique_ptr<lox_expression<T>>;
-    expr_grouping(expr_t expr) : expr(std::move(expr)) {}
+    expr_grouping(expr_t expr, source_loc loc) : lox_expression<T>(loc, expr_type::_grouping), expr(std::move(expr)) {}
 
-    expr_type type() { return expr_type::_grouping; };
     T accept(expr_visitor<T>& v) override
     {
       return v.visit(*this);
@@ -134,12 +160,11 @@ namespace cwt
   template<typename T>
   struct expr_literal : public lox_expression<T> 
   {
-    expr_literal(bool v) : value(v) {}
-    expr_literal(double v) : value(v) {}
-    expr_literal(std::string v) : value(v) {}
-    expr_literal() : value(lox_obj()) {}
+    expr_literal(bool v, source_loc loc) : lox_expression<T>(loc, expr_type::_literal), value(v) {}
+    expr_literal(double v, source_loc loc) : lox_expression<T>(loc, expr_type::_literal), value(v) {}
+    expr_literal(std::string v, source_loc loc) : lox_expression<T>(loc, expr_type::_literal), value(v) {}
+    expr_literal(source_loc loc) : lox_expression<T>(loc, expr_type::_literal), value(lox_obj()) {}
 
-    expr_type type() { return expr_type::_literal; };
     T accept(expr_visitor<T>& v) override
     {
       return v.visit(*this);
@@ -152,16 +177,16 @@ namespace cwt
   struct expr_logical : public lox_expression<T>
   {
     using expr_t = std::unique_ptr<lox_expression<T>>;
-    expr_logical(expr_t left, token op, expr_t right) : left(std::move(left)), op(op), right(std::move(right)) {}
+    expr_logical(expr_t left, token_type op, expr_t right, source_loc loc) 
+    : lox_expression<T>(loc, expr_type::_logical), left(std::move(left)), op(op), right(std::move(right)) {}
 
-    expr_type type() { return expr_type::_logical; };
     T accept(expr_visitor<T>& v) override
     {
       return v.visit(*this);
     }
 
     expr_t left;
-    token op;
+    token_type op;
     expr_t right;
   };
 
@@ -169,16 +194,16 @@ namespace cwt
   struct expr_set : public lox_expression<T> 
   {
     using expr_t = std::unique_ptr<lox_expression<T>>;
-    expr_set(expr_t obj, token name, expr_t value) : obj(std::move(obj)), name(name), value(std::move(value)) {}
+    expr_set(expr_t obj, std::string name, expr_t value, source_loc loc) 
+    : lox_expression<T>(loc, expr_type::_set), obj(std::move(obj)), name(std::move(name)), value(std::move(value)) {}
 
-    expr_type type() { return expr_type::_set; };
     T accept(expr_visitor<T>& v) override
     {
       return v.visit(*this);
     }
 
     expr_t obj;
-    token name; 
+    std::string name; 
     expr_t value; 
   };
 
@@ -186,46 +211,41 @@ namespace cwt
   struct expr_super : public lox_expression<T> 
   {
     using expr_t = std::unique_ptr<lox_expression<T>>;
-    expr_super(token keyword, token method) : keyword(keyword), method(method) {}
+    expr_super(std::string method, source_loc loc) : lox_expression<T>(loc, expr_type::_super), method(std::move(method)) {}
 
-    expr_type type() { return expr_type::_super; };
     T accept(expr_visitor<T>& v) override
     {
       return v.visit(*this);
     }
 
-    token keyword;
-    token method;
+    std::string method;
   };
 
   template<typename T>
   struct expr_this : public lox_expression<T> 
   {
     using expr_t = std::unique_ptr<lox_expression<T>>;
-    expr_this(token keyword) : keyword(keyword) {}
+    expr_this(source_loc loc) : lox_expression<T>(loc, expr_type::_this) {}
 
-    expr_type type() { return expr_type::_this; };
     T accept(expr_visitor<T>& v) override
     {
       return v.visit(*this);
     }
-
-    token keyword;
   };
 
   template<typename T>
   struct expr_unary : public lox_expression<T> 
   {
     using expr_t = std::unique_ptr<lox_expression<T>>;
-    expr_unary(token op, expr_t right) : op(op), right(std::move(right)) {}
+    expr_unary(token_type op, expr_t right, source_loc loc) 
+    : lox_expression<T>(loc, expr_type::_unary), op(op), right(std::move(right)) {}
 
-    expr_type type() { return expr_type::_unary; };
     T accept(expr_visitor<T>& v) override
     {
       return v.visit(*this);
     }
 
-    token op;
+    token_type op;
     expr_t right; 
   };
 
@@ -234,14 +254,112 @@ namespace cwt
   {
     using expr_t = std::unique_ptr<lox_expression<T>>;
     using underlying_t = T;
-    expr_variable(token name) : name(name) {}
-    expr_type type() { return expr_type::_variable; };
+    expr_variable(std::string name, source_loc loc) : lox_expression<T>(loc, expr_type::_variable), name(std::move(name)) {}
+    T accept(expr_visitor<T>& v) override
+    {
+      return v.visit(*this);
+    }
+
+    std::string name;
+  };
+
+  // [elements...]
+  template<typename T>
+  struct expr_array : public lox_expression<T>
+  {
+    using expr_t = std::unique_ptr<lox_expression<T>>;
+    expr_array(std::vector<expr_t> elements, source_loc loc) 
+    : lox_expression<T>(loc, expr_type::_array), elements(std::move(elements)) {}
+
+    T accept(expr_visitor<T>& v) override
+    {
+      return v.visit(*this);
+    }
+
+    std::vector<expr_t> elements;
+  };
+
+  // obj[index], an element of an array or the value of a key in a map
+  template<typename T>
+  struct expr_index : public lox_expression<T>
+  {
+    using expr_t = std::unique_ptr<lox_expression<T>>;
+    expr_index(expr_t obj, expr_t index, source_loc loc) 
+    : lox_expression<T>(loc, expr_type::_index), obj(std::move(obj)), index(std::move(index)) {}
+
+    T accept(expr_visitor<T>& v) override
+    {
+      return v.visit(*this);
+    }
+
+    expr_t obj;
+    expr_t index;
+  };
+
+  // obj[index] = value
+  template<typename T>
+  struct expr_index_set : public lox_expression<T>
+  {
+    using expr_t = std::unique_ptr<lox_expression<T>>;
+    expr_index_set(expr_t obj, expr_t index, expr_t value, source_loc loc) 
+    : lox_expression<T>(loc, expr_type::_index_set), obj(std::move(obj)), index(std::move(index)), value(std::move(value)) {}
+
+    T accept(expr_visitor<T>& v) override
+    {
+      return v.visit(*this);
+    }
+
+    expr_t obj;
+    expr_t index;
+    expr_t value;
+  };
+
+  // {key: value, ...}, keys[i] goes with values[i]
+  template<typename T>
+  struct expr_map : public lox_expression<T>
+  {
+    using expr_t = std::unique_ptr<lox_expression<T>>;
+    expr_map(std::vector<expr_t> keys, std::vector<expr_t> values, source_loc loc) 
+    : lox_expression<T>(loc, expr_type::_map), keys(std::move(keys)), values(std::move(values)) {}
+
     T accept(expr_visitor<T>& v) override
     {
       return v.visit(*this);
     }
 
-    token name;
+    std::vector<expr_t> keys;
+    std::vector<expr_t> values;
+  };
+
+  // result of a pure expression, shared by all expr_cached nodes computing it
+  template<typename T>
+  struct memo_cell
+  {
+    T value;
+    std::uint64_t epoch = 0;
+  };
+
+  // inserted by the optimizer, never by the parser. with an epoch the node 
+  // computes expr once per epoch (loop invariants, the epoch belongs to 
+  // the loop), without one it either stores expr for later nodes of the 
+  // same statement or reuses what the first one stored. expr is kept in 
+  // any case, evaluators without memo support can just evaluate it.
+  template<typename T>
+  struct expr_cached : public lox_expression<T>
+  {
+    using expr_t = std::unique_ptr<lox_expression<T>>;
+    expr_cached(expr_t expr, std::shared_ptr<memo_cell<T>> cell, const std::uint64_t* epoch, bool reuse, source_loc loc) 
+    : lox_expression<T>(loc, expr_type::_cached), expr(std::move(expr)), cell(std::move(cell)), epoch(epoch), reuse(reuse) {}
+
+    T accept(expr_visitor<T>& v) override
+    {
+      return v.visit(*this);
+    }
+
+    expr_t expr;
+    std::shared_ptr<memo_cell<T>> cell;
+    const std::uint64_t* epoch;
+    bool reuse;
   };
 
 } // namespace cwt
@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <string_view>
+
+#include "fast_scanner.hpp"
+#include "error.hpp"
+#include "keywords.hpp"
+#include "simd_scan.hpp"
+#include "thread_pool.hpp"
+
+namespace cwt
+{
+  namespace 
+  {
+    constexpr std::size_t min_chunk_size = 64 * 1024;
+
+    bool is_digit(const char c) 
+    {
+      return c >= '0' && c <= '9';
+    }
+
+    bool is_alpha(const char c) 
+    {
+      return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+  } // namespace 
+
+  fast_scanner::fast_scanner(const std::string& src) : m_src(src) {}
+
+  token_stream fast_scanner::scan_stream()
+  {
+    chunk c;
+    c.tokens.reserve(m_src.size() / 6);
+    scan_range(0, m_src.size(), 1, c);
+    token_stream stream(m_src);
+    stream.reserve(c.tokens.size() + 1);
+    append(c, 0, stream);
+    stream.push(token_type::END_OF_FILE, m_src.size(), 0, 1 + c.lines);
+    return stream;
+  }
+
+  std::vector<token> fast_scanner::scan_tokens()
+  {
+    return scan_stream().to_tokens();
+  }
+
+  token_stream fast_scanner::scan_stream(thread_pool& pool)
+  {
+    const char* s = m_src.data();
+    const std::size_t n = m_src.size();
+    const std::size_t target = std::max(min_chunk_size, n / (pool.size() * 4 + 1));
+
+    std::vector<std::size_t> bounds{0};
+    while (bounds.back() + target < n)
+    {
+      const std::size_t nl = simd::find_newline(s, bounds.back() + target, n);
+      if (nl + 1 >= n) 
+      {
+        break;
+      }
+      bounds.push_back(nl + 1);
+    }
+    bounds.push_back(n);
+
+    std::vector<chunk> chunks(bounds.size() - 1);
+    pool.parallel_for(chunks.size(), [this, &bounds, &chunks](std::size_t i) {
+      scan_range(bounds[i], bounds[i+1], 0, chunks[i]);
+    });
+
+    token_stream stream(m_src);
+    std::size_t pos = 0;
+    std::size_t line = 1;
+    for (std::size_t i = 0 ; i < chunks.size() ; ++i)
+    {
+      const chunk* c = &chunks[i];
+      chunk rescanned;
+      if (pos != bounds[i])
+      {
+        if (pos >= bounds[i+1]) 
+        {
+          continue;
+        }
+        scan_range(pos, bounds[i+1], 0, rescanned);
+        c = &rescanned;
+      }
+      append(*c, line, stream);
+      line += c->lines;
+      pos = c->end;
+    }
+    stream.push(token_type::END_OF_FILE, n, 0, line);
+    return stream;
+  }
+
+  std::vector<token> fast_scanner::scan_tokens(thread_pool& pool)
+  {
+    return scan_stream(pool).to_tokens();
+  }
+
+  void fast_scanner::append(const chunk& c, std::size_t first_line, token_stream& stream) const
+  {
+    for (const auto& [line, msg] : c.errors)
+    {
+      cwt::error(first_line + line, msg);
+    }
+    for (const chunk::entry& t : c.tokens)
+    {
+      stream.push(t.type, t.offset, t.length, first_line + t.line);
+    }
+  }
+
+  void fast_scanner::scan_range(std::size_t begin, std::size_t end, std::size_t first_line, chunk& out) const
+  {
+    const char* s = m_src.data();
+    const std::size_t n = m_src.size();
+    std::size_t i = begin;
+    std::size_t line = first_line;
+
+    auto add = [&](token_type type, std::size_t start) {
+      out.tokens.push_back(chunk::entry{type, start, i - start, line});
+    };
+    auto match = [&](char expected) {
+      if (i < n && s[i] == expected) 
+      {
+        ++i;
+        return true;
+      }
+      return false;
+    };
+
+    while (i < end)
+    {
+      const std::size_t start = i;
+      const char c = s[i++];
+      switch (c)
+      {
+        case '(': add(token_type::LEFT_PAREN, start);
+        break; case ')': add(token_type::RIGHT_PAREN, start);
+        break; case '{': add(token_type::LEFT_BRACE, start);
+        break; case '}': add(token_type::RIGHT_BRACE, start);
+        break; case '[': add(token_type::LEFT_BRACKET, start);
+        break; case ']': add(token_type::RIGHT_BRACKET, start);
+        break; case ',': add(token_type::COMMA, start);
+        break; case '.': add(token_type::DOT, start);
+        break; case ':': add(token_type::COLON, start);
+        break; case '-': add(token_type::MINUS, start);
+        break; case '+': add(token_type::PLUS, start);
+        break; case '/': add(token_type::SLASH, start);
+        break; case ';': add(token_type::SEMICOLON, start);
+        break; case '*': add(token_type::STAR, start);
+        break; case '!': add(match('=') ? token_type::BANG_EQUAL : token_type::BANG, start);
+        break; case '=': add(match('=') ? token_type::EQUAL_EQUAL : token_type::EQUAL, start);
+        break; case '<': add(match('=') ? token_type::LESS_EQUAL : token_type::LESS, start);
+        break; case '>': add(match('=') ? token_type::GREATER_EQUAL : token_type::GREATER, start);
+        break; case '#': i = simd::find_newline(s, i, n);
+        break; case ' ': case '\r': case '\t': case '\n': i = simd::skip_whitespace(s, start, end, line);
+        break; case '\"': 
+        {
+          const std::size_t close = simd::find_quote(s, i, n);
+          line += simd::count_newlines(s, i, close);
+          if (close == n)
+          {
+            i = n;
+            out.errors.emplace_back(line, "unterminated string");
+          }
+          else 
+          {
+            i = close + 1;
+            add(token_type::STRING, start);
+          }
+        }
+        break; case 'o': if (match('r')) { add(token_type::OR, start); }
+        break; default: 
+        {
+          if (is_digit(c)) 
+          {
+            i = simd::skip_digits(s, i, n);
+            if (i + 1 < n && s[i] == '.' && is_digit(s[i+1]))
+            {
+              i = simd::skip_digits(s, i + 1, n);
+            }
+            add(token_type::NUMBER, start);
+          }
+          else if (is_alpha(c)) 
+          {
+            i = simd::skip_identifier(s, i, n);
+            add(keyword_or_identifier(std::string_view(s + start, i - start)), start);
+          }
+          else 
+          {
+            out.errors.emplace_back(line, "unexpected character");
+          }
+        }
+      }
+    }
+    out.end = i;
+    out.lines = line - first_line;
+  }
+
+} // namespace cwt
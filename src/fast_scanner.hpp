@@ -0,0 +1,53 @@
+#pragma once 
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "token.hpp"
+#include "token_stream.hpp"
+
+namespace cwt
+{
+  class thread_pool;
+
+  // produces exactly the tokens and errors of `scanner`, but classifies 
+  // whitespace, identifiers, numbers, comments and strings in bulk (see simd_scan.hpp)
+  class fast_scanner
+  {
+    public:
+      fast_scanner(const std::string& src);
+
+      token_stream scan_stream();
+      std::vector<token> scan_tokens();
+
+      // splits the source after newlines and scans the chunks on the pool. every chunk 
+      // assumes it starts between two tokens, if the previous chunk ends inside a token 
+      // (a string spanning the boundary) the chunk is rescanned from the real position.
+      token_stream scan_stream(thread_pool& pool);
+      std::vector<token> scan_tokens(thread_pool& pool);
+
+    private:
+      struct chunk
+      {
+        struct entry 
+        {
+          token_type type;
+          std::size_t offset;
+          std::size_t length;
+          std::size_t line;
+        };
+        std::vector<entry> tokens;
+        std::vector<std::pair<std::size_t, std::string>> errors;
+        std::size_t end{0};          // first position not consumed by the chunk
+        std::size_t lines{0};        // newlines consumed
+      };
+
+      // chunks scanned in parallel start at line 0 and are shifted once their position is known
+      void scan_range(std::size_t begin, std::size_t end, std::size_t first_line, chunk& out) const;
+      void append(const chunk& c, std::size_t first_line, token_stream& stream) const;
+
+    private:
+      std::string m_src;
+  };
+} // namespace cwt
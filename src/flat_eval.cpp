@@ -0,0 +1,207 @@
+#include "interpreter.hpp"
+
+namespace cwt
+{
+
+void interpreter::interpret(const flat_program& program)
+{
+  try
+  {
+    execute(program, program.body);
+    m_scheduler.run();
+  }
+  catch(const std::exception& e)
+  {
+    report_runtime_error(e, m_sources);
+  }
+  catch(const budget_exhausted& e)
+  {
+    m_scheduler.cancel();
+    report_budget_exhausted(e, m_sources);
+  }
+}
+
+void interpreter::execute(const flat_program& program, std::uint32_t list)
+{
+  for (const std::uint32_t node : program.list(list))
+  {
+    execute_node(program, node);
+  }
+}
+
+void interpreter::execute_block(const flat_program& program, std::uint32_t list, std::unique_ptr<environment> new_env)
+{
+  scoped(std::move(new_env), [&]() { execute(program, list); });
+}
+
+void interpreter::execute_node(const flat_program& program, std::uint32_t node)
+{
+  const flat_node& n = program.nodes[node];
+  if (m_profiler) [[unlikely]]
+  {
+    m_profiler->statement(n.loc);
+  }
+  switch (n.op)
+  {
+    case flat_op::expression:
+    {
+      evaluate(program, n.a);
+    }
+    break; case flat_op::print:
+    {
+      lox_obj value = evaluate(program, n.a);
+      *m_out << value.to_string() << std::endl;
+    }
+    break; case flat_op::var:
+    {
+      lox_obj value;
+      if (n.b != flat_node::none)
+      {
+        value = evaluate(program, n.b);
+      }
+      m_env->define(program.names[n.a], value);
+    }
+    break; case flat_op::block:
+    {
+      execute_block(program, n.a, std::make_unique<environment>());
+    }
+    break; case flat_op::if_:
+    {
+      if (is_truthy(evaluate(program, n.a)))
+      {
+        execute(program, n.b);
+      }
+      else
+      {
+        execute(program, n.c);
+      }
+    }
+    break; case flat_op::while_:
+    {
+      while (is_truthy(evaluate(program, n.a)))
+      {
+        execute(program, n.b);
+        if (m_meter)
+        {
+          m_meter->step(n.loc);
+        }
+      }
+    }
+    break; case flat_op::function:
+    {
+      std::shared_ptr<lox_callable> f = std::make_shared<flat_function>(&program, node);
+      m_env->define(program.names[n.a], lox_obj(std::move(f)));
+    }
+    break; case flat_op::return_:
+    {
+      lox_obj value;
+      if (n.a != flat_node::none)
+      {
+        value = evaluate(program, n.a);
+      }
+      LOX_COUNT(returns_thrown);
+      throw lox_return(value);
+    }
+    break; default: throw std::runtime_error("stmt_visitor not implemented");
+  }
+}
+
+lox_obj interpreter::evaluate(const flat_program& program, std::uint32_t node)
+{
+  const flat_node& n = program.nodes[node];
+  if (m_profiler) [[unlikely]]
+  {
+    m_profiler->evaluation();
+  }
+  switch (n.op)
+  {
+    case flat_op::literal: return create_another(program.constants[n.a]);
+    break; case flat_op::variable:
+    {
+      LOX_COUNT(lookups);
+      return create_another(m_env->get(program.names[n.a], n.loc));
+    }
+    break; case flat_op::assign:
+    {
+      lox_obj value = evaluate(program, n.b);
+      LOX_COUNT(assignments);
+      m_env->assign(program.names[n.a], n.loc, value);
+      return value;
+    }
+    break; case flat_op::unary:
+    {
+      lox_obj right = evaluate(program, n.a);
+      return unary(n.token, n.loc, right);
+    }
+    break; case flat_op::binary:
+    {
+      lox_obj left = evaluate(program, n.a);
+      lox_obj right = evaluate(program, n.b);
+      return binary(n.token, n.loc, left, right, n.feedback);
+    }
+    break; case flat_op::logical:
+    {
+      lox_obj left = evaluate(program, n.a);
+      if (n.token == token_type::OR)
+      {
+        if (is_truthy(left)) { return left; }
+      }
+      else
+      {
+        if (!is_truthy(left)) { return left; }
+      }
+      return evaluate(program, n.b);
+    }
+    break; case flat_op::call:
+    {
+      lox_obj callee = evaluate(program, n.a);
+      const auto arg_nodes = program.list(n.b);
+      arg_buffer buffer(arg_nodes.size());
+      std::span<lox_obj> args = buffer.values();
+      for (std::size_t i = 0 ; i < arg_nodes.size() ; ++i)
+      {
+        args[i] = evaluate(program, arg_nodes[i]);
+      }
+      return call(callee, args, n.loc);
+    }
+    break; case flat_op::array:
+    {
+      const auto element_nodes = program.list(n.a);
+      arg_buffer buffer(element_nodes.size());
+      std::span<lox_obj> elements = buffer.values();
+      for (std::size_t i = 0 ; i < element_nodes.size() ; ++i)
+      {
+        elements[i] = evaluate(program, element_nodes[i]);
+      }
+      return make_array(elements);
+    }
+    break; case flat_op::index:
+    {
+      lox_obj target = evaluate(program, n.a);
+      lox_obj key = evaluate(program, n.b);
+      return index(target, key, n.loc);
+    }
+    break; case flat_op::index_set:
+    {
+      lox_obj target = evaluate(program, n.a);
+      lox_obj key = evaluate(program, n.b);
+      lox_obj value = evaluate(program, n.c);
+      index_set(target, key, value, n.loc);
+      return value;
+    }
+    break; case flat_op::map:
+    {
+      const auto entry_nodes = program.list(n.a);
+      arg_buffer buffer(entry_nodes.size());
+      std::span<lox_obj> entries = buffer.values();
+      for (std::size_t i = 0 ; i < entry_nodes.size() ; ++i)
+      {
+        entries[i] = evaluate(program, entry_nodes[i]);
+      }
+      return make_map(entries, n.loc);
+    }
+    break; default: throw std::runtime_error("expr_visitor not implemented");
+  }
+}
+
+} // namespace cwt
@@ -0,0 +1,295 @@
+#include <unordered_map>
+
+#include "flat_ir.hpp"
+#include "interpreter.hpp"
+#include "metrics.hpp"
+#include "return.hpp"
+
+namespace cwt
+{
+  namespace
+  {
+    using expr_t = std::unique_ptr<lox_expression<lox_obj>>;
+    using stmt_t = std::unique_ptr<lox_statement<lox_obj>>;
+
+    class flattener
+    {
+      public:
+        flattener(flat_program& program) : m_program(program) {}
+
+        std::uint32_t statements(const std::vector<stmt_t>& list)
+        {
+          std::vector<std::uint32_t> entries;
+          entries.reserve(list.size());
+          for (const auto& s : list)
+          {
+            entries.push_back(statement(*s));
+          }
+          return add_list(entries);
+        }
+
+      private:
+        std::uint32_t statement(lox_statement<lox_obj>& s)
+        {
+          flat_node n{flat_op::unsupported_stmt};
+          switch (s.type())
+          {
+            case stmt_type::_block:
+            {
+              n.op = flat_op::block;
+              n.a = statements(static_cast<const stmt_block<lox_obj>&>(s).statements);
+            }
+            break; case stmt_type::_expression:
+            {
+              n.op = flat_op::expression;
+              n.a = expression(*static_cast<const stmt_expression<lox_obj>&>(s).expression);
+            }
+            break; case stmt_type::_print:
+            {
+              n.op = flat_op::print;
+              n.a = expression(*static_cast<const stmt_print<lox_obj>&>(s).expression);
+            }
+            break; case stmt_type::_var:
+            {
+              const auto& v = static_cast<const stmt_var<lox_obj>&>(s);
+              n.op = flat_op::var;
+              n.a = name(v.name);
+              n.b = v.initializer ? expression(*v.initializer) : flat_node::none;
+            }
+            break; case stmt_type::_if:
+            {
+              const auto& i = static_cast<const stmt_if<lox_obj>&>(s);
+              n.op = flat_op::if_;
+              n.a = expression(*i.condition);
+              n.b = statements(i.then_branch);
+              n.c = statements(i.else_branch);
+            }
+            break; case stmt_type::_while:
+            {
+              const auto& w = static_cast<const stmt_while<lox_obj>&>(s);
+              n.op = flat_op::while_;
+              n.a = expression(*w.condition);
+              n.b = statements(w.body);
+            }
+            break; case stmt_type::_function:
+            {
+              const auto& f = static_cast<const stmt_function<lox_obj>&>(s);
+              std::vector<std::uint32_t> parameters;
+              parameters.reserve(f.parameters.size());
+              for (const auto& p : f.parameters)
+              {
+                parameters.push_back(name(p));
+              }
+              n.op = flat_op::function;
+              n.a = name(f.name);
+              n.b = add_list(parameters);
+              n.c = statements(f.body);
+            }
+            break; case stmt_type::_return:
+            {
+              const auto& r = static_cast<const stmt_return<lox_obj>&>(s);
+              n.op = flat_op::return_;
+              n.a = r.value ? expression(*r.value) : flat_node::none;
+            }
+            break; default: break;
+          }
+          n.loc = s.loc;
+          return add_node(n);
+        }
+
+        std::uint32_t expression(lox_expression<lox_obj>& e)
+        {
+          flat_node n{flat_op::unsupported_expr};
+          switch (e.type())
+          {
+            case expr_type::_grouping:
+            {
+              // a grouping only exists for the parser, its child takes its place
+              return expression(*static_cast<const expr_grouping<lox_obj>&>(e).expr);
+            }
+            break; case expr_type::_cached:
+            {
+              // no memo support here, the wrapped expression is evaluated every time
+              return expression(*static_cast<const expr_cached<lox_obj>&>(e).expr);
+            }
+            break; case expr_type::_literal:
+            {
+              n.op = flat_op::literal;
+              n.a = static_cast<std::uint32_t>(m_program.constants.size());
+              m_program.constants.push_back(create_another(static_cast<const expr_literal<lox_obj>&>(e).value));
+            }
+            break; case expr_type::_variable:
+            {
+              n.op = flat_op::variable;
+              n.a = name(static_cast<const expr_variable<lox_obj>&>(e).name);
+            }
+            break; case expr_type::_assign:
+            {
+              const auto& a = static_cast<const expr_assign<lox_obj>&>(e);
+              n.op = flat_op::assign;
+              n.a = name(a.name);
+              n.b = expression(*a.value);
+            }
+            break; case expr_type::_unary:
+            {
+              const auto& u = static_cast<const expr_unary<lox_obj>&>(e);
+              n.op = flat_op::unary;
+              n.token = u.op;
+              n.a = expression(*u.right);
+            }
+            break; case expr_type::_binary:
+            {
+              const auto& b = static_cast<const expr_binary<lox_obj>&>(e);
+              n.op = flat_op::binary;
+              n.token = b.op;
+              n.a = expression(*b.left);
+              n.b = expression(*b.right);
+            }
+            break; case expr_type::_logical:
+            {
+              const auto& l = static_cast<const expr_logical<lox_obj>&>(e);
+              n.op = flat_op::logical;
+              n.token = l.op;
+              n.a = expression(*l.left);
+              n.b = expression(*l.right);
+            }
+            break; case expr_type::_call:
+            {
+              const auto& c = static_cast<const expr_call<lox_obj>&>(e);
+              n.op = flat_op::call;
+              n.a = expression(*c.callee);
+              std::vector<std::uint32_t> args;
+              args.reserve(c.args.size());
+              for (const auto& arg : c.args)
+              {
+                args.push_back(expression(*arg));
+              }
+              n.b = add_list(args);
+            }
+            break; case expr_type::_array:
+            {
+              const auto& a = static_cast<const expr_array<lox_obj>&>(e);
+              n.op = flat_op::array;
+              std::vector<std::uint32_t> elements;
+              elements.reserve(a.elements.size());
+              for (const auto& element : a.elements)
+              {
+                elements.push_back(expression(*element));
+              }
+              n.a = add_list(elements);
+            }
+            break; case expr_type::_index:
+            {
+              const auto& i = static_cast<const expr_index<lox_obj>&>(e);
+              n.op = flat_op::index;
+              n.a = expression(*i.obj);
+              n.b = expression(*i.index);
+            }
+            break; case expr_type::_index_set:
+            {
+              const auto& i = static_cast<const expr_index_set<lox_obj>&>(e);
+              n.op = flat_op::index_set;
+              n.a = expression(*i.obj);
+              n.b = expression(*i.index);
+              n.c = expression(*i.value);
+            }
+            break; case expr_type::_map:
+            {
+              const auto& m = static_cast<const expr_map<lox_obj>&>(e);
+              n.op = flat_op::map;
+              std::vector<std::uint32_t> entries;
+              entries.reserve(2 * m.keys.size());
+              for (std::size_t i = 0 ; i < m.keys.size() ; ++i)
+              {
+                entries.push_back(expression(*m.keys[i]));
+                entries.push_back(expression(*m.values[i]));
+              }
+              n.a = add_list(entries);
+            }
+            break; default: break;
+          }
+          n.loc = e.loc;
+          return add_node(n);
+        }
+
+        std::uint32_t add_node(const flat_node& n)
+        {
+          m_program.nodes.push_back(n);
+          return static_cast<std::uint32_t>(m_program.nodes.size() - 1);
+        }
+
+        std::uint32_t add_list(const std::vector<std::uint32_t>& entries)
+        {
+          const auto at = static_cast<std::uint32_t>(m_program.lists.size());
+          m_program.lists.push_back(static_cast<std::uint32_t>(entries.size()));
+          m_program.lists.insert(m_program.lists.end(), entries.begin(), entries.end());
+          return at;
+        }
+
+        std::uint32_t name(const std::string& n)
+        {
+          auto [it, inserted] = m_names.try_emplace(n, static_cast<std::uint32_t>(m_program.names.size()));
+          if (inserted)
+          {
+            m_program.names.push_back(n);
+          }
+          return it->second;
+        }
+
+      private:
+        flat_program& m_program;
+        std::unordered_map<std::string, std::uint32_t> m_names;
+    };
+  }
+
+  flat_program flatten(const std::vector<stmt_t>& statements)
+  {
+    flat_program program;
+    flattener f(program);
+    program.body = f.statements(statements);
+    return program;
+  }
+
+
+  flat_function::flat_function(const flat_program* program, std::uint32_t declaration)
+  : m_program(program), m_declaration(declaration)
+  {
+  }
+  std::string flat_function::to_string()
+  {
+    std::string s{"<fn "};
+    s.append(m_program->names[m_program->nodes[m_declaration].a]);
+    s.append(">");
+    return s;
+  }
+  std::size_t flat_function::arity()
+  {
+    return m_program->list(m_program->nodes[m_declaration].b).size();
+  }
+
+  lox_obj flat_function::call(interpreter& interpreter, std::span<const lox_obj> args)
+  {
+    const flat_node& declaration = m_program->nodes[m_declaration];
+    profile_scope scope(interpreter.get_profiler(), m_program->names[declaration.a]);
+    LOX_COUNT(function_calls);
+    auto env = std::make_unique<environment>();
+    env->set_enclosing(interpreter.get_env_ptr());
+    const auto parameters = m_program->list(declaration.b);
+    for (std::size_t i = 0 ; i < parameters.size() ; ++i)
+    {
+      env->define(m_program->names[parameters[i]], args[i]);
+    }
+
+    try
+    {
+      interpreter.execute_block(*m_program, declaration.c, std::move(env));
+    }
+    catch(const lox_return& e)
+    {
+      return create_another(e.value());
+    }
+
+    return lox_obj();
+  }
+
+} // namespace cwt
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "lox_callable.hpp"
+#include "lox_obj.hpp"
+#include "stmt.hpp"
+
+namespace cwt
+{
+  enum class flat_op : std::uint8_t
+  {
+    // expressions
+    literal = 0, variable, assign, unary, binary, logical, call, array, index, index_set, map, unsupported_expr,
+    // statements
+    expression, print, var, block, if_, while_, function, return_, unsupported_stmt
+  };
+
+  // one node of the flattened tree. children are indices into
+  // flat_program::nodes, lists (statements, arguments, parameters) are
+  // offsets into flat_program::lists. what a, b and c hold depends on op:
+  //
+  //   literal      a: constant
+  //   variable     a: name
+  //   assign       a: name, b: value
+  //   unary        a: operand
+  //   binary       a: left, b: right       (logical too)
+  //   call         a: callee, b: arguments list
+  //   array        a: elements list
+  //   index        a: array, b: index
+  //   index_set    a: array, b: index, c: value
+  //   map          a: list of each key followed by its value
+  //   expression   a: expression           (print too)
+  //   var          a: name, b: initializer or none
+  //   block        a: statements list
+  //   if_          a: condition, b: then list, c: else list
+  //   while_       a: condition, b: body list
+  //   function     a: name, b: parameter names list, c: body list
+  //   return_      a: value or none
+  struct flat_node
+  {
+    static constexpr std::uint32_t none = UINT32_MAX;
+
+    flat_op op;
+    // binary only
+    mutable type_feedback feedback = type_feedback::none;
+    token_type token = token_type::NIL;
+    std::uint32_t a = none;
+    std::uint32_t b = none;
+    std::uint32_t c = none;
+    source_loc loc;
+  };
+
+  // nodes are stored in post-order, every child comes before its parent.
+  // a list is its length followed by its entries.
+  struct flat_program
+  {
+    std::vector<flat_node> nodes;
+    std::vector<std::uint32_t> lists;
+    std::vector<lox_obj> constants;
+    std::vector<std::string> names;
+    std::uint32_t body = 0;
+
+    std::span<const std::uint32_t> list(std::uint32_t at) const noexcept
+    {
+      return std::span<const std::uint32_t>(lists.data() + at + 1, lists[at]);
+    }
+  };
+
+  flat_program flatten(const std::vector<std::unique_ptr<lox_statement<lox_obj>>>& statements);
+
+  class flat_function : public lox_callable
+  {
+    public:
+      flat_function(const flat_program* program, std::uint32_t declaration);
+      std::string to_string() override;
+      std::size_t arity() override;
+      lox_obj call(interpreter& interpreter, std::span<const lox_obj> args) override;
+
+    private:
+      const flat_program* m_program;
+      std::uint32_t m_declaration;
+  };
+
+} // namespace cwt
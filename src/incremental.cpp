@@ -0,0 +1,362 @@
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include "incremental.hpp"
+#include "error.hpp"
+#include "parser.hpp"
+#include "scanner.hpp"
+
+namespace cwt
+{
+  namespace
+  {
+    std::size_t newlines(std::string_view s)
+    {
+      return static_cast<std::size_t>(std::count(s.begin(), s.end(), '\n'));
+    }
+
+    std::size_t moved(std::size_t at, std::ptrdiff_t by)
+    {
+      return static_cast<std::size_t>(static_cast<std::ptrdiff_t>(at) + by);
+    }
+
+    // most edits stay inside a declaration and swap elements one for one,
+    // only a change in count moves what comes after
+    template<typename T>
+    void replace_range(std::vector<T>& v, std::size_t from, std::size_t to, std::vector<T> with)
+    {
+      const std::size_t common = std::min(to - from, with.size());
+      std::move(with.begin(), with.begin() + common, v.begin() + from);
+      if (common < with.size())
+      {
+        v.insert(v.begin() + from + common, std::make_move_iterator(with.begin() + common), std::make_move_iterator(with.end()));
+      }
+      else
+      {
+        v.erase(v.begin() + from + common, v.begin() + to);
+      }
+    }
+  } // namespace
+
+  incremental_program::incremental_program(source_map& sources, std::string name, std::string text)
+    : m_sources(sources), m_name(std::move(name))
+  {
+    edit(0, 0, text);
+  }
+
+  bool incremental_program::ok() const noexcept
+  {
+    return std::all_of(m_chunks.begin(), m_chunks.end(), [](const chunk& c) { return c.ok(); });
+  }
+
+  std::string incremental_program::diagnostics() const
+  {
+    // the scanner is done with the whole file before the parser starts
+    std::string s;
+    for (const chunk& c : m_chunks)
+    {
+      s.append(c.scan_errors);
+    }
+    for (const chunk& c : m_chunks)
+    {
+      s.append(c.parse_errors);
+    }
+    return s;
+  }
+
+  void incremental_program::edit(std::size_t begin, std::size_t end, std::string_view replacement)
+  {
+    if (begin > end || end > m_text.size())
+    {
+      throw std::out_of_range("incremental_program: edit out of range.");
+    }
+    const std::string_view removed = std::string_view(m_text).substr(begin, end - begin);
+    const std::ptrdiff_t delta = static_cast<std::ptrdiff_t>(replacement.size()) - static_cast<std::ptrdiff_t>(removed.size());
+    const std::ptrdiff_t line_delta = static_cast<std::ptrdiff_t>(newlines(replacement)) - static_cast<std::ptrdiff_t>(newlines(removed));
+
+    // the text before the chunk the edit starts in is untouched, so are its
+    // declarations unless one with errors looked at what came after it
+    const auto after_begin = std::upper_bound(m_chunks.begin(), m_chunks.end(), begin,
+      [](std::size_t offset, const chunk& c) { return offset < c.begin; });
+    std::size_t first = after_begin == m_chunks.begin() ? 0 : static_cast<std::size_t>(after_begin - m_chunks.begin()) - 1;
+    std::size_t start = 0;
+    std::size_t line = 1;
+    const auto step_back = [this, begin, &first, &start, &line]() {
+      while (first > 0 && !m_chunks[first - 1].ok())
+      {
+        --first;
+      }
+      if (first < m_chunks.size() && m_chunks[first].begin <= begin)
+      {
+        start = m_chunks[first].begin;
+        line = *m_chunks[first].line;
+      }
+    };
+    step_back();
+
+    // chunks from the end of the edit on keep their text, they only move
+    const std::size_t candidates = static_cast<std::size_t>(std::lower_bound(m_chunks.begin(), m_chunks.end(), end,
+      [](const chunk& c, std::size_t offset) { return c.begin < offset; }) - m_chunks.begin());
+
+    // everything is worked out on the edited copy of the text and only
+    // takes effect once all parses are through, a throw changes nothing
+    std::string text;
+    text.reserve(m_text.size() - removed.size() + replacement.size());
+    text.append(m_text, 0, begin).append(replacement).append(m_text, end);
+
+    std::size_t rescanned = 0;
+    std::optional<window> w;
+    while (true)
+    {
+      // usually the parse is back in step at the first chunk after the
+      // edit, the one after that is as far as the first try scans
+      const std::size_t limit = candidates + 1 < m_chunks.size() ? moved(m_chunks[candidates + 1].begin, delta) : text.size();
+      rescanned += limit - start;
+      w = parse_window(text, delta, start, line, limit, candidates, false);
+      if (!w)
+      {
+        rescanned += text.size() - start;
+        w = parse_window(text, delta, start, line, text.size(), candidates, false);
+      }
+      if (!w->starts_with_else || first == 0)
+      {
+        break;
+      }
+      // an if before the window may take it
+      --first;
+      step_back();
+    }
+
+    // diagnostics name lines, chunks with errors that moved are parsed
+    // again. they are found by the index they get once w is in place.
+    std::vector<std::pair<std::size_t, window>> fresh;
+    add_pieces(*w);
+    try
+    {
+      const std::size_t tail = first + w->chunks.size();
+      const std::size_t count = tail + m_chunks.size() - w->resumes_at;
+      const auto chunk_at = [&](std::size_t i) -> const chunk& {
+        return i < tail ? w->chunks[i - first] : m_chunks[i - tail + w->resumes_at];
+      };
+      const auto begin_of = [&](std::size_t i) {
+        return i < tail ? chunk_at(i).begin : moved(chunk_at(i).begin, delta);
+      };
+      for (std::size_t i = first ; i < count ; ++i)
+      {
+        const chunk& c = chunk_at(i);
+        if (i < tail ? !c.stale : line_delta == 0 || c.ok())
+        {
+          continue;
+        }
+        const std::size_t from = begin_of(i);
+        const std::size_t limit = i + 1 < count ? begin_of(i + 1) : text.size();
+        rescanned += limit - from;
+        window reparsed = *parse_window(text, 0, from, i < tail ? *c.line : moved(*c.line, line_delta), limit, m_chunks.size(), true);
+        for (chunk& r : reparsed.chunks)
+        {
+          r.stale = false;
+        }
+        reparsed.resumes_at = i + 1;
+        add_pieces(reparsed);
+        fresh.emplace_back(i, std::move(reparsed));
+      }
+    }
+    catch(...)
+    {
+      remove_pieces(w->chunks, 0, w->chunks.size());
+      for (const auto& [at, reparsed] : fresh)
+      {
+        remove_pieces(reparsed.chunks, 0, reparsed.chunks.size());
+      }
+      throw;
+    }
+
+    m_text = std::move(text);
+    for (std::size_t i = candidates ; i < m_chunks.size() ; ++i)
+    {
+      chunk& c = m_chunks[i];
+      c.begin = moved(c.begin, delta);
+      *c.line = moved(*c.line, line_delta);
+    }
+    splice(first, std::move(*w));
+    // from the back, so the indices before stay where they are
+    for (auto it = fresh.rbegin() ; it != fresh.rend() ; ++it)
+    {
+      splice(it->first, std::move(it->second));
+    }
+    m_rescanned = rescanned;
+  }
+
+  std::optional<incremental_program::window> incremental_program::parse_window(const std::string& text, std::ptrdiff_t shift, std::size_t start, std::size_t line, std::size_t limit, std::size_t candidates, bool bounded) const
+  {
+    std::string src = text.substr(start, limit - start);
+
+    std::ostringstream scan_errors;
+    error_state scan_state;
+    scan_state.diagnostics = &scan_errors;
+    token_stream tokens;
+    {
+      scoped_error_state scope(scan_state);
+      tokens = scanner(src, line).scan_stream();
+    }
+
+    std::ostringstream parse_errors;
+    error_state parse_state;
+    parse_state.diagnostics = &parse_errors;
+    scoped_error_state scope(parse_state);
+
+    window w;
+    w.starts_with_else = tokens.type(0) == token_type::ELSE;
+    const source_loc base = m_sources.place(src.size());
+    parser<lox_obj> p(tokens, base);
+    std::vector<std::size_t> marks;
+    // offsets into src from here on
+    std::size_t previous_end = 0;
+    std::size_t counted = 0;
+    std::size_t next_candidate = candidates;
+    std::size_t end = src.size();
+    while (true)
+    {
+      const std::size_t next_offset = p.done() ? src.size() : tokens.offset(p.position());
+      while (next_candidate < m_chunks.size() && moved(m_chunks[next_candidate].begin, shift) < start + previous_end)
+      {
+        ++next_candidate;
+      }
+      // an unchanged chunk starting on a line between the last declaration
+      // and the next token: from here on tokens and parse are as they were
+      if (!p.done() && next_candidate < m_chunks.size())
+      {
+        const chunk& c = m_chunks[next_candidate];
+        const std::size_t c_begin = moved(c.begin, shift);
+        if (c_begin <= start + next_offset && c.ok() && (c_begin == 0 || text[c_begin - 1] == '\n'))
+        {
+          w.resumes_at = next_candidate;
+          end = c_begin - start;
+          break;
+        }
+      }
+      if (p.done())
+      {
+        if (limit < text.size() && !bounded)
+        {
+          return std::nullopt;
+        }
+        while (next_candidate < m_chunks.size() && moved(m_chunks[next_candidate].begin, shift) < limit)
+        {
+          ++next_candidate;
+        }
+        w.resumes_at = next_candidate;
+        break;
+      }
+
+      const std::size_t mark = static_cast<std::size_t>(parse_errors.tellp());
+      std::vector<stmt_t> statements = p.parse_declaration();
+      const std::size_t last = p.position() - 1;
+      // a declaration starts a chunk unless the one before ends on its first line
+      const std::size_t line_start = next_offset == 0 ? 0 : src.rfind('\n', next_offset - 1) + 1;
+      if (w.chunks.empty() || line_start >= previous_end)
+      {
+        chunk c;
+        c.begin = w.chunks.empty() ? 0 : line_start;
+        line += newlines(std::string_view(src).substr(counted, c.begin - counted));
+        counted = c.begin;
+        c.line = std::make_shared<std::size_t>(line);
+        c.first = w.statements.size();
+        w.chunks.push_back(std::move(c));
+        marks.push_back(mark);
+      }
+      for (auto& s : statements)
+      {
+        w.statements.push_back(std::move(s));
+      }
+      previous_end = tokens.offset(last) + tokens.lexeme(last).size();
+    }
+
+    // text without declarations still needs an owner for its scan errors
+    if (w.chunks.empty() && end > 0)
+    {
+      chunk c;
+      c.line = std::make_shared<std::size_t>(line);
+      w.chunks.push_back(std::move(c));
+      marks.push_back(0);
+    }
+    marks.push_back(static_cast<std::size_t>(parse_errors.tellp()));
+    const std::string errors = parse_errors.str();
+    for (std::size_t i = 0 ; i < w.chunks.size() ; ++i)
+    {
+      chunk& c = w.chunks[i];
+      c.parse_errors = errors.substr(marks[i], marks[i + 1] - marks[i]);
+      c.base = source_loc{base.offset + static_cast<std::uint32_t>(c.begin)};
+      if (i > 0)
+      {
+        w.pieces.push_back(static_cast<std::uint32_t>(c.begin));
+      }
+      c.begin += start;
+    }
+    // what was scanned past the end belongs to the chunks after it
+    src.resize(end);
+    w.text = std::move(src);
+    w.base = base;
+
+    // scan errors do not say which declaration they belong to, they may
+    // even be past the end. unless one chunk has all of the text each is
+    // scanned again on its own.
+    if (scan_state.has_error && !w.chunks.empty())
+    {
+      w.chunks.front().scan_errors = scan_errors.str();
+      if (w.chunks.size() > 1 || end < limit - start)
+      {
+        for (chunk& c : w.chunks)
+        {
+          c.stale = true;
+        }
+      }
+    }
+    return w;
+  }
+
+  void incremental_program::add_pieces(window& w)
+  {
+    if (w.chunks.empty())
+    {
+      return;
+    }
+    m_sources.add_at(w.base, m_name, std::move(w.text));
+    if (!w.pieces.empty())
+    {
+      m_sources.split(w.base, w.pieces);
+    }
+    for (const chunk& c : w.chunks)
+    {
+      m_sources.link_first_line(c.base, c.line);
+    }
+  }
+
+  void incremental_program::remove_pieces(const std::vector<chunk>& chunks, std::size_t first, std::size_t last)
+  {
+    for (std::size_t i = first ; i < last ; ++i)
+    {
+      m_sources.remove(chunks[i].base);
+    }
+  }
+
+  void incremental_program::splice(std::size_t first, window w)
+  {
+    const std::size_t from = first < m_chunks.size() ? m_chunks[first].first : m_statements.size();
+    const std::size_t to = w.resumes_at < m_chunks.size() ? m_chunks[w.resumes_at].first : m_statements.size();
+    const std::ptrdiff_t moved = static_cast<std::ptrdiff_t>(w.statements.size()) - static_cast<std::ptrdiff_t>(to - from);
+    for (chunk& c : w.chunks)
+    {
+      c.first += from;
+    }
+    for (std::size_t i = w.resumes_at ; i < m_chunks.size() ; ++i)
+    {
+      m_chunks[i].first = static_cast<std::size_t>(static_cast<std::ptrdiff_t>(m_chunks[i].first) + moved);
+    }
+    remove_pieces(m_chunks, first, w.resumes_at);
+    replace_range(m_statements, from, to, std::move(w.statements));
+    replace_range(m_chunks, first, w.resumes_at, std::move(w.chunks));
+  }
+
+} // namespace cwt
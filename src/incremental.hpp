@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "source_map.hpp"
+#include "stmt.hpp"
+
+namespace cwt
+{
+  // one source file kept parsed while it is edited. the text is cut into
+  // chunks of whole lines holding one or more top level declarations, each
+  // a piece of its own in the source_map. an edit rescans and reparses from
+  // the chunk it starts in up to the first chunk after it whose tokens and
+  // parse cannot have changed, the syntax trees of all other chunks are kept.
+  // statements an edit replaces are destroyed, functions an interpreter made
+  // of them must not be called again. the pieces of replaced text leave the
+  // map. an edit that throws leaves the program as it was.
+  class incremental_program
+  {
+    using stmt_t = std::unique_ptr<lox_statement<lox_obj>>;
+
+    public:
+      incremental_program(source_map& sources, std::string name, std::string text);
+      incremental_program(const incremental_program&) = delete;
+      incremental_program& operator=(const incremental_program&) = delete;
+
+      // replaces [begin, end) of the text
+      void edit(std::size_t begin, std::size_t end, std::string_view replacement);
+
+      const std::string& text() const noexcept { return m_text; }
+      // the top level statements in source order
+      const std::vector<stmt_t>& statements() const noexcept { return m_statements; }
+      bool ok() const noexcept;
+      // what a parse of the whole text would report
+      std::string diagnostics() const;
+      // bytes the last edit scanned
+      std::size_t rescanned() const noexcept { return m_rescanned; }
+
+    private:
+      struct chunk
+      {
+        std::size_t begin = 0;
+        // shared with the source_map piece, which decodes lines from it
+        std::shared_ptr<std::size_t> line;
+        source_loc base;
+        // index of its first statement
+        std::size_t first = 0;
+        std::string scan_errors;
+        std::string parse_errors;
+        // the diagnostics name lines that have moved since
+        bool stale = false;
+
+        bool ok() const noexcept { return scan_errors.empty() && parse_errors.empty(); }
+      };
+
+      struct window
+      {
+        std::vector<chunk> chunks;
+        std::vector<stmt_t> statements;
+        // the first old chunk after the window, its tokens are where they were
+        std::size_t resumes_at = 0;
+        bool starts_with_else = false;
+        // the text of the chunks, kept out of the source_map until the
+        // window is, and where it goes there
+        std::string text;
+        source_loc base;
+        std::vector<std::uint32_t> pieces;
+      };
+
+      // scans and parses [start, limit) of text declaration by declaration
+      // until it gets to an unchanged chunk at or after candidates, whose
+      // begin is shift off in text. nullopt if it runs into limit instead,
+      // unless that is the end of the text or bounded says it ends a chunk
+      // no edit touched.
+      std::optional<window> parse_window(const std::string& text, std::ptrdiff_t shift, std::size_t start, std::size_t line, std::size_t limit, std::size_t candidates, bool bounded) const;
+      // gives every chunk of w its piece of the source_map
+      void add_pieces(window& w);
+      void remove_pieces(const std::vector<chunk>& chunks, std::size_t first, std::size_t last);
+      // puts w in place of the chunks [first, w.resumes_at)
+      void splice(std::size_t first, window w);
+
+    private:
+      source_map& m_sources;
+      std::string m_name;
+      std::string m_text;
+      std::vector<chunk> m_chunks;
+      std::vector<stmt_t> m_statements;
+      std::size_t m_rescanned = 0;
+  };
+
+} // namespace cwt
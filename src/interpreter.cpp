@@ -1,27 +1,121 @@
 
+#include <array>
 #include <iostream>
 #include <memory>
 
 #include "interpreter.hpp"
 #include "lox_function.hpp"
+#include "builtins.hpp"
 #include "error.hpp"
+#include "metrics.hpp"
 #include "return.hpp"
 
 namespace cwt
 {
+
+namespace
+{
+  // true if evaluating e cannot assign a variable or call anything that does
+  bool binds_nothing(const lox_expression<lox_obj>& e)
+  {
+    switch (e.type())
+    {
+      case expr_type::_literal:
+      case expr_type::_variable: return true;
+      break; case expr_type::_grouping: return binds_nothing(*static_cast<const expr_grouping<lox_obj>&>(e).expr);
+      break; case expr_type::_unary: return binds_nothing(*static_cast<const expr_unary<lox_obj>&>(e).right);
+      break; case expr_type::_binary:
+      {
+        const auto& b = static_cast<const expr_binary<lox_obj>&>(e);
+        return binds_nothing(*b.left) && binds_nothing(*b.right);
+      }
+      break; case expr_type::_index:
+      {
+        const auto& i = static_cast<const expr_index<lox_obj>&>(e);
+        return binds_nothing(*i.obj) && binds_nothing(*i.index);
+      }
+      break; default: return false;
+    }
+  }
+
+  void check_key(const lox_obj& key, source_loc loc)
+  {
+    if (!lox_map::valid_key(key))
+    {
+      runtime_error(loc, "Map keys must be nil, booleans, strings or numbers other than NaN.");
+    }
+  }
+} // namespace
+
+static_assert(static_cast<std::size_t>(expr_type::_map) + 1 == std::tuple_size_v<decltype(metrics::expr_dispatches)>);
+static_assert(static_cast<std::size_t>(stmt_type::_while) + 1 == std::tuple_size_v<decltype(metrics::stmt_dispatches)>);
+interpreter::interpreter(std::ostream& out) : m_out(&out)
+{
+  define_builtins(*this);
+}
 environment* interpreter::get_env_ptr()
 {
   return m_env.get();
 }
+void interpreter::set_source_map(const source_map* sources)
+{
+  m_sources = sources;
+}
+void interpreter::set_profiler(profiler* p)
+{
+  m_profiler = p;
+}
+profiler* interpreter::get_profiler()
+{
+  return m_profiler;
+}
+void interpreter::set_jit(jit* j)
+{
+  m_jit = j;
+}
+jit* interpreter::get_jit()
+{
+  return m_jit;
+}
+void interpreter::set_meter(meter* m)
+{
+  m_meter = m;
+}
+meter* interpreter::get_meter()
+{
+  return m_meter;
+}
+scheduler& interpreter::get_scheduler()
+{
+  return m_scheduler;
+}
+void interpreter::set_dispatch(dispatch d)
+{
+  m_dispatch = d;
+}
+environment* interpreter::get_globals_ptr()
+{
+  return m_globals;
+}
+void interpreter::define_native(const std::string& name, std::size_t arity, lox_native::function_t func)
+{
+  m_globals->define(name, lox_obj(lox_native(name, arity, std::move(func))));
+}
 void interpreter::interpret(const std::vector<stmt_t>& statements) 
 {
   try
   {
     this->execute(statements);
+    m_scheduler.run();
   }
   catch(const std::exception& e)
   {
-    std::cerr << e.what() << '\n';
+    report_runtime_error(e, m_sources);
+  }
+  catch(const budget_exhausted& e)
+  {
+    m_scheduler.cancel();
+    report_budget_exhausted(e, m_sources);
   }
 }
 
@@ -37,7 +131,7 @@ void interpreter::visit(const stmt_function<lox_obj>& s)
 {
   lox_function f(&s);
   lox_obj obj(f);
-  m_env->define(s.name.lexeme, create_another(obj));
+  m_env->define(s.name, create_another(obj));
 }
 void interpreter::visit(const stmt_if<lox_obj>& s) 
 {
@@ -53,7 +147,7 @@ void interpreter::visit(const stmt_if<lox_obj>& s)
 void interpreter::visit(const stmt_print<lox_obj>& s)  
 {
   lox_obj value = evaluate(s.expression);
-  std::cout << value.to_string() << std::endl;
+  *m_out << value.to_string() << std::endl;
 }
 void interpreter::visit(const stmt_var<lox_obj>& s) 
 {
@@ -62,13 +156,27 @@ void interpreter::visit(const stmt_var<lox_obj>& s)
   {
     value = evaluate(s.initializer);
   }
-  m_env->define(s.name.lexeme, value);
+  m_env->define(s.name, value);
 }
 void interpreter::visit(const stmt_while<lox_obj>& s) 
 {
+  // epochs are unique, a recursive run of the same loop cannot leave 
+  // values behind that look valid to this one
+  const std::uint64_t outer = s.epoch;
+  s.epoch = ++m_epochs;
+  m_loops.push_back(loop_run{&s, s.epoch});
+  finally restore([this, &s, outer]()
+  {
+    s.epoch = outer;
+    m_loops.pop_back();
+  });
   while (is_truthy(evaluate(s.condition)))
   {
     execute(s.body);
+    if (m_meter)
+    {
+      m_meter->step(s.loc);
+    }
   }
 }
 void interpreter::visit(const stmt_return<lox_obj>& s)
@@ -78,16 +186,97 @@ void interpreter::visit(const stmt_return<lox_obj>& s)
   {
     value = evaluate(s.value);
   }
+  LOX_COUNT(returns_thrown);
   throw lox_return(create_another(value));
 }
 
 lox_obj interpreter::visit(const expr_assign<lox_obj>& e)
 {
   lox_obj value = evaluate(e.value);
-  m_env->assign(e.name, value);
+  LOX_COUNT(assignments);
+  m_env->assign(e.name, e.loc, value);
   return create_another(value);
 }
 
+lox_obj interpreter::visit(const expr_cached<lox_obj>& e)
+{
+  if (e.epoch)
+  {
+    if (e.cell->epoch == *e.epoch)
+    {
+      return create_another(e.cell->value);
+    }
+    lox_obj value = evaluate(e.expr);
+    e.cell->value = create_another(value);
+    e.cell->epoch = *e.epoch;
+    return value;
+  }
+  if (e.reuse)
+  {
+    return create_another(e.cell->value);
+  }
+  lox_obj value = evaluate(e.expr);
+  e.cell->value = create_another(value);
+  return value;
+}
+
+lox_obj interpreter::visit(const expr_array<lox_obj>& e)
+{
+  arg_buffer buffer(e.elements.size());
+  std::span<lox_obj> elements = buffer.values();
+  for (std::size_t i = 0 ; i < e.elements.size() ; ++i) 
+  {
+    elements[i] = evaluate(e.elements[i]);
+  }
+  return make_array(elements);
+}
+
+lox_obj interpreter::visit(const expr_map<lox_obj>& e)
+{
+  arg_buffer buffer(2 * e.keys.size());
+  std::span<lox_obj> entries = buffer.values();
+  for (std::size_t i = 0 ; i < e.keys.size() ; ++i) 
+  {
+    entries[2 * i] = evaluate(e.keys[i]);
+    entries[2 * i + 1] = evaluate(e.values[i]);
+  }
+  return make_map(entries, e.loc);
+}
+
+// a[i] and a[i] = v work on the array or map where the variable holds it
+// instead of a copy of the value, as long as nothing in between can rebind a
+lox_obj interpreter::visit(const expr_index<lox_obj>& e)
+{
+  if (e.obj->type() == expr_type::_variable && binds_nothing(*e.index))
+  {
+    LOX_COUNT(lookups);
+    const lox_obj& target = m_env->get(static_cast<const expr_variable<lox_obj>&>(*e.obj).name, e.obj->loc);
+    lox_obj key = evaluate(e.index);
+    return index(target, key, e.loc);
+  }
+  lox_obj target = evaluate(e.obj);
+  lox_obj key = evaluate(e.index);
+  return index(target, key, e.loc);
+}
+
+lox_obj interpreter::visit(const expr_index_set<lox_obj>& e)
+{
+  if (e.obj->type() == expr_type::_variable && binds_nothing(*e.index) && binds_nothing(*e.value))
+  {
+    LOX_COUNT(lookups);
+    const lox_obj& target = m_env->get(static_cast<const expr_variable<lox_obj>&>(*e.obj).name, e.obj->loc);
+    lox_obj key = evaluate(e.index);
+    lox_obj value = evaluate(e.value);
+    index_set(target, key, value, e.loc);
+    return value;
+  }
+  lox_obj target = evaluate(e.obj);
+  lox_obj key = evaluate(e.index);
+  lox_obj value = evaluate(e.value);
+  index_set(target, key, value, e.loc);
+  return value;
+}
+
 lox_obj interpreter::visit(const expr_literal<lox_obj>& e) 
 {
   return create_another(e.value);
@@ -96,7 +285,7 @@ lox_obj interpreter::visit(const expr_literal<lox_obj>& e)
 lox_obj interpreter::visit(const expr_logical<lox_obj>& e)  
 {
   lox_obj left = evaluate(e.left);
-  if (e.op.type == token_type::OR)
+  if (e.op == token_type::OR)
   {
     if (is_truthy(left)) { return left; }
   }
@@ -115,51 +304,226 @@ lox_obj interpreter::visit(const expr_grouping<lox_obj>& e)
 lox_obj interpreter::visit(const expr_unary<lox_obj>& e)
 {
   lox_obj right = evaluate(e.right);
-  switch (e.op.type)
+  return unary(e.op, e.loc, right);
+}
+
+lox_obj interpreter::visit(const expr_variable<lox_obj>& e)
+{
+  LOX_COUNT(lookups);
+  return create_another(m_env->get(e.name, e.loc));
+}
+
+lox_obj interpreter::visit(const expr_binary<lox_obj>& e) 
+{
+  lox_obj left = evaluate(e.left);
+  lox_obj right = evaluate(e.right);
+  return binary(e.op, e.loc, left, right, e.feedback);
+}
+
+lox_obj interpreter::visit(const expr_call<lox_obj>& e)
+{
+  lox_obj callee = evaluate(e.callee);
+
+  arg_buffer buffer(e.args.size());
+  std::span<lox_obj> args = buffer.values();
+  for (std::size_t i = 0 ; i < e.args.size() ; ++i) 
+  {
+    args[i] = evaluate(e.args[i]);
+  }
+
+  return call(callee, args, e.loc);
+}
+
+void interpreter::execute(const std::vector<stmt_t>& statements)
+{
+  for (const auto& s : statements)
+  {
+    execute(s);
+  }
+}
+
+void interpreter::execute_block(const std::vector<stmt_t>& statements, std::unique_ptr<environment> new_env)
+{
+  scoped(std::move(new_env), [&]() { execute(statements); });
+}
+
+void interpreter::execute_frame(const std::vector<stmt_t>& statements, std::unique_ptr<environment>& env)
+{
+  scoped(env, [&]() { execute(statements); });
+}
+      
+
+// the jump tables live in evaluate and execute themselves, a separate 
+// dispatch function would cost one more frame on every level of recursion 
+// and lox_return unwinds through all of them. the qualified visit calls 
+// are not virtual, nodes without a handler go through accept. so does 
+// return: its visit always throws, the compiler calls it instead of 
+// jumping to it and execute would stay on the unwind path.
+#if defined(__GNUC__) || defined(__clang__)
+#define LOX_COMPUTED_GOTO
+#endif
+
+lox_obj interpreter::evaluate(const expr_t& e)  
+{
+  if (m_profiler) [[unlikely]]
+  {
+    m_profiler->evaluation();
+  }
+  LOX_COUNT(expr_dispatches[static_cast<std::size_t>(e->type())]);
+  if (m_dispatch == dispatch::visitor)
+  {
+    return e->accept(*this);
+  }
+  lox_expression<lox_obj>& node = *e;
+#ifdef LOX_COMPUTED_GOTO
+  static void* const handlers[] = {
+    &&_assign, &&_binary, &&_call, &&_other, &&_grouping, &&_literal, 
+    &&_logical, &&_other, &&_other, &&_other, &&_unary, &&_variable, &&_cached,
+    &&_array, &&_index, &&_index_set, &&_map
+  };
+  static_assert(std::size(handlers) == static_cast<std::size_t>(expr_type::_map) + 1);
+  goto *handlers[static_cast<std::size_t>(node.type())];
+  _assign: return interpreter::visit(static_cast<const expr_assign<lox_obj>&>(node));
+  _binary: return interpreter::visit(static_cast<const expr_binary<lox_obj>&>(node));
+  _call: return interpreter::visit(static_cast<const expr_call<lox_obj>&>(node));
+  _grouping: return interpreter::visit(static_cast<const expr_grouping<lox_obj>&>(node));
+  _literal: return interpreter::visit(static_cast<const expr_literal<lox_obj>&>(node));
+  _logical: return interpreter::visit(static_cast<const expr_logical<lox_obj>&>(node));
+  _unary: return interpreter::visit(static_cast<const expr_unary<lox_obj>&>(node));
+  _variable: return interpreter::visit(static_cast<const expr_variable<lox_obj>&>(node));
+  _cached: return interpreter::visit(static_cast<const expr_cached<lox_obj>&>(node));
+  _array: return interpreter::visit(static_cast<const expr_array<lox_obj>&>(node));
+  _index: return interpreter::visit(static_cast<const expr_index<lox_obj>&>(node));
+  _index_set: return interpreter::visit(static_cast<const expr_index_set<lox_obj>&>(node));
+  _map: return interpreter::visit(static_cast<const expr_map<lox_obj>&>(node));
+  _other: return node.accept(*this);
+#else
+  switch (node.type())
+  {
+    case expr_type::_assign: return interpreter::visit(static_cast<const expr_assign<lox_obj>&>(node));
+    break; case expr_type::_binary: return interpreter::visit(static_cast<const expr_binary<lox_obj>&>(node));
+    break; case expr_type::_call: return interpreter::visit(static_cast<const expr_call<lox_obj>&>(node));
+    break; case expr_type::_grouping: return interpreter::visit(static_cast<const expr_grouping<lox_obj>&>(node));
+    break; case expr_type::_literal: return interpreter::visit(static_cast<const expr_literal<lox_obj>&>(node));
+    break; case expr_type::_logical: return interpreter::visit(static_cast<const expr_logical<lox_obj>&>(node));
+    break; case expr_type::_unary: return interpreter::visit(static_cast<const expr_unary<lox_obj>&>(node));
+    break; case expr_type::_variable: return interpreter::visit(static_cast<const expr_variable<lox_obj>&>(node));
+    break; case expr_type::_cached: return interpreter::visit(static_cast<const expr_cached<lox_obj>&>(node));
+    break; case expr_type::_array: return interpreter::visit(static_cast<const expr_array<lox_obj>&>(node));
+    break; case expr_type::_index: return interpreter::visit(static_cast<const expr_index<lox_obj>&>(node));
+    break; case expr_type::_index_set: return interpreter::visit(static_cast<const expr_index_set<lox_obj>&>(node));
+    break; case expr_type::_map: return interpreter::visit(static_cast<const expr_map<lox_obj>&>(node));
+    break; default: return node.accept(*this);
+  }
+#endif
+}
+
+void interpreter::execute(const stmt_t& statement)
+{
+  if (m_profiler) [[unlikely]]
+  {
+    m_profiler->statement(statement->loc);
+  }
+  LOX_COUNT(stmt_dispatches[static_cast<std::size_t>(statement->type())]);
+  if (m_dispatch == dispatch::visitor)
+  {
+    return statement->accept(*this);
+  }
+  lox_statement<lox_obj>& node = *statement;
+#ifdef LOX_COMPUTED_GOTO
+  static void* const handlers[] = {
+    &&_block, &&_other, &&_expression, &&_function, &&_if, &&_print, &&_other, &&_var, &&_while
+  };
+  static_assert(std::size(handlers) == static_cast<std::size_t>(stmt_type::_while) + 1);
+  goto *handlers[static_cast<std::size_t>(node.type())];
+  _block: return interpreter::visit(static_cast<const stmt_block<lox_obj>&>(node));
+  _expression: return interpreter::visit(static_cast<const stmt_expression<lox_obj>&>(node));
+  _function: return interpreter::visit(static_cast<const stmt_function<lox_obj>&>(node));
+  _if: return interpreter::visit(static_cast<const stmt_if<lox_obj>&>(node));
+  _print: return interpreter::visit(static_cast<const stmt_print<lox_obj>&>(node));
+  _var: return interpreter::visit(static_cast<const stmt_var<lox_obj>&>(node));
+  _while: return interpreter::visit(static_cast<const stmt_while<lox_obj>&>(node));
+  _other: return node.accept(*this);
+#else
+  switch (node.type())
+  {
+    case stmt_type::_block: return interpreter::visit(static_cast<const stmt_block<lox_obj>&>(node));
+    break; case stmt_type::_expression: return interpreter::visit(static_cast<const stmt_expression<lox_obj>&>(node));
+    break; case stmt_type::_function: return interpreter::visit(static_cast<const stmt_function<lox_obj>&>(node));
+    break; case stmt_type::_if: return interpreter::visit(static_cast<const stmt_if<lox_obj>&>(node));
+    break; case stmt_type::_print: return interpreter::visit(static_cast<const stmt_print<lox_obj>&>(node));
+    break; case stmt_type::_var: return interpreter::visit(static_cast<const stmt_var<lox_obj>&>(node));
+    break; case stmt_type::_while: return interpreter::visit(static_cast<const stmt_while<lox_obj>&>(node));
+    break; default: return node.accept(*this);
+  }
+#endif
+}
+
+lox_obj interpreter::unary(token_type op, source_loc loc, const lox_obj& right)
+{
+  switch (op)
   {
     case token_type::BANG: return !is_truthy(right);
     break;case token_type::MINUS: 
     {
-      check_number_operand(e.op, right);
+      check_number_operand(loc, right);
       return lox_obj(-1*right.number());
     }
   }
   return lox_obj(); // equivalent to null
 }
 
-lox_obj interpreter::visit(const expr_variable<lox_obj>& e)
-{
-  return create_another(m_env->get(e.name));
-}
-
-lox_obj interpreter::visit(const expr_binary<lox_obj>& e) 
+lox_obj interpreter::binary(token_type op, source_loc loc, const lox_obj& left, const lox_obj& right, type_feedback& feedback)
 {
-  lox_obj left = evaluate(e.left);
-  lox_obj right = evaluate(e.right);
-  switch (e.op.type)
+  if (feedback != type_feedback::generic)
+  {
+    if (left.is_number() && right.is_number()) [[likely]]
+    {
+      feedback = type_feedback::number;
+      const double l = left.as_number();
+      const double r = right.as_number();
+      switch (op)
+      {
+        case token_type::GREATER: return l > r;
+        break; case token_type::GREATER_EQUAL: return l >= r;
+        break; case token_type::LESS: return l < r;
+        break; case token_type::LESS_EQUAL: return l <= r;
+        break; case token_type::BANG_EQUAL: return l != r;
+        break; case token_type::EQUAL_EQUAL: return l == r;
+        break; case token_type::MINUS: return l - r;
+        break; case token_type::SLASH: return l / r;
+        break; case token_type::STAR: return l * r;
+        break; case token_type::PLUS: return l + r;
+        break; default: break;
+      }
+    }
+    // deoptimize, the checked path below handles every operand type
+    feedback = type_feedback::generic;
+  }
+  switch (op)
   {
     case token_type::GREATER : 
-      check_number_operand(e.op, left, right);
+      check_number_operand(loc, left, right);
       return left.number() >  right.number();
     break; case token_type::GREATER_EQUAL : 
-      check_number_operand(e.op, left, right);
+      check_number_operand(loc, left, right);
       return left.number() >=  right.number();
     break; case token_type::LESS : 
-      check_number_operand(e.op, left, right);
+      check_number_operand(loc, left, right);
       return left.number() <  right.number();
     break; case token_type::LESS_EQUAL :
-      check_number_operand(e.op, left, right);
+      check_number_operand(loc, left, right);
       return left.number() <=  right.number();
     break; case token_type::BANG_EQUAL : return !is_equal(left, right);
     break; case token_type::EQUAL_EQUAL : return is_equal(left, right);
     break; case token_type::MINUS : 
-      check_number_operand(e.op, left, right);
+      check_number_operand(loc, left, right);
       return left.number() - right.number();
     break; case token_type::SLASH : 
-      check_number_operand(e.op, left, right);
+      check_number_operand(loc, left, right);
       return left.number() / right.number();
     break; case token_type::STAR : 
-      check_number_operand(e.op, left, right);
+      check_number_operand(loc, left, right);
       return left.number() * right.number();
     break; case token_type::PLUS :
     {
@@ -175,88 +539,118 @@ lox_obj interpreter::visit(const expr_binary<lox_obj>& e)
       }
       else 
       {
-        runtime_error(e.op, " Operands must be two numbers or two strings.");
+        runtime_error(loc, "Operands must be two numbers or two strings.");
       }
     }
   }
 }
 
 
-lox_obj interpreter::visit(const expr_call<lox_obj>& e)
+lox_obj interpreter::call(const lox_obj& callee, std::span<const lox_obj> args, source_loc loc)
 {
-  lox_obj callee = evaluate(e.callee);
-  std::vector<lox_obj> args;
-  for (const expr_t& arg : e.args) 
+  if (callee.type() != value_type::callable) 
   {
-    args.push_back(evaluate(arg));
+    runtime_error(loc, "Can only call functions and classes.");
   }
 
-  if (callee.type() == value_type::callable) 
+  std::shared_ptr<lox_callable> func = callee.callable();
+  if (args.size() != func->arity()) 
+  { 
+    std::string s{"Expected "};
+    s.append(std::to_string(func->arity()));
+    s.append(" arguments but got ");
+    s.append(std::to_string(args.size()));
+    s.append(".");
+    runtime_error(loc, s);
+  }
+  meter_scope metered(m_meter, loc);
+  try
   {
-    lox_function func = callee.callable();
-    if (args.size() != func.arity()) 
-    { 
-      std::string s{"Expected "};
-      s.append(std::to_string(func.arity()));
-      s.append(" arguments but got ");
-      s.append(std::to_string(args.size()));
-      s.append(".");
-      runtime_error(e.paren, s);
-    }
-    else
-    {
-      return func.call(*this, args);
-    }
-  } 
-  else 
+    return func->call(*this, args);
+  }
+  catch(const lox_error&)
+  {
+    throw;
+  }
+  catch(const std::runtime_error& err)
   {
-    runtime_error(e.paren, "Can only call functions and classes.");
+    // natives do not know where they were called from
+    runtime_error(loc, err.what());
   }
-  throw std::runtime_error("fick dich");
 }
 
-void interpreter::execute(const stmt_t& statement)
+lox_obj interpreter::make_array(std::span<lox_obj> elements)
 {
-  statement->accept(*this);
+  return lox_obj(std::make_shared<lox_array>(elements));
 }
-void interpreter::execute(const std::vector<stmt_t>& statements)
+
+lox_obj interpreter::make_map(std::span<const lox_obj> entries, source_loc loc)
 {
-  for (const auto& s : statements)
+  auto map = std::make_shared<lox_map>();
+  for (std::size_t i = 0 ; i + 1 < entries.size() ; i += 2)
   {
-    s->accept(*this);
+    check_key(entries[i], loc);
+    map->set(entries[i], entries[i + 1]);
   }
+  return lox_obj(std::move(map));
 }
 
-void interpreter::execute_block(const std::vector<stmt_t>& statements, std::unique_ptr<environment> new_env)
+// a key that is not in a map reads as nil
+lox_obj interpreter::index(const lox_obj& target, const lox_obj& key, source_loc loc)
 {
-  std::unique_ptr<environment> prev = std::move(m_env);
-  try
+  switch (target.type())
   {
-    finally on_exit([this, &prev]()
-    { 
-      m_env = std::move(prev); 
-    });
-
-    m_env = std::move(new_env);
-    m_env->set_enclosing(prev.get());
-    execute(statements);
+    case value_type::array:
+    {
+      const lox_array& array = target.as_array();
+      return array.get(element(array, key, loc));
+    }
+    break; case value_type::map:
+    {
+      const lox_obj* value = target.as_map().find(key);
+      return value ? create_another(*value) : lox_obj();
+    }
+    break; default: runtime_error(loc, "Only arrays and maps can be indexed.");
   }
-  catch(const lox_return& e)
-  {
-    throw lox_return(e.value());
-  } 
-  catch(const std::exception& e)
+}
+
+void interpreter::index_set(const lox_obj& target, const lox_obj& key, const lox_obj& value, source_loc loc)
+{
+  switch (target.type())
   {
-    std::cerr << e.what() << '\n';
+    case value_type::array:
+    {
+      lox_array& array = target.as_array();
+      array.set(element(array, key, loc), value);
+    }
+    break; case value_type::map:
+    {
+      check_key(key, loc);
+      target.as_map().set(key, value);
+    }
+    break; default: runtime_error(loc, "Only arrays and maps can be indexed.");
   }
-
 }
-      
 
-lox_obj interpreter::evaluate(const expr_t& e)  
+std::size_t interpreter::element(const lox_array& array, const lox_obj& key, source_loc loc) const
 {
-  return e->accept(*this);
+  if (!key.is_number())
+  {
+    runtime_error(loc, "Index must be a number.");
+  }
+  const double i = key.as_number();
+  if (!(i >= 0 && i < static_cast<double>(array.size())))
+  {
+    runtime_error(loc, "Index out of range.");
+  }
+  const auto n = static_cast<std::size_t>(i);
+  if (static_cast<double>(n) != i)
+  {
+    runtime_error(loc, "Index must be a whole number.");
+  }
+  return n;
 }
+
 bool interpreter::is_truthy(const lox_obj& obj)  
 {
   if (obj.nil())
@@ -292,13 +686,21 @@ bool interpreter::is_equal(const lox_obj& left, const lox_obj& right) const
   {
     return left.string() == right.string();
   }
+  else if (both_type(value_type::array))
+  {
+    return &left.as_array() == &right.as_array();
+  }
+  else if (both_type(value_type::map))
+  {
+    return &left.as_map() == &right.as_map();
+  }
   else 
   {
     return false; 
   }
 }
 
-void interpreter::check_number_operand(const token& op, const lox_obj& operand) const 
+void interpreter::check_number_operand(source_loc loc, const lox_obj& operand) const 
 {
   if (operand.type() == value_type::number) 
   {
@@ -306,10 +708,10 @@ void interpreter::check_number_operand(const token& op, const lox_obj& operand)
   }
   else 
   {
-    runtime_error(op, " Operand must be a number.");
+    runtime_error(loc, "Operand must be a number.");
   }
 }
-void interpreter::check_number_operand(const token& op, const lox_obj& left, const lox_obj& right) const 
+void interpreter::check_number_operand(source_loc loc, const lox_obj& left, const lox_obj& right) const 
 {
   if (left.type() == value_type::number && right.type() == value_type::number) 
   {
@@ -317,7 +719,7 @@ void interpreter::check_number_operand(const token& op, const lox_obj& left, con
   }
   else 
   {
-    runtime_error(op, " Operands must be a number.");
+    runtime_error(loc, "Operands must be numbers.");
   }
 }
 
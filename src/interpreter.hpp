@@ -1,13 +1,27 @@
 #pragma once 
 
+#include <array>
+#include <iostream>
+#include <span>
 #include <vector>
 
 
 #include "expr.hpp"
 #include "stmt.hpp"
 #include "lox_obj.hpp"
+#include "lox_array.hpp"
+#include "lox_map.hpp"
 
 #include "environment.hpp"
+#include "error.hpp"
+#include "flat_ir.hpp"
+#include "jit.hpp"
+#include "meter.hpp"
+#include "metrics.hpp"
+#include "profiler.hpp"
+#include "return.hpp"
+#include "scheduler.hpp"
+#include "vm.hpp"
 
 
 namespace cwt
@@ -23,18 +37,62 @@ namespace cwt
   };
 
 
+  // how nodes reach their visit function. visitor goes through the virtual
+  // accept/visit pair, threaded jumps on the kind stored in the node
+  enum class dispatch
+  {
+    visitor = 0, threaded
+  };
+
   class interpreter : public expr_visitor<lox_obj>, public stmt_visitor<lox_obj>
   {
     using expr_t = std::unique_ptr<lox_expression<lox_obj>>;
     using stmt_t = std::unique_ptr<lox_statement<lox_obj>>;
+    // transpiled programs use the operators and calls of the interpreter
+    friend class aot_runtime;
+    // fibers swap the environment chain of the interpreter
+    friend class scheduler;
 
     public:
+      interpreter(std::ostream& out = std::cout);
+
       environment* get_env_ptr();
+      environment* get_globals_ptr();
+      // used to print positions of runtime errors, may be null
+      void set_source_map(const source_map* sources);
+      // hooks calls, statements and evaluations, null disables profiling
+      void set_profiler(profiler* p);
+      profiler* get_profiler();
+      // compiles hot functions to machine code, null runs everything in the interpreter
+      void set_jit(jit* j);
+      jit* get_jit();
+      // counts loop iterations and calls against a budget, null runs unmetered.
+      // the jit is not used while metered, native code would not count.
+      void set_meter(meter* m);
+      meter* get_meter();
+      // fibers spawned by the script, their event loop runs after each interpret
+      scheduler& get_scheduler();
+      void set_dispatch(dispatch d);
+      void define_native(const std::string& name, std::size_t arity, lox_native::function_t func);
       void interpret(const std::vector<stmt_t>& statements);
 
       void execute(const stmt_t& statement);
       void execute(const std::vector<stmt_t>& statements);
       void execute_block(const std::vector<stmt_t>& statements, std::unique_ptr<environment> new_env);
+      // like execute_block, env gets its environment back once the block is
+      // done, however it ends
+      void execute_frame(const std::vector<stmt_t>& statements, std::unique_ptr<environment>& env);
+
+      // the same evaluation on a flattened program, it has to outlive 
+      // the functions it defines
+      void interpret(const flat_program& program);
+      void execute(const flat_program& program, std::uint32_t list);
+      void execute_block(const flat_program& program, std::uint32_t list, std::unique_ptr<environment> new_env);
+
+      // runs code compiled for the register machine, the program has to 
+      // outlive the functions it defines
+      void interpret(const vm_program& program);
+      lox_obj execute(const vm_program& program, std::uint32_t chunk, std::unique_ptr<environment> new_env);
 
       void visit(const stmt_block<lox_obj>& s) override ;
       void visit(const stmt_expression<lox_obj>& s) override ;
@@ -53,15 +111,112 @@ namespace cwt
       lox_obj visit(const expr_variable<lox_obj>& e) override;
       lox_obj visit(const expr_binary<lox_obj>& e) override;
       lox_obj visit(const expr_call<lox_obj>& e) override;
+      lox_obj visit(const expr_cached<lox_obj>& e) override;
+      lox_obj visit(const expr_array<lox_obj>& e) override;
+      lox_obj visit(const expr_index<lox_obj>& e) override;
+      lox_obj visit(const expr_index_set<lox_obj>& e) override;
+      lox_obj visit(const expr_map<lox_obj>& e) override;
 
     private:
+      // small runs of values (arguments, registers) live on the stack, 
+      // the callee gets a view on them
+      template<std::size_t N>
+      class inline_buffer
+      {
+        public:
+          inline_buffer(std::size_t count)
+          {
+            if (count <= N)
+            {
+              m_values = std::span<lox_obj>(m_inline.data(), count);
+            }
+            else 
+            {
+              m_heap.resize(count);
+              m_values = std::span<lox_obj>(m_heap);
+            }
+          }
+          std::span<lox_obj> values() noexcept { return m_values; }
+        private:
+          std::array<lox_obj, N> m_inline;
+          std::vector<lox_obj> m_heap;
+          std::span<lox_obj> m_values;
+      };
+      using arg_buffer = inline_buffer<8>;
+
+      // runs body in new_env, runtime errors end the block and get reported here
+      template<typename Body>
+      void scoped(std::unique_ptr<environment>&& new_env, Body&& body)
+      {
+        scoped(new_env, std::forward<Body>(body));
+      }
+
+      // the same, new_env gets its environment back at the end
+      template<typename Body>
+      void scoped(std::unique_ptr<environment>& new_env, Body&& body)
+      {
+        std::unique_ptr<environment> prev = std::move(m_env);
+        try
+        {
+          finally on_exit([this, &prev, &new_env]()
+          { 
+            new_env = std::move(m_env);
+            m_env = std::move(prev); 
+          });
+
+          m_env = std::move(new_env);
+          m_env->set_enclosing(prev.get());
+          body();
+        }
+        catch(const lox_return& e)
+        {
+          LOX_COUNT(returns_thrown);
+          throw lox_return(e.value());
+        } 
+        catch(const std::exception& e)
+        {
+          report_runtime_error(e, m_sources);
+        }
+      }
+
       lox_obj evaluate(const expr_t& e)  ;
+      lox_obj evaluate(const flat_program& program, std::uint32_t node);
+      void execute_node(const flat_program& program, std::uint32_t node);
+      lox_obj run(const vm_program& program, const vm_chunk& chunk);
+      lox_obj unary(token_type op, source_loc loc, const lox_obj& right);
+      lox_obj binary(token_type op, source_loc loc, const lox_obj& left, const lox_obj& right, type_feedback& feedback);
+      lox_obj call(const lox_obj& callee, std::span<const lox_obj> args, source_loc loc);
+      // moves the values out of elements
+      lox_obj make_array(std::span<lox_obj> elements);
+      // entries holds a key and its value after each other
+      lox_obj make_map(std::span<const lox_obj> entries, source_loc loc);
+      lox_obj index(const lox_obj& target, const lox_obj& key, source_loc loc);
+      void index_set(const lox_obj& target, const lox_obj& key, const lox_obj& value, source_loc loc);
+      std::size_t element(const lox_array& array, const lox_obj& key, source_loc loc) const;
       bool is_truthy(const lox_obj& obj)  ;
       bool is_equal(const lox_obj& left, const lox_obj& right) const ;
       
-      void check_number_operand(const token& op, const lox_obj& operand) const ;
-      void check_number_operand(const token& op, const lox_obj& left, const lox_obj& right) const ;
+      void check_number_operand(source_loc loc, const lox_obj& operand) const ;
+      void check_number_operand(source_loc loc, const lox_obj& left, const lox_obj& right) const ;
     private:
       std::unique_ptr<environment> m_env = std::make_unique<environment>();
+      environment* m_globals = m_env.get();
+      std::ostream* m_out;
+      const source_map* m_sources = nullptr;
+      profiler* m_profiler = nullptr;
+      jit* m_jit = nullptr;
+      meter* m_meter = nullptr;
+      dispatch m_dispatch = dispatch::threaded;
+      std::uint64_t m_epochs = 0;
+      // loops the running fiber is inside, innermost last. fibers share the
+      // loop nodes, whoever the scheduler switches to puts its epochs back
+      struct loop_run
+      {
+        const stmt_while<lox_obj>* loop;
+        std::uint64_t epoch;
+      };
+      std::vector<loop_run> m_loops;
+      // last, so suspended fibers go before the environments they point into
+      scheduler m_scheduler{*this};
   };
 } // namespace cwt
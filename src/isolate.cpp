@@ -0,0 +1,133 @@
+#include <optional>
+#include <unordered_map>
+
+#include "isolate.hpp"
+#include "lox_array.hpp"
+#include "lox_map.hpp"
+#include "parser.hpp"
+#include "scanner.hpp"
+#include "thread_pool.hpp"
+
+namespace cwt
+{
+  namespace
+  {
+    // lox values share arrays and maps, an isolate gets copies of its own.
+    // copies is keyed by the original, so one held twice or by itself is
+    // shared the same way in the copy
+    lox_obj isolated(const lox_obj& value, std::unordered_map<const void*, lox_obj>& copies)
+    {
+      switch (value.type())
+      {
+        case value_type::array:
+        {
+          const lox_array& original = value.as_array();
+          if (auto it = copies.find(&original) ; it != copies.end())
+          {
+            return create_another(it->second);
+          }
+          if (original.numeric())
+          {
+            const std::span<const double> numbers = original.numbers();
+            lox_obj copy(std::make_shared<lox_array>(std::vector<double>(numbers.begin(), numbers.end())));
+            copies.emplace(&original, create_another(copy));
+            return copy;
+          }
+          auto copy = std::make_shared<lox_array>();
+          copies.emplace(&original, lox_obj(copy));
+          for (std::size_t i = 0 ; i < original.size() ; ++i)
+          {
+            copy->push(isolated(original.get(i), copies));
+          }
+          return lox_obj(std::move(copy));
+        }
+        break; case value_type::map:
+        {
+          const lox_map& original = value.as_map();
+          if (auto it = copies.find(&original) ; it != copies.end())
+          {
+            return create_another(it->second);
+          }
+          auto copy = std::make_shared<lox_map>();
+          copies.emplace(&original, lox_obj(copy));
+          original.for_each([&copy, &copies](const lox_obj& key, const lox_obj& v) {
+            copy->set(key, isolated(v, copies));
+          });
+          return lox_obj(std::move(copy));
+        }
+        break; default: return create_another(value);
+      }
+    }
+  } // namespace
+
+isolate::isolate() : m_interpreter(m_output)
+{
+  m_errors.diagnostics = &m_diagnostics;
+  m_interpreter.set_source_map(&m_sources);
+}
+
+void isolate::define(const std::string& name, const lox_obj& value)
+{
+  std::unordered_map<const void*, lox_obj> copies;
+  m_interpreter.get_globals_ptr()->define(name, isolated(value, copies));
+}
+
+isolate_result isolate::run(const std::string& src, const budget& limits)
+{
+  scoped_error_state scope(m_errors);
+  m_errors.has_error = false;
+  m_errors.has_runtime_error = false;
+
+  std::string name{"<run "};
+  name.append(std::to_string(m_programs.size() + 1));
+  name.append(">");
+  const source_loc base = m_sources.add(std::move(name), src);
+  scanner scanner(src);
+  token_stream tokens = scanner.scan_stream();
+  parser<lox_obj> parser(tokens, base);
+  m_programs.push_back(parser.parse());
+  if (!m_errors.has_error)
+  {
+    std::optional<meter> metered;
+    if (!limits.unlimited())
+    {
+      m_interpreter.set_meter(&metered.emplace(limits));
+    }
+    m_interpreter.interpret(m_programs.back());
+    m_interpreter.set_meter(nullptr);
+  }
+
+  isolate_result result;
+  result.ok = !m_errors.has_error && !m_errors.has_runtime_error;
+  result.output = m_output.str();
+  result.diagnostics = m_diagnostics.str();
+  m_output.str("");
+  m_diagnostics.str("");
+  return result;
+}
+
+interpreter& isolate::get_interpreter()
+{
+  return m_interpreter;
+}
+
+error_state& isolate::errors()
+{
+  return m_errors;
+}
+
+std::vector<isolate_result> run_batch(thread_pool& pool, const std::vector<isolate_job>& jobs)
+{
+  std::vector<isolate_result> results(jobs.size());
+  pool.parallel_for(jobs.size(), [&jobs, &results](std::size_t i) {
+    isolate iso;
+    for (const auto& [name, value] : jobs[i].inputs)
+    {
+      iso.define(name, value);
+    }
+    results[i] = iso.run(jobs[i].source, jobs[i].limits);
+  });
+  return results;
+}
+
+} // namespace cwt
@@ -0,0 +1,65 @@
+#pragma once 
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "error.hpp"
+#include "interpreter.hpp"
+#include "meter.hpp"
+
+namespace cwt
+{
+  class thread_pool;
+
+  struct isolate_result
+  {
+    bool ok = false;
+    std::string output;
+    std::string diagnostics;
+  };
+
+  struct isolate_job
+  {
+    std::string source;
+    std::vector<std::pair<std::string, lox_obj>> inputs;
+    budget limits;
+  };
+
+  // an interpreter with its own globals, error state and output. isolates share 
+  // no mutable state, so different isolates can run on different threads at once. 
+  // a single isolate must only be used by one thread at a time.
+  class isolate
+  {
+    using stmt_t = std::unique_ptr<lox_statement<lox_obj>>;
+
+    public:
+      isolate();
+      isolate(const isolate&) = delete;
+      isolate& operator=(const isolate&) = delete;
+
+      // arrays and maps in value are copied, the isolate shares none with the caller
+      void define(const std::string& name, const lox_obj& value);
+      // a run that goes over limits stops with a [BUDGET] diagnostic and is not ok
+      isolate_result run(const std::string& src, const budget& limits = {});
+
+      interpreter& get_interpreter();
+      error_state& errors();
+
+    private:
+      error_state m_errors;
+      std::ostringstream m_output;
+      std::ostringstream m_diagnostics;
+      source_map m_sources;
+      // functions point into the syntax tree, so every program run stays alive
+      std::vector<std::vector<stmt_t>> m_programs;
+      interpreter m_interpreter;
+  };
+
+  // evaluates every job in a fresh isolate, spread over the pools workers.
+  // results are in the same order as the jobs.
+  std::vector<isolate_result> run_batch(thread_pool& pool, const std::vector<isolate_job>& jobs);
+
+} // namespace cwt
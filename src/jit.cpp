@@ -0,0 +1,689 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "jit.hpp"
+#include "lox_function.hpp"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define LOX_JIT_X86_64
+#include <sys/mman.h>
+#endif
+
+namespace cwt
+{
+  namespace
+  {
+    using expr_t = std::unique_ptr<lox_expression<lox_obj>>;
+    using stmt_t = std::unique_ptr<lox_statement<lox_obj>>;
+
+    // what the compiled body leaves in eax, a number result is in xmm0
+    enum status : int
+    {
+      returned_number = 0, returned_nil = 1, bailed_out = 2
+    };
+
+    // a function that bails out this often is left to the interpreter
+    constexpr std::uint32_t max_bailouts = 16;
+
+#ifdef LOX_JIT_X86_64
+    // machine code in a mapping of its own, writable while it is copied
+    // in, executable afterwards
+    class native_code
+    {
+      public:
+        native_code(const std::vector<std::uint8_t>& code) : m_size(code.size())
+        {
+          void* memory = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+          if (memory == MAP_FAILED)
+          {
+            throw std::runtime_error("jit: cannot map memory for code");
+          }
+          std::memcpy(memory, code.data(), m_size);
+          if (mprotect(memory, m_size, PROT_READ | PROT_EXEC) != 0)
+          {
+            munmap(memory, m_size);
+            throw std::runtime_error("jit: cannot make code executable");
+          }
+          m_memory = memory;
+        }
+        ~native_code()
+        {
+          munmap(m_memory, m_size);
+        }
+        native_code(const native_code&) = delete;
+        native_code& operator=(const native_code&) = delete;
+
+        int run(const double* args, double* result) const
+        {
+          using entry_t = int (*)(const double*, double*);
+          return reinterpret_cast<entry_t>(m_memory)(args, result);
+        }
+
+      private:
+        void* m_memory = nullptr;
+        std::size_t m_size;
+    };
+
+    // just the instructions the templates below need. xmm is 0 or 1,
+    // memory operands are [rbp + disp32] or [rdi + disp32].
+    class assembler
+    {
+      public:
+        using label = std::size_t;
+
+        // condition codes after ucomisd
+        enum cc : std::uint8_t
+        {
+          below = 0x82, above_equal = 0x83, equal = 0x84, not_equal = 0x85,
+          below_equal = 0x86, above = 0x87, parity = 0x8A
+        };
+
+        void bytes(std::initializer_list<std::uint8_t> b) { m_code.insert(m_code.end(), b); }
+        void imm32(std::uint32_t v)
+        {
+          for (int i = 0 ; i < 4 ; ++i) { m_code.push_back(static_cast<std::uint8_t>(v >> (8 * i))); }
+        }
+        void imm64(std::uint64_t v)
+        {
+          for (int i = 0 ; i < 8 ; ++i) { m_code.push_back(static_cast<std::uint8_t>(v >> (8 * i))); }
+        }
+
+        void load(int xmm, std::int32_t disp)         // movsd xmm, [rbp + disp]
+        {
+          bytes({0xF2, 0x0F, 0x10, static_cast<std::uint8_t>(0x85 | xmm << 3)});
+          imm32(static_cast<std::uint32_t>(disp));
+        }
+        void store(std::int32_t disp, int xmm)        // movsd [rbp + disp], xmm
+        {
+          bytes({0xF2, 0x0F, 0x11, static_cast<std::uint8_t>(0x85 | xmm << 3)});
+          imm32(static_cast<std::uint32_t>(disp));
+        }
+        void load_argument(int xmm, std::int32_t disp) // movsd xmm, [rdi + disp]
+        {
+          bytes({0xF2, 0x0F, 0x10, static_cast<std::uint8_t>(0x87 | xmm << 3)});
+          imm32(static_cast<std::uint32_t>(disp));
+        }
+        void constant(int xmm, double value)          // mov rax, imm64 ; movq xmm, rax
+        {
+          bytes({0x48, 0xB8});
+          imm64(std::bit_cast<std::uint64_t>(value));
+          bytes({0x66, 0x48, 0x0F, 0x6E, static_cast<std::uint8_t>(0xC0 | xmm << 3)});
+        }
+        void arguments(std::int32_t disp)             // lea rdi, [rbp + disp]
+        {
+          bytes({0x48, 0x8D, 0xBD});
+          imm32(static_cast<std::uint32_t>(disp));
+        }
+        // xmm0 op= xmm1 for addsd 0x58, mulsd 0x59, subsd 0x5C, divsd 0x5E
+        void arithmetic(std::uint8_t opcode) { bytes({0xF2, 0x0F, opcode, 0xC1}); }
+        void right_to_xmm1() { bytes({0x66, 0x0F, 0x28, 0xC8}); }   // movapd xmm1, xmm0
+        void compare(int l, int r)                                   // ucomisd xmm l, xmm r
+        {
+          bytes({0x66, 0x0F, 0x2E, static_cast<std::uint8_t>(0xC0 | l << 3 | r)});
+        }
+        void status(int s)                                           // mov eax, s
+        {
+          if (s == 0) { bytes({0x31, 0xC0}); }
+          else { bytes({0xB8}); imm32(static_cast<std::uint32_t>(s)); }
+        }
+        void leave_and_return() { bytes({0xC9, 0xC3}); }
+
+        label make_label()
+        {
+          m_labels.push_back(target{});
+          return m_labels.size() - 1;
+        }
+        void bind(label l) { m_labels[l].at = m_code.size(); }
+        void jump(label l) { bytes({0xE9}); use(l); }
+        void jump_if(cc c, label l) { bytes({0x0F, c}); use(l); }
+        void call(label l) { bytes({0xE8}); use(l); }
+
+        std::size_t size() const noexcept { return m_code.size(); }
+        void patch32(std::size_t at, std::uint32_t v)
+        {
+          for (int i = 0 ; i < 4 ; ++i) { m_code[at + i] = static_cast<std::uint8_t>(v >> (8 * i)); }
+        }
+
+        std::vector<std::uint8_t> finish()
+        {
+          for (const auto& l : m_labels)
+          {
+            for (const std::size_t at : l.uses)
+            {
+              patch32(at, static_cast<std::uint32_t>(static_cast<std::int64_t>(l.at) - static_cast<std::int64_t>(at + 4)));
+            }
+          }
+          return std::move(m_code);
+        }
+
+      private:
+        struct target
+        {
+          std::size_t at = 0;
+          std::vector<std::size_t> uses;
+        };
+
+        void use(label l)
+        {
+          m_labels[l].uses.push_back(m_code.size());
+          imm32(0);
+        }
+
+        std::vector<std::uint8_t> m_code;
+        std::vector<target> m_labels;
+    };
+
+    struct unsupported {};
+
+    // one template per node. every value lives in a stack slot of the
+    // frame, expressions leave their result in xmm0. parameters come first,
+    // then locals and temporaries, slot i is at [rbp - 8 * (i + 1)].
+    class compiler
+    {
+      public:
+        compiler(const stmt_function<lox_obj>& f) : m_function(f) {}
+
+        // throws unsupported for anything outside of the numeric subset
+        std::vector<std::uint8_t> compile()
+        {
+          // entry from c++: int entry(const double* args, double* result)
+          m_body = m_asm.make_label();
+          const auto done = m_asm.make_label();
+          m_asm.bytes({0x53});                     // push rbx
+          m_asm.bytes({0x48, 0x89, 0xF3});         // mov rbx, rsi
+          m_asm.call(m_body);
+          m_asm.bytes({0x85, 0xC0});               // test eax, eax
+          m_asm.jump_if(assembler::not_equal, done);
+          m_asm.bytes({0xF2, 0x0F, 0x11, 0x03});   // movsd [rbx], xmm0
+          m_asm.bind(done);
+          m_asm.bytes({0x5B, 0xC3});               // pop rbx ; ret
+
+          // body: rdi points to the arguments
+          m_asm.bind(m_body);
+          m_bail = m_asm.make_label();
+          m_asm.bytes({0x55});                     // push rbp
+          m_asm.bytes({0x48, 0x89, 0xE5});         // mov rbp, rsp
+          m_asm.bytes({0x48, 0x81, 0xEC});         // sub rsp, frame size
+          const std::size_t frame_size = m_asm.size();
+          m_asm.imm32(0);
+
+          for (const auto& p : m_function.parameters)
+          {
+            const std::uint32_t s = declare(p);
+            m_asm.load_argument(0, static_cast<std::int32_t>(8 * s));
+            m_asm.store(slot(s), 0);
+          }
+          statements(m_function.body);
+          m_asm.status(returned_nil);
+          m_asm.leave_and_return();
+
+          m_asm.bind(m_bail);
+          m_asm.status(bailed_out);
+          m_asm.leave_and_return();
+
+          m_asm.patch32(frame_size, (8 * m_high + 15) & ~15u);
+          return m_asm.finish();
+        }
+
+        bool recursive() const noexcept { return m_recursive; }
+
+      private:
+        static std::int32_t slot(std::uint32_t s) { return -8 * static_cast<std::int32_t>(s + 1); }
+
+        std::uint32_t allocate()
+        {
+          const std::uint32_t s = m_next++;
+          m_high = std::max(m_high, m_next);
+          return s;
+        }
+
+        // every name is declared once, so a slot stands for it in the whole function
+        std::uint32_t declare(const std::string& name)
+        {
+          if (name == m_function.name || m_slots.contains(name))
+          {
+            throw unsupported{};
+          }
+          const std::uint32_t s = allocate();
+          m_slots.emplace(name, s);
+          m_visible.push_back(name);
+          return s;
+        }
+
+        // a name declared in a scope that is gone would be looked up in the caller
+        std::uint32_t visible(const std::string& name) const
+        {
+          if (std::find(m_visible.begin(), m_visible.end(), name) == m_visible.end())
+          {
+            throw unsupported{};
+          }
+          return m_slots.at(name);
+        }
+
+        void scoped(const std::vector<stmt_t>& list)
+        {
+          const std::size_t mark = m_visible.size();
+          statements(list);
+          m_visible.resize(mark);
+        }
+
+        void statements(const std::vector<stmt_t>& list)
+        {
+          for (const auto& s : list)
+          {
+            statement(*s);
+          }
+        }
+
+        void statement(lox_statement<lox_obj>& s)
+        {
+          switch (s.type())
+          {
+            case stmt_type::_expression: value(static_cast<const stmt_expression<lox_obj>&>(s).expression);
+            break; case stmt_type::_var:
+            {
+              const auto& v = static_cast<const stmt_var<lox_obj>&>(s);
+              // a variable without initializer is nil
+              if (!v.initializer)
+              {
+                throw unsupported{};
+              }
+              value(v.initializer);
+              m_asm.store(slot(declare(v.name)), 0);
+            }
+            break; case stmt_type::_block: scoped(static_cast<const stmt_block<lox_obj>&>(s).statements);
+            break; case stmt_type::_if:
+            {
+              const auto& i = static_cast<const stmt_if<lox_obj>&>(s);
+              const auto otherwise = m_asm.make_label();
+              const auto end = m_asm.make_label();
+              branch(i.condition, otherwise, false);
+              scoped(i.then_branch);
+              m_asm.jump(end);
+              m_asm.bind(otherwise);
+              scoped(i.else_branch);
+              m_asm.bind(end);
+            }
+            break; case stmt_type::_while:
+            {
+              const auto& w = static_cast<const stmt_while<lox_obj>&>(s);
+              const auto top = m_asm.make_label();
+              const auto end = m_asm.make_label();
+              m_asm.bind(top);
+              branch(w.condition, end, false);
+              scoped(w.body);
+              m_asm.jump(top);
+              m_asm.bind(end);
+            }
+            break; case stmt_type::_return:
+            {
+              const auto& r = static_cast<const stmt_return<lox_obj>&>(s);
+              if (r.value)
+              {
+                value(r.value);
+                m_asm.status(returned_number);
+              }
+              else
+              {
+                m_asm.status(returned_nil);
+              }
+              m_asm.leave_and_return();
+            }
+            break; default: throw unsupported{};
+          }
+        }
+
+        // a number into xmm0
+        void value(const expr_t& e)
+        {
+          switch (e->type())
+          {
+            case expr_type::_grouping: value(static_cast<const expr_grouping<lox_obj>&>(*e).expr);
+            break; case expr_type::_cached: value(static_cast<const expr_cached<lox_obj>&>(*e).expr);
+            break; case expr_type::_literal:
+            {
+              const lox_obj& literal = static_cast<const expr_literal<lox_obj>&>(*e).value;
+              if (!literal.is_number())
+              {
+                throw unsupported{};
+              }
+              m_asm.constant(0, literal.as_number());
+            }
+            break; case expr_type::_variable:
+            {
+              m_asm.load(0, slot(visible(static_cast<const expr_variable<lox_obj>&>(*e).name)));
+            }
+            break; case expr_type::_assign:
+            {
+              const auto& a = static_cast<const expr_assign<lox_obj>&>(*e);
+              const std::uint32_t target = visible(a.name);
+              value(a.value);
+              m_asm.store(slot(target), 0);
+            }
+            break; case expr_type::_unary:
+            {
+              const auto& u = static_cast<const expr_unary<lox_obj>&>(*e);
+              if (u.op != token_type::MINUS)
+              {
+                throw unsupported{};
+              }
+              value(u.right);
+              // flips the sign bit, nan included, as the interpreter's -1 * x compiles to
+              m_asm.constant(1, -0.0);
+              m_asm.bytes({0x66, 0x0F, 0x57, 0xC1});   // xorpd xmm0, xmm1
+            }
+            break; case expr_type::_binary:
+            {
+              const auto& b = static_cast<const expr_binary<lox_obj>&>(*e);
+              std::uint8_t opcode = 0;
+              switch (b.op)
+              {
+                case token_type::PLUS: opcode = 0x58;
+                break; case token_type::STAR: opcode = 0x59;
+                break; case token_type::MINUS: opcode = 0x5C;
+                break; case token_type::SLASH: opcode = 0x5E;
+                break; default: throw unsupported{};
+              }
+              operands(b.left, b.right);
+              m_asm.arithmetic(opcode);
+            }
+            break; case expr_type::_call: call(static_cast<const expr_call<lox_obj>&>(*e));
+            break; default: throw unsupported{};
+          }
+        }
+
+        // left into xmm0, right into xmm1
+        void operands(const expr_t& left, const expr_t& right)
+        {
+          const std::uint32_t t = allocate();
+          value(left);
+          m_asm.store(slot(t), 0);
+          value(right);
+          m_asm.right_to_xmm1();
+          m_asm.load(0, slot(t));
+          --m_next;
+        }
+
+        // the arguments are stored so that the first one has the lowest address
+        void call(const expr_call<lox_obj>& c)
+        {
+          if (c.callee->type() != expr_type::_variable
+            || static_cast<const expr_variable<lox_obj>&>(*c.callee).name != m_function.name
+            || c.args.size() != m_function.parameters.size())
+          {
+            throw unsupported{};
+          }
+          const auto count = static_cast<std::uint32_t>(c.args.size());
+          const std::uint32_t base = m_next;
+          for (std::uint32_t i = 0 ; i < count ; ++i)
+          {
+            allocate();
+          }
+          for (std::uint32_t i = 0 ; i < count ; ++i)
+          {
+            value(c.args[i]);
+            m_asm.store(slot(base + count - 1 - i), 0);
+          }
+          m_asm.arguments(slot(base + count - 1));
+          m_asm.call(m_body);
+          // a nil result cannot take part in arithmetic, the interpreter reports that
+          m_asm.bytes({0x85, 0xC0});               // test eax, eax
+          m_asm.jump_if(assembler::not_equal, m_bail);
+          m_next = base;
+          m_recursive = true;
+        }
+
+        // jumps to target if the truthiness of e is when
+        void branch(const expr_t& e, assembler::label target, bool when)
+        {
+          switch (e->type())
+          {
+            case expr_type::_grouping: branch(static_cast<const expr_grouping<lox_obj>&>(*e).expr, target, when);
+            break; case expr_type::_cached: branch(static_cast<const expr_cached<lox_obj>&>(*e).expr, target, when);
+            break; case expr_type::_literal:
+            {
+              const lox_obj& literal = static_cast<const expr_literal<lox_obj>&>(*e).value;
+              const bool truthy = !literal.nil() && (literal.type() != value_type::boolean || literal.boolean());
+              if (truthy == when)
+              {
+                m_asm.jump(target);
+              }
+            }
+            break; case expr_type::_unary:
+            {
+              const auto& u = static_cast<const expr_unary<lox_obj>&>(*e);
+              if (u.op != token_type::BANG)
+              {
+                truthy_number(e, target, when);
+                break;
+              }
+              branch(u.right, target, !when);
+            }
+            break; case expr_type::_logical:
+            {
+              const auto& l = static_cast<const expr_logical<lox_obj>&>(*e);
+              // and stops at the first falsy operand, or at the first truthy one
+              const bool stop = l.op == token_type::OR;
+              if (when == stop)
+              {
+                branch(l.left, target, when);
+                branch(l.right, target, when);
+              }
+              else
+              {
+                const auto skip = m_asm.make_label();
+                branch(l.left, skip, stop);
+                branch(l.right, target, when);
+                m_asm.bind(skip);
+              }
+            }
+            break; case expr_type::_binary:
+            {
+              const auto& b = static_cast<const expr_binary<lox_obj>&>(*e);
+              if (!comparison(b, target, when))
+              {
+                truthy_number(e, target, when);
+              }
+            }
+            break; default: truthy_number(e, target, when);
+          }
+        }
+
+        // numbers are always truthy, only the effects of e matter
+        void truthy_number(const expr_t& e, assembler::label target, bool when)
+        {
+          value(e);
+          if (when)
+          {
+            m_asm.jump(target);
+          }
+        }
+
+        // ucomisd sets carry and zero for unordered operands, the conditions
+        // are picked so that a nan compares false like in the interpreter
+        bool comparison(const expr_binary<lox_obj>& b, assembler::label target, bool when)
+        {
+          int l = 0, r = 1;
+          assembler::cc yes{}, no{};
+          switch (b.op)
+          {
+            case token_type::GREATER: yes = assembler::above; no = assembler::below_equal;
+            break; case token_type::GREATER_EQUAL: yes = assembler::above_equal; no = assembler::below;
+            break; case token_type::LESS: std::swap(l, r); yes = assembler::above; no = assembler::below_equal;
+            break; case token_type::LESS_EQUAL: std::swap(l, r); yes = assembler::above_equal; no = assembler::below;
+            break; case token_type::EQUAL_EQUAL:
+            case token_type::BANG_EQUAL:
+            {
+              operands(b.left, b.right);
+              m_asm.compare(0, 1);
+              // equal is zero set and parity clear
+              if (when == (b.op == token_type::EQUAL_EQUAL))
+              {
+                const auto skip = m_asm.make_label();
+                m_asm.jump_if(assembler::parity, skip);
+                m_asm.jump_if(assembler::equal, target);
+                m_asm.bind(skip);
+              }
+              else
+              {
+                m_asm.jump_if(assembler::not_equal, target);
+                m_asm.jump_if(assembler::parity, target);
+              }
+              return true;
+            }
+            break; default: return false;
+          }
+          operands(b.left, b.right);
+          m_asm.compare(l, r);
+          m_asm.jump_if(when ? yes : no, target);
+          return true;
+        }
+
+      private:
+        const stmt_function<lox_obj>& m_function;
+        assembler m_asm;
+        assembler::label m_body = 0;
+        assembler::label m_bail = 0;
+        std::unordered_map<std::string, std::uint32_t> m_slots;
+        std::vector<std::string> m_visible;
+        std::uint32_t m_next = 0;
+        std::uint32_t m_high = 0;
+        bool m_recursive = false;
+    };
+#endif
+  }
+
+  struct jit::function_state
+  {
+    std::uint32_t calls = 0;
+    std::uint32_t bailouts = 0;
+    bool rejected = false;
+    bool recursive = false;
+#ifdef LOX_JIT_X86_64
+    std::unique_ptr<native_code> code;
+#endif
+  };
+
+  jit::jit(mode m) : m_mode(m)
+  {
+  }
+  jit::~jit() = default;
+
+  bool jit::supported() noexcept
+  {
+#ifdef LOX_JIT_X86_64
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  bool jit::verifying() const noexcept
+  {
+    return m_mode == mode::verify;
+  }
+
+  std::optional<lox_obj> jit::call(const stmt_function<lox_obj>& f, environment& caller, std::span<const lox_obj> args)
+  {
+#ifdef LOX_JIT_X86_64
+    auto& state = m_functions[&f];
+    if (!state)
+    {
+      state = std::make_unique<function_state>();
+    }
+    if (state->rejected)
+    {
+      return std::nullopt;
+    }
+    if (!state->code)
+    {
+      if (++state->calls < threshold)
+      {
+        return std::nullopt;
+      }
+      try
+      {
+        compiler c(f);
+        state->code = std::make_unique<native_code>(c.compile());
+        state->recursive = c.recursive();
+      }
+      catch(const unsupported&)
+      {
+        state->rejected = true;
+        return std::nullopt;
+      }
+    }
+
+    constexpr std::size_t inline_args = 8;
+    double inline_values[inline_args];
+    std::vector<double> heap_values;
+    double* values = inline_values;
+    if (args.size() > inline_args)
+    {
+      heap_values.resize(args.size());
+      values = heap_values.data();
+    }
+    for (std::size_t i = 0 ; i < args.size() ; ++i)
+    {
+      if (!args[i].is_number())
+      {
+        return std::nullopt;
+      }
+      values[i] = args[i].as_number();
+    }
+    // the body calls itself directly, so the name has to mean this function
+    if (state->recursive)
+    {
+      try
+      {
+        const lox_obj& bound = caller.get(f.name, f.loc);
+        auto* callee = bound.type() == value_type::callable ? dynamic_cast<lox_function*>(bound.callable().get()) : nullptr;
+        if (!callee || callee->declaration() != &f)
+        {
+          return std::nullopt;
+        }
+      }
+      catch(const std::exception&)
+      {
+        return std::nullopt;
+      }
+    }
+
+    double result = 0;
+    switch (state->code->run(values, &result))
+    {
+      case returned_number: return lox_obj(result);
+      break; case returned_nil: return lox_obj();
+      break; default:
+      {
+        if (++state->bailouts >= max_bailouts)
+        {
+          state->rejected = true;
+          state->code.reset();
+        }
+        return std::nullopt;
+      }
+    }
+#else
+    (void)f; (void)caller; (void)args;
+    return std::nullopt;
+#endif
+  }
+
+  void jit::verify(const stmt_function<lox_obj>& f, const lox_obj& native, const lox_obj& interpreted) const
+  {
+    // bitwise, so a nan with another sign counts as a difference too
+    const bool same = native.type() == interpreted.type()
+      && (!native.is_number() || std::bit_cast<std::uint64_t>(native.as_number()) == std::bit_cast<std::uint64_t>(interpreted.as_number()));
+    if (!same)
+    {
+      std::cerr << "jit: " << f.name << " returned " << native.to_string()
+        << " in native code but " << interpreted.to_string() << " in the interpreter\n";
+    }
+  }
+
+} // namespace cwt
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <unordered_map>
+
+#include "environment.hpp"
+#include "lox_obj.hpp"
+#include "stmt.hpp"
+
+namespace cwt
+{
+  // baseline compiler for hot numeric functions, linux x86-64 only. a
+  // function qualifies if it works on its parameters and locals alone:
+  // number arithmetic, comparisons in conditions, if, while, return and
+  // calls to itself. such a function has no effects, so when a guard fails
+  // (an argument that is no number, a nil result used in arithmetic, the
+  // name no longer bound to the function) the call simply runs again in
+  // the interpreter.
+  class jit
+  {
+    public:
+      // verify runs the interpreter after every native call as well and
+      // reports results that differ
+      enum class mode
+      {
+        on = 0, verify
+      };
+
+      static constexpr std::uint32_t threshold = 1000;
+
+      explicit jit(mode m = mode::on);
+      ~jit();
+
+      static bool supported() noexcept;
+
+      // the result of running f natively, nothing while f is not hot yet,
+      // cannot be compiled or a guard failed. caller is the environment f
+      // is called from.
+      std::optional<lox_obj> call(const stmt_function<lox_obj>& f, environment& caller, std::span<const lox_obj> args);
+
+      bool verifying() const noexcept;
+      void verify(const stmt_function<lox_obj>& f, const lox_obj& native, const lox_obj& interpreted) const;
+
+    private:
+      struct function_state;
+
+      std::unordered_map<const stmt_function<lox_obj>*, std::unique_ptr<function_state>> m_functions;
+      mode m_mode;
+  };
+
+} // namespace cwt
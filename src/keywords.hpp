@@ -0,0 +1,74 @@
+#pragma once 
+
+#include <string_view>
+
+#include "token.hpp"
+
+namespace cwt
+{
+  // keyword recognition as a trie unrolled into switches on the first characters,
+  // followed by one compare of the remaining tail. works on the raw lexeme, allocates nothing.
+  constexpr token_type keyword_or_identifier(std::string_view txt) noexcept
+  {
+    auto rest = [txt](std::size_t start, std::string_view tail, token_type type) {
+      return txt.size() == start + tail.size() && txt.substr(start) == tail ? type : token_type::IDENTIFIER;
+    };
+
+    if (txt.size() < 2 || txt.size() > 6) 
+    {
+      return token_type::IDENTIFIER;
+    }
+    switch (txt[0])
+    {
+      case 'a': return rest(1, "nd", token_type::AND);
+      case 'c': return rest(1, "lass", token_type::CLASS);
+      case 'e': return rest(1, "lse", token_type::ELSE);
+      case 'f': 
+        switch (txt[1]) 
+        {
+          case 'a': return rest(2, "lse", token_type::FALSE);
+          case 'o': return rest(2, "r", token_type::FOR);
+          case 'u': return rest(2, "n", token_type::FUN);
+        }
+        break;
+      case 'i': return rest(1, "f", token_type::IF);
+      case 'n': return rest(1, "il", token_type::NIL);
+      case 'o': return rest(1, "r", token_type::OR);
+      case 'p': return rest(1, "rint", token_type::PRINT);
+      case 'r': return rest(1, "eturn", token_type::RETURN);
+      case 's': return rest(1, "uper", token_type::SUPER);
+      case 't': 
+        switch (txt[1]) 
+        {
+          case 'h': return rest(2, "is", token_type::THIS);
+          case 'r': return rest(2, "ue", token_type::TRUE);
+        }
+        break;
+      case 'v': return rest(1, "ar", token_type::VAR);
+      case 'w': return rest(1, "hile", token_type::WHILE);
+    }
+    return token_type::IDENTIFIER;
+  }
+
+  static_assert(keyword_or_identifier("and") == token_type::AND);
+  static_assert(keyword_or_identifier("class") == token_type::CLASS);
+  static_assert(keyword_or_identifier("else") == token_type::ELSE);
+  static_assert(keyword_or_identifier("false") == token_type::FALSE);
+  static_assert(keyword_or_identifier("for") == token_type::FOR);
+  static_assert(keyword_or_identifier("fun") == token_type::FUN);
+  static_assert(keyword_or_identifier("if") == token_type::IF);
+  static_assert(keyword_or_identifier("nil") == token_type::NIL);
+  static_assert(keyword_or_identifier("or") == token_type::OR);
+  static_assert(keyword_or_identifier("print") == token_type::PRINT);
+  static_assert(keyword_or_identifier("return") == token_type::RETURN);
+  static_assert(keyword_or_identifier("super") == token_type::SUPER);
+  static_assert(keyword_or_identifier("this") == token_type::THIS);
+  static_assert(keyword_or_identifier("true") == token_type::TRUE);
+  static_assert(keyword_or_identifier("var") == token_type::VAR);
+  static_assert(keyword_or_identifier("while") == token_type::WHILE);
+  static_assert(keyword_or_identifier("fo") == token_type::IDENTIFIER);
+  static_assert(keyword_or_identifier("fork") == token_type::IDENTIFIER);
+  static_assert(keyword_or_identifier("t") == token_type::IDENTIFIER);
+  static_assert(keyword_or_identifier("thisx") == token_type::IDENTIFIER);
+
+} // namespace cwt
@@ -0,0 +1,92 @@
+#include <algorithm>
+
+#include "lox_array.hpp"
+
+namespace cwt
+{
+  lox_array::lox_array(std::span<lox_obj> values)
+  {
+    if (std::all_of(values.begin(), values.end(), [](const lox_obj& v) { return v.is_number(); }))
+    {
+      m_numbers.reserve(values.size());
+      for (const lox_obj& v : values)
+      {
+        m_numbers.push_back(v.as_number());
+      }
+      return;
+    }
+    m_boxed = true;
+    m_values.reserve(values.size());
+    for (lox_obj& v : values)
+    {
+      m_values.push_back(std::move(v));
+    }
+  }
+
+  lox_obj lox_array::get(std::size_t i) const
+  {
+    if (!m_boxed)
+    {
+      return m_numbers[i];
+    }
+    return create_another(m_values[i]);
+  }
+
+  void lox_array::set(std::size_t i, const lox_obj& value)
+  {
+    if (!m_boxed)
+    {
+      if (value.is_number())
+      {
+        m_numbers[i] = value.as_number();
+        return;
+      }
+      box();
+    }
+    m_values[i] = create_another(value);
+  }
+
+  void lox_array::push(const lox_obj& value)
+  {
+    if (!m_boxed)
+    {
+      if (value.is_number())
+      {
+        m_numbers.push_back(value.as_number());
+        return;
+      }
+      box();
+    }
+    m_values.push_back(create_another(value));
+  }
+
+  std::string lox_array::to_string() const
+  {
+    if (m_printing)
+    {
+      return "[...]";
+    }
+    m_printing = true;
+    std::string s{"["};
+    for (std::size_t i = 0 ; i < size() ; ++i)
+    {
+      s.append(i ? ", " : "");
+      s.append(get(i).to_string());
+    }
+    s.push_back(']');
+    m_printing = false;
+    return s;
+  }
+
+  void lox_array::box()
+  {
+    m_values.reserve(std::max(m_numbers.capacity(), m_numbers.size() + 1));
+    for (const double d : m_numbers)
+    {
+      m_values.emplace_back(d);
+    }
+    m_numbers = std::vector<double>();
+    m_boxed = true;
+  }
+
+} // namespace cwt
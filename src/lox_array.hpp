@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lox_obj.hpp"
+
+namespace cwt
+{
+  // the elements of a lox array. as long as only numbers went in they are
+  // kept as plain doubles next to each other, the first value of another
+  // type boxes all of them for good. lox values share arrays, copying one
+  // copies the reference. an array that ends up holding itself is never
+  // freed.
+  class lox_array
+  {
+    public:
+      lox_array() = default;
+      // moves the values out of the span
+      explicit lox_array(std::span<lox_obj> values);
+      explicit lox_array(std::vector<double> numbers) : m_numbers(std::move(numbers)) {}
+
+      std::size_t size() const noexcept { return m_boxed ? m_values.size() : m_numbers.size(); }
+      bool numeric() const noexcept { return !m_boxed; }
+      // empty once the array is boxed
+      std::span<const double> numbers() const noexcept { return m_numbers; }
+      std::span<double> numbers() noexcept { return m_numbers; }
+
+      // i has to be less than size()
+      lox_obj get(std::size_t i) const;
+      void set(std::size_t i, const lox_obj& value);
+      void push(const lox_obj& value);
+
+      std::string to_string() const;
+
+    private:
+      void box();
+
+    private:
+      std::vector<double> m_numbers;
+      std::vector<lox_obj> m_values;
+      bool m_boxed = false;
+      // an array that holds itself prints as [...] the second time
+      mutable bool m_printing = false;
+  };
+
+} // namespace cwt
@@ -1,6 +1,6 @@
 #pragma once 
 
-#include <vector>
+#include <span>
 #include <string> 
 
 namespace cwt
@@ -13,7 +13,7 @@ namespace cwt
     virtual ~lox_callable() = default;
     virtual std::size_t arity() = 0;
     virtual std::string to_string() = 0;
-    virtual lox_obj call(interpreter& interpreter, const std::vector<lox_obj>& args) = 0;
+    virtual lox_obj call(interpreter& interpreter, std::span<const lox_obj> args) = 0;
   };
 
 } // namespace cwt
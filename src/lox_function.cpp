@@ -1,9 +1,12 @@
 #include <iostream> 
+#include <optional>
 
 #include "lox_function.hpp"
 #include "lox_obj.hpp"
 #include "environment.hpp"
 #include "interpreter.hpp"
+#include "jit.hpp"
+#include "metrics.hpp"
 #include "return.hpp"
 namespace cwt
 {
@@ -12,27 +15,82 @@ lox_function::lox_function(const stmt_function<lox_obj>* declaration) : m_declar
 {
 
 }
+lox_function::lox_function(const lox_function& other) : m_declaration(other.m_declaration)
+{
+
+}
+lox_function::~lox_function() = default;
 std::string lox_function::to_string()
 {
-  return "some function lol";
+  std::string s{"<fn "};
+  s.append(m_declaration->name);
+  s.append(">");
+  return s;
 }
 std::size_t lox_function::arity()
 {
   return m_declaration->parameters.size();
 }
 
-lox_obj lox_function::call(interpreter& interpreter, const std::vector<lox_obj>& args)
+const stmt_function<lox_obj>* lox_function::declaration() const noexcept
+{
+  return m_declaration;
+}
+
+lox_obj lox_function::call(interpreter& interpreter, std::span<const lox_obj> args)
+{
+  profile_scope scope(interpreter.get_profiler(), m_declaration->name);
+  LOX_COUNT(function_calls);
+  std::optional<lox_obj> native;
+  jit* j = interpreter.get_jit();
+  if (j && !interpreter.get_meter())
+  {
+    native = j->call(*m_declaration, *interpreter.get_env_ptr(), args);
+    if (native && !j->verifying())
+    {
+      return std::move(*native);
+    }
+  }
+
+  lox_obj result = run(interpreter, args);
+  if (native)
+  {
+    interpreter.get_jit()->verify(*m_declaration, *native, result);
+  }
+  return result;
+}
+
+lox_obj lox_function::run(interpreter& interpreter, std::span<const lox_obj> args)
 {
-  auto env = std::make_unique<environment>();
+  constexpr std::size_t max_frames = 16;
+  std::unique_ptr<environment> env;
+  if (m_frames.empty())
+  {
+    env = std::make_unique<environment>();
+  }
+  else 
+  {
+    env = std::move(m_frames.back());
+    m_frames.pop_back();
+  }
+  finally release([this, &env]()
+  {
+    if (env && m_frames.size() < max_frames)
+    {
+      env->recycle();
+      m_frames.push_back(std::move(env));
+    }
+  });
+
   env->set_enclosing(interpreter.get_env_ptr());
   for (std::size_t i = 0 ; i < m_declaration->parameters.size() ; ++i)
   {
-    env->define(m_declaration->parameters[i].lexeme, args.at(i));
+    env->define(m_declaration->parameters[i], args[i]);
   }
 
   try
   {
-    interpreter.execute_block(m_declaration->body, std::move(env));
+    interpreter.execute_frame(m_declaration->body, env);
   }
   catch(const lox_return& e)
   {
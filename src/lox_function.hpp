@@ -1,5 +1,8 @@
 #pragma once 
 
+#include <memory>
+#include <vector>
+
 #include "lox_callable.hpp"
 
 namespace cwt
@@ -7,6 +10,7 @@ namespace cwt
 
 template<typename T>
 struct stmt_function;
+class environment;
 
 class lox_function : public lox_callable
 {
@@ -14,10 +18,19 @@ class lox_function : public lox_callable
     lox_function(const stmt_function<lox_obj>* declaration);
     std::string to_string() override;
     std::size_t arity() override;
-    lox_obj call(interpreter& interpreter, const std::vector<lox_obj>& args) override;
+    // a copy starts without spare frames
+    lox_function(const lox_function& other);
+    ~lox_function();
+    lox_obj call(interpreter& interpreter, std::span<const lox_obj> args) override;
+    const stmt_function<lox_obj>* declaration() const noexcept;
 
   private: 
+    lox_obj run(interpreter& interpreter, std::span<const lox_obj> args);
+
     const stmt_function<lox_obj>* m_declaration;
+    // environments of finished calls, the next call reuses one with the
+    // storage of its variables. one per level of recursion, up to a limit
+    std::vector<std::unique_ptr<environment>> m_frames;
 };
 
 
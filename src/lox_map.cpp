@@ -0,0 +1,201 @@
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <utility>
+
+#include "lox_map.hpp"
+
+namespace cwt
+{
+  const lox_obj* lox_map::find(const lox_obj& key) const
+  {
+    const std::size_t s = find_slot(key, hash(key));
+    return s == npos ? nullptr : &m_entries[m_slots[s].entry].value;
+  }
+
+  void lox_map::set(const lox_obj& key, const lox_obj& value)
+  {
+    const std::uint32_t h = hash(key);
+    if (const std::size_t s = find_slot(key, h) ; s != npos)
+    {
+      m_entries[m_slots[s].entry].value = create_another(value);
+      return;
+    }
+    // erased entries count against the table until the next rebuild
+    if ((m_entries.size() + 1) * 8 > m_slots.size() * 7)
+    {
+      rebuild();
+    }
+    m_entries.push_back(entry{create_another(key), create_another(value), h, true});
+    place(slot{h, static_cast<std::uint32_t>(m_entries.size() - 1)});
+    ++m_size;
+  }
+
+  bool lox_map::erase(const lox_obj& key)
+  {
+    const std::size_t found = find_slot(key, hash(key));
+    if (found == npos)
+    {
+      return false;
+    }
+    entry& e = m_entries[m_slots[found].entry];
+    e.live = false;
+    e.key = lox_obj();
+    e.value = lox_obj();
+    --m_size;
+
+    // backward shift: the slots after it move one closer to their home
+    const std::size_t mask = m_slots.size() - 1;
+    std::size_t i = found;
+    for (std::size_t next = (i + 1) & mask ; m_slots[next].entry != empty && ((next - (m_slots[next].hash & mask)) & mask) != 0 ; next = (next + 1) & mask)
+    {
+      m_slots[i] = m_slots[next];
+      i = next;
+    }
+    m_slots[i].entry = empty;
+    return true;
+  }
+
+  bool lox_map::valid_key(const lox_obj& key) noexcept
+  {
+    switch (key.type())
+    {
+      case value_type::nil:
+      case value_type::boolean:
+      case value_type::string: return true;
+      break; case value_type::number: return !std::isnan(key.as_number());
+      break; default: return false;
+    }
+  }
+
+  std::string lox_map::to_string() const
+  {
+    if (m_printing)
+    {
+      return "{...}";
+    }
+    m_printing = true;
+    std::string s{"{"};
+    bool first = true;
+    for_each([&s, &first](const lox_obj& key, const lox_obj& value)
+    {
+      s.append(first ? "" : ", ");
+      s.append(key.to_string());
+      s.append(": ");
+      s.append(value.to_string());
+      first = false;
+    });
+    s.push_back('}');
+    m_printing = false;
+    return s;
+  }
+
+  std::uint32_t lox_map::hash(const lox_obj& key) noexcept
+  {
+    switch (key.type())
+    {
+      case value_type::number:
+      {
+        // 0 and -0 are the same key
+        const double d = key.as_number() == 0 ? 0.0 : key.as_number();
+        std::uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        // the low bits pick the slot, the finalizer of murmur3 spreads
+        // the exponent and high mantissa bits of small integers into them
+        bits ^= bits >> 33;
+        bits *= 0xff51afd7ed558ccdull;
+        bits ^= bits >> 33;
+        bits *= 0xc4ceb9fe1a85ec53ull;
+        bits ^= bits >> 33;
+        return static_cast<std::uint32_t>(bits);
+      }
+      break; case value_type::string: return static_cast<std::uint32_t>(std::hash<std::string_view>{}(key.as_string()));
+      break; case value_type::boolean: return key.boolean() ? 0x9e3779b9u : 0x7f4a7c15u;
+      break; default: return 0;
+    }
+  }
+
+  bool lox_map::same_key(const lox_obj& left, const lox_obj& right) noexcept
+  {
+    if (left.type() != right.type())
+    {
+      return false;
+    }
+    switch (left.type())
+    {
+      case value_type::nil: return true;
+      break; case value_type::number: return left.as_number() == right.as_number();
+      break; case value_type::string: return left.as_string() == right.as_string();
+      break; case value_type::boolean: return left.boolean() == right.boolean();
+      break; default: return false;
+    }
+  }
+
+  std::size_t lox_map::find_slot(const lox_obj& key, std::uint32_t h) const noexcept
+  {
+    if (m_slots.empty())
+    {
+      return npos;
+    }
+    // a key is never further from its home than the slot it would take
+    // from the entry there
+    const std::size_t mask = m_slots.size() - 1;
+    std::size_t i = h & mask;
+    for (std::size_t distance = 0 ; ; ++distance, i = (i + 1) & mask)
+    {
+      const slot& s = m_slots[i];
+      if (s.entry == empty || ((i - (s.hash & mask)) & mask) < distance)
+      {
+        return npos;
+      }
+      if (s.hash == h && same_key(m_entries[s.entry].key, key))
+      {
+        return i;
+      }
+    }
+  }
+
+  void lox_map::place(slot s) noexcept
+  {
+    const std::size_t mask = m_slots.size() - 1;
+    std::size_t i = s.hash & mask;
+    for (std::size_t distance = 0 ; ; ++distance, i = (i + 1) & mask)
+    {
+      slot& here = m_slots[i];
+      if (here.entry == empty)
+      {
+        here = s;
+        return;
+      }
+      // robin hood: the one further from home keeps the slot
+      const std::size_t theirs = (i - (here.hash & mask)) & mask;
+      if (theirs < distance)
+      {
+        std::swap(here, s);
+        distance = theirs;
+      }
+    }
+  }
+
+  void lox_map::rebuild()
+  {
+    if (m_size != m_entries.size())
+    {
+      std::erase_if(m_entries, [](const entry& e) { return !e.live; });
+    }
+    // less than half full afterwards, so erasing and adding keys in turn
+    // does not rebuild every time
+    std::size_t capacity = 8;
+    while ((m_size + 1) * 16 > capacity * 7)
+    {
+      capacity *= 2;
+    }
+    m_slots.assign(capacity, slot{0, empty});
+    for (std::size_t i = 0 ; i < m_entries.size() ; ++i)
+    {
+      place(slot{m_entries[i].hash, static_cast<std::uint32_t>(i)});
+    }
+  }
+
+} // namespace cwt
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "lox_obj.hpp"
+
+namespace cwt
+{
+  // the entries of a lox map in the order they were added. lookups go
+  // through a robin hood table of small slots, each the hash of a key and
+  // the index of its entry, so a probe stays within a cache line or two
+  // and only touches an entry once the hashes match. keys are nil,
+  // booleans, numbers and strings, other values are never found. lox
+  // values share maps like arrays.
+  class lox_map
+  {
+    public:
+      std::size_t size() const noexcept { return m_size; }
+
+      // null if key is not in the map
+      const lox_obj* find(const lox_obj& key) const;
+      void set(const lox_obj& key, const lox_obj& value);
+      bool erase(const lox_obj& key);
+
+      // what set accepts as a key
+      static bool valid_key(const lox_obj& key) noexcept;
+
+      // calls f(key, value) in insertion order
+      template<typename F>
+      void for_each(F&& f) const
+      {
+        for (const entry& e : m_entries)
+        {
+          if (e.live)
+          {
+            f(e.key, e.value);
+          }
+        }
+      }
+
+      std::string to_string() const;
+
+    private:
+      struct entry
+      {
+        lox_obj key;
+        lox_obj value;
+        std::uint32_t hash;
+        bool live;
+      };
+      struct slot
+      {
+        std::uint32_t hash;
+        std::uint32_t entry;
+      };
+      static constexpr std::uint32_t empty = UINT32_MAX;
+      static constexpr std::size_t npos = SIZE_MAX;
+
+      static std::uint32_t hash(const lox_obj& key) noexcept;
+      static bool same_key(const lox_obj& left, const lox_obj& right) noexcept;
+      // index into m_slots
+      std::size_t find_slot(const lox_obj& key, std::uint32_t h) const noexcept;
+      void place(slot s) noexcept;
+      // drops erased entries and sizes the table for one more
+      void rebuild();
+
+    private:
+      std::vector<entry> m_entries;
+      std::vector<slot> m_slots;
+      std::size_t m_size = 0;
+      mutable bool m_printing = false;
+  };
+
+} // namespace cwt
@@ -0,0 +1,36 @@
+#include "lox_native.hpp"
+#include "lox_obj.hpp"
+#include "interpreter.hpp"
+#include "metrics.hpp"
+
+namespace cwt
+{
+
+lox_native::lox_native(const std::string& name, std::size_t arity, function_t func) 
+: m_name(name), m_arity(arity), m_func(std::move(func))
+{
+
+}
+std::string lox_native::to_string()
+{
+  std::string s{"<native fn "};
+  s.append(m_name);
+  s.append(">");
+  return s;
+}
+std::size_t lox_native::arity()
+{
+  return m_arity;
+}
+const std::string& lox_native::name() const noexcept
+{
+  return m_name;
+}
+lox_obj lox_native::call(interpreter& interpreter, std::span<const lox_obj> args)
+{
+  profile_scope scope(interpreter.get_profiler(), m_name);
+  LOX_COUNT(native_calls);
+  return m_func(interpreter, args);
+}
+
+} // namespace cwt
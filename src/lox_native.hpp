@@ -0,0 +1,29 @@
+#pragma once 
+
+#include <functional>
+
+#include "lox_callable.hpp"
+
+namespace cwt
+{
+
+// host function callable from lox, arguments are passed as a view 
+// into the callers argument buffer, nothing gets copied 
+class lox_native : public lox_callable
+{
+  public:
+    using function_t = std::function<lox_obj(interpreter&, std::span<const lox_obj>)>;
+
+    lox_native(const std::string& name, std::size_t arity, function_t func);
+    std::string to_string() override;
+    std::size_t arity() override;
+    lox_obj call(interpreter& interpreter, std::span<const lox_obj> args) override;
+    const std::string& name() const noexcept;
+
+  private: 
+    std::string m_name;
+    std::size_t m_arity;
+    function_t m_func;
+};
+
+} // namespace cwt
@@ -1,134 +1,187 @@
 #include <stdexcept>
 
 #include "lox_obj.hpp"
+#include "lox_array.hpp"
+#include "lox_map.hpp"
+#include "metrics.hpp"
 
 namespace cwt
 {
 
   template<>
-  struct _model_helper<bool> 
+  struct _model_helper<std::string> 
   {
-    bool m_value;
+    std::string m_value;
 
-    _model_helper(const bool& value) : m_value(value) {}
-    value_type type() const noexcept { return value_type::boolean; }
-    std::string to_string() const noexcept { return std::to_string(m_value); }
+    _model_helper(const std::string& value) : m_value(value) {}
+    value_type type() const noexcept { return value_type::string; }
+    std::string to_string() const noexcept { return m_value; }
     double number() const { throw std::runtime_error("lox object does not hold a number"); }
-    bool boolean() const { return m_value; }
-    std::string string() const { throw std::runtime_error("lox object does not hold a string"); }
-    lox_function callable() const { throw std::runtime_error("lox object does not hold a function"); }
+    bool boolean() const { throw std::runtime_error("lox object does not hold a bool"); }
+    std::string string() const { return m_value; }
+    std::shared_ptr<lox_callable> callable() const { throw std::runtime_error("lox object does not hold a function"); }
+    std::shared_ptr<lox_array> array() const { throw std::runtime_error("lox object does not hold an array"); }
+    std::shared_ptr<lox_map> map() const { throw std::runtime_error("lox object does not hold a map"); }
   };
 
+  
   template<>
-  struct _model_helper<double> 
+  struct _model_helper<std::shared_ptr<lox_callable>> 
   {
-    double m_value;
+    std::shared_ptr<lox_callable> m_value;
 
-    _model_helper(const double& value) : m_value(value) {}
-    value_type type() const noexcept { return value_type::number; }
-    std::string to_string() const noexcept { return std::to_string(m_value); }
-    double number() const { return m_value; }
+    _model_helper(std::shared_ptr<lox_callable> value) : m_value(std::move(value)) {}
+    value_type type() const noexcept { return value_type::callable; }
+    std::string to_string() const noexcept { return m_value->to_string(); }
+    double number() const { throw std::runtime_error("lox object does not hold a number"); }
     bool boolean() const { throw std::runtime_error("lox object does not hold a bool"); }
     std::string string() const { throw std::runtime_error("lox object does not hold a string"); }
-    lox_function callable() const { throw std::runtime_error("lox object does not hold a function"); }
+    std::shared_ptr<lox_callable> callable() const { return m_value; }
+    std::shared_ptr<lox_array> array() const { throw std::runtime_error("lox object does not hold an array"); }
+    std::shared_ptr<lox_map> map() const { throw std::runtime_error("lox object does not hold a map"); }
   };
 
   template<>
-  struct _model_helper<std::string> 
+  struct _model_helper<std::shared_ptr<lox_array>> 
   {
-    std::string m_value;
+    std::shared_ptr<lox_array> m_value;
 
-    _model_helper(const std::string& value) : m_value(value) {}
-    value_type type() const noexcept { return value_type::string; }
-    std::string to_string() const noexcept { return m_value; }
+    _model_helper(std::shared_ptr<lox_array> value) : m_value(std::move(value)) {}
+    value_type type() const noexcept { return value_type::array; }
+    std::string to_string() const noexcept { return m_value->to_string(); }
     double number() const { throw std::runtime_error("lox object does not hold a number"); }
     bool boolean() const { throw std::runtime_error("lox object does not hold a bool"); }
-    std::string string() const { return m_value; }
-    lox_function callable() const { throw std::runtime_error("lox object does not hold a function"); }
+    std::string string() const { throw std::runtime_error("lox object does not hold a string"); }
+    std::shared_ptr<lox_callable> callable() const { throw std::runtime_error("lox object does not hold a function"); }
+    std::shared_ptr<lox_array> array() const { return m_value; }
+    std::shared_ptr<lox_map> map() const { throw std::runtime_error("lox object does not hold a map"); }
   };
 
-  
   template<>
-  struct _model_helper<lox_function> 
+  struct _model_helper<std::shared_ptr<lox_map>> 
   {
-    lox_function m_value;
+    std::shared_ptr<lox_map> m_value;
 
-    _model_helper(lox_function value) : m_value(value) {}
-    value_type type() const noexcept { return value_type::callable; }
-    std::string to_string() const noexcept { return "lox_function ..."; }
+    _model_helper(std::shared_ptr<lox_map> value) : m_value(std::move(value)) {}
+    value_type type() const noexcept { return value_type::map; }
+    std::string to_string() const noexcept { return m_value->to_string(); }
     double number() const { throw std::runtime_error("lox object does not hold a number"); }
     bool boolean() const { throw std::runtime_error("lox object does not hold a bool"); }
     std::string string() const { throw std::runtime_error("lox object does not hold a string"); }
-    lox_function callable() const { return m_value; }
+    std::shared_ptr<lox_callable> callable() const { throw std::runtime_error("lox object does not hold a function"); }
+    std::shared_ptr<lox_array> array() const { throw std::runtime_error("lox object does not hold an array"); }
+    std::shared_ptr<lox_map> map() const { return m_value; }
   };
 
 
-  lox_obj::lox_obj() : m_nil(true) {}
+  lox_obj::lox_obj() {}
 
-  template <typename T, typename std::enable_if_t<std::is_same_v<T, lox_function>>* = nullptr>
-  lox_obj::lox_obj(T value) : m_nil(false)
+  template <typename T, typename std::enable_if_t<std::is_same_v<T, lox_function> || std::is_same_v<T, lox_native>>*>
+  lox_obj::lox_obj(T value) : m_type(value_type::callable)
   {
-    m_value = std::make_unique<_model<T>>(std::move(value));
+    std::shared_ptr<lox_callable> callable = std::make_shared<T>(std::move(value));
+    LOX_COUNT(allocations);
+    m_value = std::make_unique<_model<std::shared_ptr<lox_callable>>>(std::move(callable));
   }
 
-  template <typename T, typename std::enable_if_t<std::is_same_v<T, bool>>* = nullptr>
-  lox_obj::lox_obj(T value) : m_nil(false)
+  template <typename T, typename std::enable_if_t<std::is_same_v<T, std::shared_ptr<lox_callable>>>*>
+  lox_obj::lox_obj(T value) : m_type(value_type::callable)
   {
-    m_value = std::make_unique<_model<bool>>(std::move(value));
+    LOX_COUNT(allocations);
+    m_value = std::make_unique<_model<std::shared_ptr<lox_callable>>>(std::move(value));
   }
 
-  template <typename T, typename std::enable_if_t<std::is_same_v<typename std::decay<T>::type, std::string>>* = nullptr>
-  lox_obj::lox_obj(T value) : m_nil(false)
+  template <typename T, typename std::enable_if_t<std::is_same_v<T, std::shared_ptr<lox_array>>>*>
+  lox_obj::lox_obj(T value) : m_type(value_type::array)
   {
-    m_value = std::make_unique<_model<std::string>>(std::move(std::string{value}));
+    LOX_COUNT(allocations);
+    m_array = value.get();
+    m_value = std::make_unique<_model<std::shared_ptr<lox_array>>>(std::move(value));
+  }
+
+  template <typename T, typename std::enable_if_t<std::is_same_v<T, std::shared_ptr<lox_map>>>*>
+  lox_obj::lox_obj(T value) : m_type(value_type::map)
+  {
+    LOX_COUNT(allocations);
+    m_map = value.get();
+    m_value = std::make_unique<_model<std::shared_ptr<lox_map>>>(std::move(value));
   }
 
-  template <typename T, typename std::enable_if_t<std::is_same_v<T, const char*>>* = nullptr>
-  lox_obj::lox_obj(T value) : m_nil(false)
+  template <typename T, typename std::enable_if_t<std::is_same_v<typename std::decay<T>::type, std::string>>*>
+  lox_obj::lox_obj(T value) : m_type(value_type::string)
   {
+    LOX_COUNT(allocations);
     m_value = std::make_unique<_model<std::string>>(std::move(std::string{value}));
   }
 
-  template <typename T, typename std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>>* = nullptr>
-  lox_obj::lox_obj(T value) : m_nil(false)
+  template <typename T, typename std::enable_if_t<std::is_same_v<T, const char*>>*>
+  lox_obj::lox_obj(T value) : m_type(value_type::string)
   {
-    m_value = std::make_unique<_model<double>>(std::move(value));
+    LOX_COUNT(allocations);
+    m_value = std::make_unique<_model<std::string>>(std::move(std::string{value}));
   }
 
-  value_type lox_obj::type() const noexcept 
-  { 
-    if (m_value) 
-    {
-      return m_value->type(); 
-    }
-    else 
-    {
-      return value_type::nil;
-    }
-  };
   double lox_obj::number() const
   {
-    return m_value->number();
+    if (m_type == value_type::number)
+    {
+      return m_number;
+    }
+    throw std::runtime_error("lox object does not hold a number");
   }
   std::string lox_obj::string() const
   {
-    return m_value->string();
+    if (m_type == value_type::string)
+    {
+      return m_value->string();
+    }
+    throw std::runtime_error("lox object does not hold a string");
   }
   bool lox_obj::boolean() const 
   {
-    return m_value->boolean();
+    if (m_type == value_type::boolean)
+    {
+      return m_boolean;
+    }
+    throw std::runtime_error("lox object does not hold a bool");
   }   
-  bool lox_obj::nil() const
+  std::shared_ptr<lox_callable> lox_obj::callable() const
+  {
+    if (m_type == value_type::callable)
+    {
+      return m_value->callable();
+    }
+    throw std::runtime_error("lox object does not hold a function");
+  }
+  std::shared_ptr<lox_array> lox_obj::array() const
+  {
+    if (m_type == value_type::array)
+    {
+      return m_value->array();
+    }
+    throw std::runtime_error("lox object does not hold an array");
+  }
+  std::shared_ptr<lox_map> lox_obj::map() const
   {
-    return m_nil;
+    if (m_type == value_type::map)
+    {
+      return m_value->map();
+    }
+    throw std::runtime_error("lox object does not hold a map");
   }
-  lox_function lox_obj::callable() const
+  const std::string& lox_obj::as_string() const noexcept
   {
-    return m_value->callable();
+    return static_cast<const _model<std::string>&>(*m_value).helper.m_value;
   }
   std::string lox_obj::to_string() const
   {
-    return m_value->to_string();
+    switch (m_type)
+    {
+      case value_type::number: return std::to_string(m_number);
+      break; case value_type::boolean: return std::to_string(m_boolean);
+      break; case value_type::nil: return "nil";
+      break; default: return m_value->to_string();
+    }
   }
 
 
@@ -136,14 +189,26 @@ namespace cwt
 
 lox_obj create_another(const lox_obj& old) 
 {
+  LOX_COUNT(copies);
   switch (old.type())
   {
   case value_type::boolean: return old.boolean();
-  break; case value_type::number: return old.number();
+  break; case value_type::number: return old.as_number();
   break; case value_type::string: return old.string();
   break; case value_type::callable: return old.callable();
+  break; case value_type::array: return old.array();
+  break; case value_type::map: return old.map();
   default: return lox_obj(); // creates nil 
   }
 }
 
+// the heap payload constructors are defined in here, so each of them needs to be instantiated
+template lox_obj::lox_obj(lox_function);
+template lox_obj::lox_obj(lox_native);
+template lox_obj::lox_obj(std::shared_ptr<lox_callable>);
+template lox_obj::lox_obj(std::shared_ptr<lox_array>);
+template lox_obj::lox_obj(std::shared_ptr<lox_map>);
+template lox_obj::lox_obj(std::string);
+template lox_obj::lox_obj(const char*);
+
 } // namespace cwt
@@ -6,12 +6,16 @@
 #include <stdexcept>
 
 #include "lox_function.hpp"
+#include "lox_native.hpp"
 
 namespace cwt
 {
+  class lox_array;
+  class lox_map;
+
   enum class value_type
   {
-    nil = 0, number, string, boolean, callable
+    nil = 0, number, string, boolean, callable, array, map
   };
 
   
@@ -25,8 +29,10 @@ namespace cwt
     std::string to_string() const noexcept { return "nil"; }
     double number() const { throw std::runtime_error("lox object does not hold a number"); }
     bool boolean() const { throw std::runtime_error("lox object does not hold a bool"); }
-    lox_function callable() const { throw std::runtime_error("lox object does not hold a function"); }
+    std::shared_ptr<lox_callable> callable() const { throw std::runtime_error("lox object does not hold a function"); }
     std::string string() const { throw std::runtime_error("lox object does not hold a string"); }
+    std::shared_ptr<lox_array> array() const { throw std::runtime_error("lox object does not hold an array"); }
+    std::shared_ptr<lox_map> map() const { throw std::runtime_error("lox object does not hold a map"); }
   };
   
   class lox_obj 
@@ -34,12 +40,21 @@ namespace cwt
     public:
       lox_obj();
 
-      template <typename T, typename std::enable_if_t<std::is_same_v<T, lox_function>>* = nullptr>
+      template <typename T, typename std::enable_if_t<std::is_same_v<T, lox_function> || std::is_same_v<T, lox_native>>* = nullptr>
       lox_obj(T value);
 
-      template <typename T, typename std::enable_if_t<std::is_same_v<T, bool>>* = nullptr>
+      template <typename T, typename std::enable_if_t<std::is_same_v<T, std::shared_ptr<lox_callable>>>* = nullptr>
+      lox_obj(T value);
+
+      template <typename T, typename std::enable_if_t<std::is_same_v<T, std::shared_ptr<lox_array>>>* = nullptr>
+      lox_obj(T value);
+
+      template <typename T, typename std::enable_if_t<std::is_same_v<T, std::shared_ptr<lox_map>>>* = nullptr>
       lox_obj(T value);
 
+      template <typename T, typename std::enable_if_t<std::is_same_v<T, bool>>* = nullptr>
+      lox_obj(T value) : m_type(value_type::boolean), m_boolean(value) {}
+
       template <typename T, typename std::enable_if_t<std::is_same_v<typename std::decay<T>::type, std::string>>* = nullptr>
       lox_obj(T value);
 
@@ -47,16 +62,28 @@ namespace cwt
       lox_obj(T value);
 
       template <typename T, typename std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>>* = nullptr>
-      lox_obj(T value);
+      lox_obj(T value) : m_type(value_type::number), m_number(static_cast<double>(value)) {}
 
-      value_type type() const noexcept;
+      value_type type() const noexcept { return m_type; }
       double number() const;
       std::string string() const;
       bool boolean() const;
-      lox_function callable() const;
-      bool nil() const;
+      std::shared_ptr<lox_callable> callable() const;
+      std::shared_ptr<lox_array> array() const;
+      std::shared_ptr<lox_map> map() const;
+      bool nil() const noexcept { return m_type == value_type::nil; }
       std::string to_string() const;
 
+      // numbers and booleans are stored unboxed, the fast paths read them 
+      // without a type check of their own
+      bool is_number() const noexcept { return m_type == value_type::number; }
+      double as_number() const noexcept { return m_number; }
+      // the array or map of such a value, without touching its reference count
+      lox_array& as_array() const noexcept { return *m_array; }
+      lox_map& as_map() const noexcept { return *m_map; }
+      // the text of a string value, without a copy
+      const std::string& as_string() const noexcept;
+
   private:   
       struct _concept {
           virtual ~_concept() {}
@@ -64,8 +91,10 @@ namespace cwt
           virtual std::string to_string() const noexcept { return "nil"; };
           virtual double number() const { throw std::runtime_error("lox object does not hold a number"); };
           virtual bool boolean() const { throw std::runtime_error("lox object does not hold a bool"); };
-          virtual lox_function callable() const { throw std::runtime_error("lox object does not hold a function"); };
+          virtual std::shared_ptr<lox_callable> callable() const { throw std::runtime_error("lox object does not hold a function"); };
           virtual std::string string() const { throw std::runtime_error("lox object does not hold a string"); };
+          virtual std::shared_ptr<lox_array> array() const { throw std::runtime_error("lox object does not hold an array"); };
+          virtual std::shared_ptr<lox_map> map() const { throw std::runtime_error("lox object does not hold a map"); };
       };
 
       template<typename T>
@@ -78,12 +107,23 @@ namespace cwt
         std::string to_string() const noexcept override { return helper.to_string(); }
         double number() const override { return helper.number(); }
         bool boolean() const override { return helper.boolean(); }
-        lox_function callable() const { return helper.callable(); }
+        std::shared_ptr<lox_callable> callable() const override { return helper.callable(); }
         std::string string() const override { return helper.string(); }
+        std::shared_ptr<lox_array> array() const override { return helper.array(); }
+        std::shared_ptr<lox_map> map() const override { return helper.map(); }
       };
 
     private:
-      bool m_nil;
+      value_type m_type = value_type::nil;
+      union 
+      {
+        double m_number = 0;
+        bool m_boolean;
+        // point into m_value
+        lox_array* m_array;
+        lox_map* m_map;
+      };
+      // strings, callables, arrays and maps
       std::unique_ptr<_concept> m_value;
   };
 
@@ -1,64 +1,217 @@
-#include <iostream>
+#include <algorithm>
+#include <filesystem>
 #include <fstream>
-#include <string>
+#include <iostream>
+#include <optional>
 #include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <vector>
 #include <memory>
-#include <type_traits>
-#include <unordered_map>
-#include <optional>
-
 
+#include "interpreter.hpp"
+#include "meter.hpp"
+#include "metrics.hpp"
+#include "optimizer.hpp"
+#include "program.hpp"
+#include "snapshot.hpp"
+#include "thread_pool.hpp"
+#include "transpiler.hpp"
 
-std::string readFile(const std::string& filename) 
+struct options
 {
-  std::ifstream file(filename, std::ios::in | std::ios::binary);
-  std::stringstream buffer;
-  buffer << file.rdbuf(); 
-  return buffer.str();
-}
+  std::vector<std::string> paths;
+  bool fast_scan = false;
+  std::optional<std::string> profile;
+  bool metrics = false;
+  cwt::dispatch dispatch = cwt::dispatch::threaded;
+  bool flat = false;
+  bool vm = false;
+  bool jit = true;
+  bool jit_verify = false;
+  std::optional<std::string> emit_cpp;
+  bool optimize = false;
+  cwt::budget limits;
+  // runs the tree walker in slices of that many steps, pausing in between
+  std::uint64_t slice = 0;
+  // globals restored before the scripts run, saved after they ran
+  std::optional<std::string> load_snapshot;
+  std::optional<std::string> save_snapshot;
+};
 
-
-#include "scanner.hpp"
-#include "token.hpp"
-#include "lox_obj.hpp"
-#include "stmt.hpp"
-#include "interpreter.hpp"
-#include "parser.hpp"
-
-void run(const std::string& src) 
+void run(const options& opts) 
 {
   using namespace cwt; 
-  scanner scanner(src);
-  std::vector<token> tokens = scanner.scan_tokens();
-  
+  const std::size_t threads = std::clamp<std::size_t>(std::thread::hardware_concurrency(), 1, std::max<std::size_t>(opts.paths.size(), 1));
+  thread_pool pool(threads);
+  program linked = load_program(pool, opts.paths, opts.fast_scan);
+
+  if (opts.emit_cpp)
+  {
+    std::ofstream out(*opts.emit_cpp);
+    transpile(linked.statements, linked.sources, out);
+  }
+  else if (linked.statements.empty() == false || opts.load_snapshot)
   {
-    parser<lox_obj> parser(tokens);
-    std::vector<std::unique_ptr<lox_statement<lox_obj>>> statements = parser.parse(); 
+    // outlives the interpreter, its functions point into it
+    snapshot image;
+    interpreter interpreter;
+    interpreter.set_source_map(&linked.sources);
+    if (opts.load_snapshot)
+    {
+      std::ifstream in(*opts.load_snapshot, std::ios::binary);
+      try
+      {
+        image = load_snapshot(interpreter, linked.sources, in);
+      }
+      catch(const std::exception& e)
+      {
+        std::cerr << e.what() << '\n';
+        return;
+      }
+    }
+    interpreter.set_dispatch(opts.dispatch);
+
+    std::optional<jit> compiler;
+    if (opts.jit && jit::supported())
+    {
+      interpreter.set_jit(&compiler.emplace(opts.jit_verify ? jit::mode::verify : jit::mode::on));
+    }
+
+    std::optional<meter> metered;
+    if (!opts.limits.unlimited() && !opts.slice)
+    {
+      interpreter.set_meter(&metered.emplace(opts.limits));
+    }
 
-    if (statements.empty() == false)
+    std::optional<profiler> prof;
+    if (opts.profile)
     {
-      interpreter().interpret(std::move(statements));
+      interpreter.set_profiler(&prof.emplace());
+    }
+
+    if (opts.optimize)
+    {
+      const optimizer_stats stats = optimize(linked.statements);
+      std::cerr << "optimizer: " << stats.hoisted << " hoisted, " << stats.shared << " shared\n";
+    }
+
+    flat_program flat;
+    vm_program vm;
+    if (opts.vm)
+    {
+      vm = compile(linked.statements);
+      interpreter.interpret(vm);
+    }
+    else if (opts.flat)
+    {
+      flat = flatten(linked.statements);
+      interpreter.interpret(flat);
+    }
+    else if (opts.slice)
+    {
+      metered_run run(interpreter, linked.statements, opts.limits);
+      std::uint64_t slices = 1;
+      for ( ; run.resume(opts.slice) == metered_run::status::paused ; ++slices) {}
+      std::cerr << "metered: " << run.usage().steps() << " steps in " << slices << " slices\n";
+    }
+    else 
+    {
+      interpreter.interpret(linked.statements);
+    }
+
+    if (opts.save_snapshot)
+    {
+      // a failed save must not cost the image already there: the snapshot
+      // is built in memory and moved over the old one once it is written
+      try
+      {
+        std::ostringstream image;
+        save_snapshot(interpreter, linked.sources, image);
+        const std::string temp = *opts.save_snapshot + ".tmp";
+        {
+          std::ofstream out(temp, std::ios::binary);
+          out << image.str();
+          if (!out.flush())
+          {
+            throw std::runtime_error("could not write snapshot " + temp);
+          }
+        }
+        std::filesystem::rename(temp, *opts.save_snapshot);
+      }
+      catch(const std::exception& e)
+      {
+        std::cerr << e.what() << '\n';
+      }
+    }
+
+    if (prof)
+    {
+      prof->finish();
+      prof->report(std::cerr, &linked.sources);
+      std::ofstream folded(*opts.profile);
+      prof->write_collapsed(folded);
+      std::cerr << "collapsed stacks written to " << *opts.profile << '\n';
     }
   }
 
+  if (opts.metrics)
+  {
+    if constexpr (metrics_enabled())
+    {
+      report_metrics(std::cerr, current_metrics());
+    }
+    else
+    {
+      std::cerr << "metrics are not compiled in, configure with -DLOX_METRICS=ON\n";
+    }
+  }
 }
 
 
 int main(int argc, char** argv)
 {
-  if (argc == 1) {
-
-  } else if (argc == 2) {
-    const std::string path{argv[1]};
-    std::cout << "reading: " << path << "\n\n";
-    run(readFile(path));
-  } else {
-    std::cerr << "invalid argc given\n";
-    return -1;  
+  options opts;
+  for (int i = 1 ; i < argc ; ++i)
+  {
+    const std::string arg{argv[i]};
+    if (arg == "--fast-scan") { opts.fast_scan = true; }
+    else if (arg == "--dispatch=visitor") { opts.dispatch = cwt::dispatch::visitor; }
+    else if (arg == "--dispatch=threaded") { opts.dispatch = cwt::dispatch::threaded; }
+    else if (arg == "--flat") { opts.flat = true; }
+    else if (arg == "--vm") { opts.vm = true; }
+    else if (arg.starts_with("--emit-cpp=")) { opts.emit_cpp = arg.substr(11); }
+    else if (arg == "--no-jit") { opts.jit = false; }
+    else if (arg == "--jit-verify") { opts.jit_verify = true; }
+    else if (arg == "--optimize") { opts.optimize = true; }
+    else if (arg == "--metrics") { opts.metrics = true; }
+    else if (arg.starts_with("--max-steps=")) { opts.limits.steps = std::stoull(arg.substr(12)); }
+    else if (arg.starts_with("--max-time=")) { opts.limits.time = std::chrono::milliseconds(std::stoull(arg.substr(11))); }
+    else if (arg.starts_with("--max-depth=")) { opts.limits.call_depth = std::stoull(arg.substr(12)); }
+    else if (arg.starts_with("--slice=")) { opts.slice = std::stoull(arg.substr(8)); }
+    else if (arg.starts_with("--load-snapshot=")) { opts.load_snapshot = arg.substr(16); }
+    else if (arg.starts_with("--save-snapshot=")) { opts.save_snapshot = arg.substr(16); }
+    else if (arg == "--profile") { opts.profile = "profile.folded"; }
+    else if (arg.starts_with("--profile=")) { opts.profile = arg.substr(10); }
+    else if (arg.starts_with("--")) 
+    {
+      std::cerr << "unknown option: " << arg << '\n';
+      return -1;
+    }
+    else { opts.paths.push_back(arg); }
+  }
+
+  if (!opts.paths.empty() || opts.load_snapshot) {
+    for (const auto& path : opts.paths)
+    {
+      std::cout << "reading: " << path << '\n';
+    }
+    std::cout << '\n';
+    run(opts);
   }
 
   std::cout << "\n=====================\n";
   std::cout << "program done!\n";
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <string>
+
+#include "meter.hpp"
+#include "error.hpp"
+#include "interpreter.hpp"
+
+namespace cwt
+{
+  namespace
+  {
+    // steps between two looks at the clock
+    constexpr std::uint64_t time_check_interval = 4096;
+  }
+
+  meter::meter(const budget& limits) : m_limits(limits), m_started(clock::now())
+  {
+    if (m_limits.call_depth)
+    {
+      m_max_depth = m_limits.call_depth;
+    }
+    next_batch();
+  }
+
+  meter::clock::duration meter::elapsed() const
+  {
+    return m_paused_at ? m_spent : m_spent + (clock::now() - m_started);
+  }
+
+  void meter::start_slice(std::uint64_t slice, stack_context* host)
+  {
+    m_steps = steps();
+    m_host = host;
+    m_slice_end = slice ? m_steps + slice : 0;
+    m_started = clock::now();
+    next_batch();
+  }
+
+  // the countdown runs to the nearest point something has to be checked.
+  // the step that goes past the step limit is the one that throws.
+  void meter::next_batch()
+  {
+    std::uint64_t batch = std::numeric_limits<std::uint64_t>::max();
+    if (m_limits.steps)
+    {
+      batch = std::min(batch, m_limits.steps - m_steps + 1);
+    }
+    if (m_limits.time.count())
+    {
+      batch = std::min(batch, time_check_interval);
+    }
+    if (m_slice_end)
+    {
+      batch = std::min(batch, m_slice_end - m_steps);
+    }
+    m_batch = batch;
+    m_countdown = batch;
+  }
+
+  void meter::checkpoint(source_loc loc)
+  {
+    m_steps += m_batch;
+    m_batch = 0;
+    if (m_limits.steps && m_steps > m_limits.steps)
+    {
+      m_steps = m_limits.steps;
+      exhaust(loc, "Step budget of " + std::to_string(m_limits.steps) + " exhausted.");
+    }
+    if (m_limits.time.count() && elapsed() > m_limits.time)
+    {
+      const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(m_limits.time).count();
+      exhaust(loc, "Time budget of " + std::to_string(ms) + " ms exhausted.");
+    }
+    if (m_slice_end && m_steps >= m_slice_end)
+    {
+      m_spent += clock::now() - m_started;
+      m_slice_end = 0;
+      m_paused_at = stack_context::current();
+      m_paused_at->switch_to(*m_host);
+      // start_slice has set up the next batch by now
+      m_paused_at = nullptr;
+      if (m_cancelled)
+      {
+        exhaust(loc, "Run cancelled.");
+      }
+      return;
+    }
+    next_batch();
+  }
+
+  void meter::exhaust(source_loc loc, const std::string& msg)
+  {
+    m_exhausted = true;
+    throw budget_exhausted(loc, msg);
+  }
+
+  void meter::too_deep(source_loc loc)
+  {
+    exhaust(loc, "Call depth budget of " + std::to_string(m_limits.call_depth) + " exceeded.");
+  }
+
+  metered_run::metered_run(interpreter& i, const std::vector<stmt_t>& program, const budget& limits)
+  : m_interpreter(i), m_program(program), m_meter(limits), m_run(&metered_run::entry, this)
+  {
+  }
+
+  metered_run::~metered_run()
+  {
+    if (m_meter.paused_at())
+    {
+      m_meter.cancel();
+      resume();
+    }
+  }
+
+  metered_run::status metered_run::resume(std::uint64_t slice)
+  {
+    if (m_status != status::paused)
+    {
+      return m_status;
+    }
+    meter* outer = m_interpreter.get_meter();
+    m_interpreter.set_meter(&m_meter);
+    m_meter.start_slice(slice, &m_host);
+    m_host.switch_to(m_meter.paused_at() ? *m_meter.paused_at() : m_run);
+    m_interpreter.set_meter(outer);
+    return m_status;
+  }
+
+  metered_run::status metered_run::state() const noexcept
+  {
+    return m_status;
+  }
+
+  const meter& metered_run::usage() const noexcept
+  {
+    return m_meter;
+  }
+
+  void metered_run::entry(void* self)
+  {
+    auto* run = static_cast<metered_run*>(self);
+    run->m_interpreter.interpret(run->m_program);
+    run->m_status = run->m_meter.exhausted() ? status::exhausted : status::finished;
+    run->m_run.exit_to(run->m_host);
+  }
+
+} // namespace cwt
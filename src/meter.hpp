@@ -0,0 +1,149 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "source_map.hpp"
+#include "stack_context.hpp"
+#include "stmt.hpp"
+
+namespace cwt
+{
+  class interpreter;
+
+  // limits of one run, zero means no limit. a step is a loop iteration
+  // or a call.
+  struct budget
+  {
+    std::uint64_t steps = 0;
+    std::chrono::nanoseconds time{0};
+    std::size_t call_depth = 0;
+
+    bool unlimited() const noexcept { return steps == 0 && time.count() == 0 && call_depth == 0; }
+  };
+
+  // counts the steps of a run against its budget and throws
+  // budget_exhausted when one runs out. the interpreter holds a pointer to
+  // it, unmetered runs pay a null check per back edge and call. a step is
+  // a decrement, limits and the clock are only looked at every few
+  // thousand steps.
+  class meter
+  {
+    using clock = std::chrono::steady_clock;
+
+    public:
+      explicit meter(const budget& limits);
+
+      // a loop back edge
+      void step(source_loc loc)
+      {
+        if (--m_countdown == 0)
+        {
+          checkpoint(loc);
+        }
+      }
+      void enter(source_loc loc)
+      {
+        step(loc);
+        if (m_depth == m_max_depth)
+        {
+          too_deep(loc);
+        }
+        ++m_depth;
+      }
+      void leave() noexcept { --m_depth; }
+
+      std::uint64_t steps() const noexcept { return m_steps + (m_batch - m_countdown); }
+      clock::duration elapsed() const;
+      bool exhausted() const noexcept { return m_exhausted; }
+
+      // the run goes back to host once slice more steps are taken, 0 never
+      // pauses. between slices the clock does not count.
+      void start_slice(std::uint64_t slice, stack_context* host);
+      // where a paused run continues, null if it is not paused
+      stack_context* paused_at() const noexcept { return m_paused_at; }
+      // a paused run throws budget_exhausted once it is resumed
+      void cancel() noexcept { m_cancelled = true; }
+
+    private:
+      void checkpoint(source_loc loc);
+      void next_batch();
+      [[noreturn]] void exhaust(source_loc loc, const std::string& msg);
+      [[noreturn]] void too_deep(source_loc loc);
+
+    private:
+      budget m_limits;
+      std::uint64_t m_countdown = 0;
+      std::uint64_t m_batch = 0;
+      std::uint64_t m_steps = 0;
+      std::size_t m_depth = 0;
+      std::size_t m_max_depth = std::numeric_limits<std::size_t>::max();
+      clock::time_point m_started;
+      clock::duration m_spent{0};
+      std::uint64_t m_slice_end = 0;
+      stack_context* m_host = nullptr;
+      stack_context* m_paused_at = nullptr;
+      bool m_exhausted = false;
+      bool m_cancelled = false;
+  };
+
+  // a call in progress, it counts against the depth limit while it runs
+  class meter_scope
+  {
+    public:
+      meter_scope(meter* m, source_loc loc) : m_meter(m)
+      {
+        if (m_meter) { m_meter->enter(loc); }
+      }
+      ~meter_scope()
+      {
+        if (m_meter) { m_meter->leave(); }
+      }
+      meter_scope(const meter_scope&) = delete;
+      meter_scope& operator=(const meter_scope&) = delete;
+    private:
+      meter* m_meter;
+  };
+
+  // a program run under a budget on a stack of its own, so it can stop
+  // halfway: resume(slice) returns paused once slice more steps were
+  // taken and the next call picks up there. one thread can take turns
+  // between many runs this way. interpreter and program have to outlive
+  // the run, the interpreter is only metered while the run is resumed.
+  class metered_run
+  {
+    using stmt_t = std::unique_ptr<lox_statement<lox_obj>>;
+
+    public:
+      enum class status
+      {
+        paused = 0, finished, exhausted
+      };
+
+      metered_run(interpreter& i, const std::vector<stmt_t>& program, const budget& limits);
+      // a paused run is cancelled and unwound, which reports it
+      ~metered_run();
+      metered_run(const metered_run&) = delete;
+      metered_run& operator=(const metered_run&) = delete;
+
+      // a slice of 0 runs to the end
+      status resume(std::uint64_t slice = 0);
+      status state() const noexcept;
+      const meter& usage() const noexcept;
+
+    private:
+      static void entry(void* self);
+
+    private:
+      interpreter& m_interpreter;
+      const std::vector<stmt_t>& m_program;
+      meter m_meter;
+      stack_context m_host;
+      stack_context m_run;
+      status m_status = status::paused;
+  };
+
+} // namespace cwt
@@ -0,0 +1,71 @@
+#include <iomanip>
+#include <iterator>
+#include <tuple>
+
+#include "metrics.hpp"
+
+namespace cwt
+{
+  namespace
+  {
+    thread_local metrics current;
+
+    constexpr const char* expr_names[] = {
+      "assign", "binary", "call", "get", "grouping", "literal",
+      "logical", "set", "super", "this", "unary", "variable", "cached",
+      "array", "index", "index_set", "map"
+    };
+    constexpr const char* stmt_names[] = {
+      "block", "class", "expression", "function", "if", "print", "return", "var", "while"
+    };
+    static_assert(std::size(expr_names) == std::tuple_size_v<decltype(metrics::expr_dispatches)>);
+    static_assert(std::size(stmt_names) == std::tuple_size_v<decltype(metrics::stmt_dispatches)>);
+
+    void line(std::ostream& out, const char* name, std::uint64_t value)
+    {
+      out << "  " << std::left << std::setw(24) << name << std::right << std::setw(14) << value << '\n';
+    }
+  }
+
+  metrics& current_metrics() noexcept
+  {
+    return current;
+  }
+
+  void reset_metrics() noexcept
+  {
+    current = metrics{};
+  }
+
+  void report_metrics(std::ostream& out, const metrics& m)
+  {
+    out << "\n===== metrics =====\n";
+    line(out, "obj allocations", m.allocations);
+    line(out, "obj copies", m.copies);
+    line(out, "env lookups", m.lookups);
+    line(out, "env assignments", m.assignments);
+    line(out, "env chain hops", m.lookup_depth);
+    line(out, "env hash probes", m.hash_probes);
+    line(out, "function calls", m.function_calls);
+    line(out, "native calls", m.native_calls);
+    line(out, "returns thrown", m.returns_thrown);
+    line(out, "errors thrown", m.errors_thrown);
+    if (const std::uint64_t accesses = m.lookups + m.assignments)
+    {
+      out << "  " << std::left << std::setw(24) << "avg chain hops" << std::right << std::setw(14)
+        << std::fixed << std::setprecision(2) << double(m.lookup_depth) / double(accesses) << '\n';
+    }
+
+    out << "expression dispatches:\n";
+    for (std::size_t i = 0 ; i < m.expr_dispatches.size() ; ++i)
+    {
+      if (m.expr_dispatches[i]) { line(out, expr_names[i], m.expr_dispatches[i]); }
+    }
+    out << "statement dispatches:\n";
+    for (std::size_t i = 0 ; i < m.stmt_dispatches.size() ; ++i)
+    {
+      if (m.stmt_dispatches[i]) { line(out, stmt_names[i], m.stmt_dispatches[i]); }
+    }
+  }
+
+} // namespace cwt
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+namespace cwt
+{
+  // counters of the running thread. they are only touched through LOX_COUNT,
+  // which compiles to nothing unless the build defines LOX_METRICS.
+  struct metrics
+  {
+    std::uint64_t allocations = 0;
+    std::uint64_t copies = 0;
+    std::uint64_t lookups = 0;
+    std::uint64_t lookup_depth = 0;
+    std::uint64_t assignments = 0;
+    std::uint64_t hash_probes = 0;
+    std::uint64_t function_calls = 0;
+    std::uint64_t native_calls = 0;
+    std::uint64_t returns_thrown = 0;
+    std::uint64_t errors_thrown = 0;
+    std::array<std::uint64_t, 17> expr_dispatches{};
+    std::array<std::uint64_t, 9> stmt_dispatches{};
+  };
+
+  metrics& current_metrics() noexcept;
+  void reset_metrics() noexcept;
+  void report_metrics(std::ostream& out, const metrics& m);
+
+  constexpr bool metrics_enabled() noexcept
+  {
+#ifdef LOX_METRICS
+    return true;
+#else
+    return false;
+#endif
+  }
+
+} // namespace cwt
+
+#ifdef LOX_METRICS
+#define LOX_COUNT(counter) (++::cwt::current_metrics().counter)
+#define LOX_COUNT_N(counter, n) (::cwt::current_metrics().counter += (n))
+#else
+#define LOX_COUNT(counter) ((void)0)
+#define LOX_COUNT_N(counter, n) ((void)0)
+#endif
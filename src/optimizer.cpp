@@ -0,0 +1,454 @@
+#include <algorithm>
+#include <charconv>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "optimizer.hpp"
+
+namespace cwt
+{
+  namespace
+  {
+    using expr_t = std::unique_ptr<lox_expression<lox_obj>>;
+    using stmt_t = std::unique_ptr<lox_statement<lox_obj>>;
+    using name_set = std::unordered_set<std::string>;
+
+    // builtins without side effects, their result only depends on the arguments
+    constexpr std::string_view pure_natives[] = {
+      "abs", "amax", "amin", "ceil", "cos", "count", "dot", "exp", "floor", "len",
+      "log", "max", "min", "num", "pow", "round", "sin", "sqrt", "str", "substr", "sum"
+    };
+    // the pure ones that look into arrays and maps, their result changes with them
+    constexpr std::string_view content_natives[] = { "amax", "amin", "count", "dot", "len", "str", "sum" };
+
+    template<typename Node>
+    Node& as(lox_expression<lox_obj>& e) { return static_cast<Node&>(e); }
+    template<typename Node>
+    Node& as(lox_statement<lox_obj>& s) { return static_cast<Node&>(s); }
+
+    // calls f on every direct child slot of e
+    template<typename F>
+    void for_each_child(lox_expression<lox_obj>& e, F&& f)
+    {
+      switch (e.type())
+      {
+        case expr_type::_assign: f(as<expr_assign<lox_obj>>(e).value);
+        break; case expr_type::_binary: f(as<expr_binary<lox_obj>>(e).left); f(as<expr_binary<lox_obj>>(e).right);
+        break; case expr_type::_logical: f(as<expr_logical<lox_obj>>(e).left); f(as<expr_logical<lox_obj>>(e).right);
+        break; case expr_type::_unary: f(as<expr_unary<lox_obj>>(e).right);
+        break; case expr_type::_grouping: f(as<expr_grouping<lox_obj>>(e).expr);
+        break; case expr_type::_call:
+        {
+          auto& c = as<expr_call<lox_obj>>(e);
+          f(c.callee);
+          for (auto& arg : c.args) { f(arg); }
+        }
+        break; case expr_type::_array:
+        {
+          for (auto& element : as<expr_array<lox_obj>>(e).elements) { f(element); }
+        }
+        break; case expr_type::_map:
+        {
+          auto& m = as<expr_map<lox_obj>>(e);
+          for (std::size_t i = 0 ; i < m.keys.size() ; ++i)
+          {
+            f(m.keys[i]);
+            f(m.values[i]);
+          }
+        }
+        break; case expr_type::_index: f(as<expr_index<lox_obj>>(e).obj); f(as<expr_index<lox_obj>>(e).index);
+        break; case expr_type::_index_set:
+        {
+          auto& i = as<expr_index_set<lox_obj>>(e);
+          f(i.obj);
+          f(i.index);
+          f(i.value);
+        }
+        break; default: break;
+      }
+    }
+
+    // calls on_expr for the expressions a statement evaluates itself and
+    // on_list for the statement lists nested in it
+    template<typename OnExpr, typename OnList>
+    void for_each_part(lox_statement<lox_obj>& s, OnExpr&& on_expr, OnList&& on_list)
+    {
+      switch (s.type())
+      {
+        case stmt_type::_expression: on_expr(as<stmt_expression<lox_obj>>(s).expression);
+        break; case stmt_type::_print: on_expr(as<stmt_print<lox_obj>>(s).expression);
+        break; case stmt_type::_var: on_expr(as<stmt_var<lox_obj>>(s).initializer);
+        break; case stmt_type::_return: on_expr(as<stmt_return<lox_obj>>(s).value);
+        break; case stmt_type::_block: on_list(as<stmt_block<lox_obj>>(s).statements);
+        break; case stmt_type::_if:
+        {
+          auto& i = as<stmt_if<lox_obj>>(s);
+          on_expr(i.condition);
+          on_list(i.then_branch);
+          on_list(i.else_branch);
+        }
+        break; case stmt_type::_while:
+        {
+          auto& w = as<stmt_while<lox_obj>>(s);
+          on_expr(w.condition);
+          on_list(w.body);
+        }
+        break; default: break;
+      }
+    }
+
+    struct effects
+    {
+      name_set written;
+      bool calls = false;
+      // an element of some array or map is assigned
+      bool stores = false;
+    };
+
+    class optimizer
+    {
+      public:
+        optimizer(std::vector<stmt_t>& program)
+        {
+          scan(program, m_declared, true);
+          for (const auto& s : program)
+          {
+            functions_writes(*s);
+          }
+        }
+
+        void run(std::vector<stmt_t>& statements)
+        {
+          for (auto& s : statements)
+          {
+            if (s->type() == stmt_type::_while)
+            {
+              hoist_loop(as<stmt_while<lox_obj>>(*s));
+            }
+            if (s->type() == stmt_type::_function)
+            {
+              run(as<stmt_function<lox_obj>>(*s).body);
+              continue;
+            }
+            for_each_part(*s, [this](expr_t& e) { share(e); }, [this](std::vector<stmt_t>& list) { run(list); });
+          }
+        }
+
+        optimizer_stats stats;
+
+      private:
+        // names a statement list writes (assignments and declarations) and
+        // whether it calls anything that is not a pure builtin.
+        // function bodies only count with into_functions.
+        void scan(std::vector<stmt_t>& statements, effects& out, bool into_functions)
+        {
+          for (auto& s : statements)
+          {
+            if (s->type() == stmt_type::_function)
+            {
+              auto& f = as<stmt_function<lox_obj>>(*s);
+              out.written.insert(f.name);
+              if (into_functions)
+              {
+                out.written.insert(f.parameters.begin(), f.parameters.end());
+                scan(f.body, out, true);
+              }
+              continue;
+            }
+            if (s->type() == stmt_type::_var)
+            {
+              out.written.insert(as<stmt_var<lox_obj>>(*s).name);
+            }
+            else if (s->type() == stmt_type::_class)
+            {
+              out.written.insert(as<stmt_class<lox_obj>>(*s).name);
+            }
+            for_each_part(*s,
+              [this, &out](expr_t& e) { scan(e, out); },
+              [this, &out, into_functions](std::vector<stmt_t>& list) { scan(list, out, into_functions); });
+          }
+        }
+        void scan(expr_t& e, effects& out)
+        {
+          if (!e) { return; }
+          if (e->type() == expr_type::_assign)
+          {
+            out.written.insert(as<expr_assign<lox_obj>>(*e).name);
+          }
+          else if (e->type() == expr_type::_call && !pure_call(*e))
+          {
+            out.calls = true;
+          }
+          else if (e->type() == expr_type::_index_set)
+          {
+            out.stores = true;
+          }
+          for_each_child(*e, [this, &out](expr_t& child) { scan(child, out); });
+        }
+
+        // assignments in function bodies reach the caller
+        void functions_writes(lox_statement<lox_obj>& s)
+        {
+          if (s.type() == stmt_type::_function)
+          {
+            effects body;
+            scan(as<stmt_function<lox_obj>>(s).body, body, true);
+            for (const auto& name : body.written) { m_function_writes.insert(name); }
+            return;
+          }
+          for_each_part(s, [](expr_t&) {}, [this](std::vector<stmt_t>& list)
+          {
+            for (auto& nested : list) { functions_writes(*nested); }
+          });
+        }
+
+        bool pure_call(lox_expression<lox_obj>& e) const
+        {
+          auto& c = as<expr_call<lox_obj>>(e);
+          if (c.callee->type() != expr_type::_variable) { return false; }
+          const std::string& name = as<expr_variable<lox_obj>>(*c.callee).name;
+          return std::find(std::begin(pure_natives), std::end(pure_natives), name) != std::end(pure_natives)
+            && !m_declared.written.contains(name);
+        }
+
+        static bool reads_contents(lox_expression<lox_obj>& e)
+        {
+          const std::string& name = as<expr_variable<lox_obj>>(*as<expr_call<lox_obj>>(e).callee).name;
+          return std::find(std::begin(content_natives), std::end(content_natives), name) != std::end(content_natives);
+        }
+
+        bool pure(lox_expression<lox_obj>& e) const
+        {
+          switch (e.type())
+          {
+            case expr_type::_literal:
+            case expr_type::_variable: return true;
+            break; case expr_type::_call: if (!pure_call(e) || (m_contents_change && reads_contents(e))) { return false; }
+            break; case expr_type::_binary:
+            case expr_type::_logical:
+            case expr_type::_unary:
+            case expr_type::_grouping: break;
+            break; default: return false;
+          }
+          bool all = true;
+          for_each_child(e, [this, &all](expr_t& child) { all = all && pure(*child); });
+          return all;
+        }
+
+        // literals and variables are as cheap as a lookup in the cache
+        static bool worth_caching(lox_expression<lox_obj>& e)
+        {
+          if (e.type() == expr_type::_grouping)
+          {
+            return worth_caching(*as<expr_grouping<lox_obj>>(e).expr);
+          }
+          return e.type() != expr_type::_literal && e.type() != expr_type::_variable;
+        }
+
+        static bool reads_any(lox_expression<lox_obj>& e, const name_set& names)
+        {
+          if (e.type() == expr_type::_variable)
+          {
+            return names.contains(as<expr_variable<lox_obj>>(e).name);
+          }
+          bool any = false;
+          for_each_child(e, [&names, &any](expr_t& child) { any = any || reads_any(*child, names); });
+          return any;
+        }
+
+        static void wrap(expr_t& slot, std::shared_ptr<memo_cell<lox_obj>> cell, const std::uint64_t* epoch, bool reuse)
+        {
+          const source_loc loc = slot->loc;
+          slot = std::make_unique<expr_cached<lox_obj>>(std::move(slot), std::move(cell), epoch, reuse, loc);
+        }
+
+        // loop invariant code motion
+        void hoist_loop(stmt_while<lox_obj>& loop)
+        {
+          effects inside;
+          scan(loop.condition, inside);
+          scan(loop.body, inside, false);
+          if (inside.calls)
+          {
+            inside.written.insert(m_function_writes.begin(), m_function_writes.end());
+          }
+          // any call may push to an array or remove from a map
+          m_contents_change = inside.calls || inside.stores;
+          hoist(loop.condition, inside.written, &loop.epoch);
+          hoist(loop.body, inside.written, &loop.epoch);
+        }
+        void hoist(std::vector<stmt_t>& statements, const name_set& written, const std::uint64_t* epoch)
+        {
+          for (auto& s : statements)
+          {
+            if (s->type() == stmt_type::_function) { continue; }
+            for_each_part(*s,
+              [&](expr_t& e) { hoist(e, written, epoch); },
+              [&](std::vector<stmt_t>& list) { hoist(list, written, epoch); });
+          }
+        }
+        void hoist(expr_t& e, const name_set& written, const std::uint64_t* epoch)
+        {
+          if (!e) { return; }
+          if (worth_caching(*e) && pure(*e) && !reads_any(*e, written))
+          {
+            wrap(e, std::make_shared<memo_cell<lox_obj>>(), epoch, false);
+            ++stats.hoisted;
+            return;
+          }
+          for_each_child(*e, [&](expr_t& child) { hoist(child, written, epoch); });
+        }
+
+        // common subexpressions of one statement
+        struct occurrence
+        {
+          expr_t* slot;
+          std::size_t first;
+          std::size_t last;
+          bool conditional;
+        };
+
+        void share(expr_t& root)
+        {
+          if (!root) { return; }
+          effects inside;
+          scan(root, inside);
+          if (inside.calls) { return; }
+          m_contents_change = inside.stores;
+
+          std::vector<occurrence> found;
+          std::unordered_map<std::string, std::vector<std::size_t>> groups;
+          std::size_t index = 0;
+          collect(root, inside.written, false, index, found, groups);
+
+          std::vector<std::pair<std::size_t, std::vector<std::size_t>*>> ordered;
+          for (auto& [key, members] : groups)
+          {
+            if (members.size() > 1)
+            {
+              const occurrence& o = found[members.front()];
+              ordered.emplace_back(o.last - o.first, &members);
+            }
+          }
+          // largest first, the smaller ones inside are covered then
+          std::sort(ordered.begin(), ordered.end(), [](const auto& l, const auto& r) { return l.first > r.first; });
+
+          std::vector<std::pair<std::size_t, std::size_t>> wrapped;
+          auto covered = [&wrapped](const occurrence& o)
+          {
+            return std::any_of(wrapped.begin(), wrapped.end(), [&o](const auto& w) { return w.first <= o.first && o.last <= w.second; });
+          };
+          for (auto& [size, members] : ordered)
+          {
+            std::vector<occurrence*> live;
+            for (const std::size_t m : *members)
+            {
+              if (!covered(found[m])) { live.push_back(&found[m]); }
+            }
+            auto def = std::find_if(live.begin(), live.end(), [](const occurrence* o) { return !o->conditional; });
+            if (def == live.end() || def + 1 == live.end()) { continue; }
+
+            auto cell = std::make_shared<memo_cell<lox_obj>>();
+            for (auto it = def ; it != live.end() ; ++it)
+            {
+              wrapped.emplace_back((*it)->first, (*it)->last);
+              wrap(*(*it)->slot, cell, nullptr, it != def);
+            }
+            stats.shared += live.end() - def - 1;
+          }
+        }
+        // pre-order, first..last is the range of indices of the subtree
+        void collect(expr_t& e, const name_set& written, bool conditional, std::size_t& index,
+          std::vector<occurrence>& found, std::unordered_map<std::string, std::vector<std::size_t>>& groups)
+        {
+          const std::size_t first = index++;
+          std::size_t at = found.size();
+          // a grouping has the key of what it groups, its child stands for it
+          const bool candidate = e->type() != expr_type::_grouping && worth_caching(*e) && pure(*e) && !reads_any(*e, written);
+          if (candidate)
+          {
+            found.push_back(occurrence{&e, first, first, conditional});
+            groups[key(*e)].push_back(at);
+          }
+          if (e->type() == expr_type::_logical)
+          {
+            auto& l = as<expr_logical<lox_obj>>(*e);
+            collect(l.left, written, conditional, index, found, groups);
+            collect(l.right, written, true, index, found, groups);
+          }
+          else
+          {
+            for_each_child(*e, [&](expr_t& child) { collect(child, written, conditional, index, found, groups); });
+          }
+          if (candidate)
+          {
+            found[at].last = index - 1;
+          }
+        }
+
+        // structural identity of a pure expression
+        static std::string key(lox_expression<lox_obj>& e)
+        {
+          std::string k;
+          append_key(e, k);
+          return k;
+        }
+        static void append_key(lox_expression<lox_obj>& e, std::string& k)
+        {
+          auto name = [&k](const std::string& n)
+          {
+            k.append(std::to_string(n.size()));
+            k.push_back(':');
+            k.append(n);
+          };
+          switch (e.type())
+          {
+            case expr_type::_grouping: append_key(*as<expr_grouping<lox_obj>>(e).expr, k); return;
+            break; case expr_type::_variable: k.push_back('v'); name(as<expr_variable<lox_obj>>(e).name); return;
+            break; case expr_type::_literal:
+            {
+              const lox_obj& value = as<expr_literal<lox_obj>>(e).value;
+              switch (value.type())
+              {
+                case value_type::number:
+                {
+                  char buffer[32];
+                  auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value.number(), std::chars_format::hex);
+                  k.push_back('n');
+                  k.append(buffer, end);
+                  k.push_back(';');
+                }
+                break; case value_type::string: k.push_back('s'); name(value.string());
+                break; case value_type::boolean: k.append(value.boolean() ? "t" : "f");
+                break; default: k.push_back('0');
+              }
+              return;
+            }
+            break; case expr_type::_binary: k.append("b" + std::to_string(static_cast<int>(as<expr_binary<lox_obj>>(e).op)));
+            break; case expr_type::_logical: k.append("l" + std::to_string(static_cast<int>(as<expr_logical<lox_obj>>(e).op)));
+            break; case expr_type::_unary: k.append("u" + std::to_string(static_cast<int>(as<expr_unary<lox_obj>>(e).op)));
+            break; case expr_type::_call: k.append("c" + std::to_string(as<expr_call<lox_obj>>(e).args.size()));
+            break; default: break;
+          }
+          k.push_back('(');
+          for_each_child(e, [&k](expr_t& child) { append_key(*child, k); k.push_back(','); });
+          k.push_back(')');
+        }
+
+      private:
+        effects m_declared;
+        name_set m_function_writes;
+        // of the loop or statement being worked on
+        bool m_contents_change = false;
+    };
+  }
+
+  optimizer_stats optimize(std::vector<stmt_t>& statements)
+  {
+    optimizer o(statements);
+    o.run(statements);
+    return o.stats;
+  }
+
+} // namespace cwt
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "stmt.hpp"
+
+namespace cwt
+{
+  struct optimizer_stats
+  {
+    std::size_t hoisted = 0;
+    std::size_t shared = 0;
+  };
+
+  // rewrites the tree in place with expr_cached nodes:
+  //   - pure expressions inside a loop whose variables the loop never
+  //     assigns are computed once per run of the loop
+  //   - a pure expression repeated within one statement is computed once
+  //     and reused by the later occurrences
+  // both are lazy, nothing is evaluated earlier than before and runtime
+  // errors stay where they were. calls to functions of the program may
+  // assign any variable they can see (scoping is dynamic), so they count
+  // as assigning every name some function assigns.
+  optimizer_stats optimize(std::vector<std::unique_ptr<lox_statement<lox_obj>>>& statements);
+
+} // namespace cwt
@@ -1,6 +1,11 @@
 #pragma once 
 
+#include <charconv>
+#include <iostream>
+
+#include "error.hpp"
 #include "token.hpp"
+#include "token_stream.hpp"
 #include "stmt.hpp"
 
 namespace cwt
@@ -13,7 +18,8 @@ namespace cwt
     using stmt_t = std::unique_ptr<lox_statement<value_t>>;
     
     public: 
-      parser(const std::vector<token>& tokens) : m_tokens(tokens) {}
+      // base is the location of the first source byte in the programs source_map
+      parser(const token_stream& tokens, source_loc base = {}) : m_tokens(tokens), m_base(base) {}
 
       std::vector<stmt_t> parse()
       {
@@ -28,6 +34,12 @@ namespace cwt
         return statements;
       }
 
+      // one top level declaration at a time, for callers that need to know
+      // which tokens each one took. position() is the next token.
+      bool done() { return is_at_end(); }
+      std::vector<stmt_t> parse_declaration() { return declaration(); }
+      std::size_t position() const noexcept { return m_current; }
+
     private:
       std::vector<stmt_t> declaration()
       {
@@ -53,7 +65,7 @@ namespace cwt
         catch(const std::exception& e)
         {
           synchronize();
-          std::cerr << e.what() << '\n';
+          error_stream() << e.what() << '\n';
           return {};
         }
       }
@@ -63,41 +75,41 @@ namespace cwt
         std::string s1{"Expected: "};
         s1.append(kind);
         s1.append(" name.");
-        token name = consume(token_type::IDENTIFIER, s1);
+        const std::size_t name = consume(token_type::IDENTIFIER, s1);
         
         std::string s2{"Expected \'(\' after "};
         s2.append(kind);
         s2.append(" name.");
         consume(token_type::LEFT_PAREN, s2);
 
-        std::vector<token> parameters;
+        std::vector<std::string> parameters;
         if (!check(token_type::RIGHT_PAREN))
         {
           do {
             if (parameters.size() >= 255) { error(peek(), "Can't have more than 255 parameters."); }
-            parameters.push_back(consume(token_type::IDENTIFIER, "Expected parameter name"));
+            parameters.push_back(lexeme(consume(token_type::IDENTIFIER, "Expected parameter name")));
           } while (match(token_type::COMMA));
-          consume(token_type::RIGHT_PAREN, "Expected \')\' after parameters.");
-
-          std::string s3{"Expected \'{\' before "};
-          s3.append(kind);
-          s3.append(" body.");
-          consume(token_type::LEFT_BRACE, s3);
-          std::vector<stmt_t> body = block();
-          return std::make_unique<stmt_function<value_t>>(name, parameters, std::move(body));
         }
+        consume(token_type::RIGHT_PAREN, "Expected \')\' after parameters.");
+
+        std::string s3{"Expected \'{\' before "};
+        s3.append(kind);
+        s3.append(" body.");
+        consume(token_type::LEFT_BRACE, s3);
+        std::vector<stmt_t> body = block();
+        return std::make_unique<stmt_function<value_t>>(lexeme(name), std::move(parameters), std::move(body), loc(name));
       }
 
       stmt_t var_declaration()
       {
-        token name = consume(token_type::IDENTIFIER, "Expected variable name.");
+        const std::size_t name = consume(token_type::IDENTIFIER, "Expected variable name.");
         expr_t initializer = nullptr;
         if (match(token_type::EQUAL))
         {
           initializer = expression();
         }
         consume(token_type::SEMICOLON, "Expected \';\' after variable declaration");
-        return std::make_unique<stmt_var<value_t>>(name, std::move(initializer));
+        return std::make_unique<stmt_var<value_t>>(lexeme(name), std::move(initializer), loc(name));
       }
       std::vector<stmt_t> statement()
       {
@@ -140,6 +152,7 @@ namespace cwt
 
       stmt_t for_statement()
       {
+        const source_loc keyword = loc(m_current-1);
         consume(token_type::LEFT_PAREN, "Expect \'(\' after \'for\'.");
         stmt_t initializer; 
         if (match(token_type::SEMICOLON)) { initializer = nullptr; }
@@ -158,21 +171,22 @@ namespace cwt
 
         if (increment) 
         {
-          body.push_back(std::make_unique<stmt_expression<value_t>>(std::move(increment)));
+          const source_loc increment_loc = increment->loc;
+          body.push_back(std::make_unique<stmt_expression<value_t>>(std::move(increment), increment_loc));
         }
         if (condition == nullptr) 
         { 
-          condition = std::make_unique<expr_literal<value_t>>(true); 
+          condition = std::make_unique<expr_literal<value_t>>(true, keyword); 
         }
 
-        auto while_loop = std::make_unique<stmt_while<value_t>>(std::move(condition), std::move(body));
+        auto while_loop = std::make_unique<stmt_while<value_t>>(std::move(condition), std::move(body), keyword);
         if (initializer)
         {
           std::vector<stmt_t> for_loop; 
           for_loop.reserve(2);
           for_loop.push_back(std::move(initializer));
           for_loop.push_back(std::move(while_loop));
-          return std::make_unique<stmt_block<value_t>>(std::move(for_loop));
+          return std::make_unique<stmt_block<value_t>>(std::move(for_loop), keyword);
         }
         else 
         {
@@ -182,15 +196,17 @@ namespace cwt
 
       stmt_t while_statement()
       {
+        const source_loc keyword = loc(m_current-1);
         consume(token_type::LEFT_PAREN, "Expect \'(\' after \'while\'.");
         expr_t condition = expression();
         consume(token_type::RIGHT_PAREN, "Expect \')\' after condition in while.");
         std::vector<stmt_t> body = statement();
-        return std::make_unique<stmt_while<value_t>>(std::move(condition), std::move(body));
+        return std::make_unique<stmt_while<value_t>>(std::move(condition), std::move(body), keyword);
       }
 
       stmt_t if_statement()
       {
+        const source_loc keyword = loc(m_current-1);
         consume(token_type::LEFT_PAREN, "Expect \'(\' after \'if\'.");
         expr_t condition = expression();
         consume(token_type::RIGHT_PAREN, "Expect \')\' after if condition.");
@@ -200,34 +216,36 @@ namespace cwt
         {
           else_branch = statement();
         }
-        return std::make_unique<stmt_if<value_t>>(std::move(condition), std::move(then_branch), std::move(else_branch));
+        return std::make_unique<stmt_if<value_t>>(std::move(condition), std::move(then_branch), std::move(else_branch), keyword);
       }
       
       stmt_t return_statement()
       { 
-        token keyword = previous();
+        const source_loc keyword = loc(m_current-1);
         expr_t value;
         if (!check(token_type::SEMICOLON)) 
         {
           value = expression();
         }
         consume(token_type::SEMICOLON, "Expect \';\' after return value.");
-        return std::make_unique<stmt_return<value_t>>(keyword, std::move(value));
+        return std::make_unique<stmt_return<value_t>>(std::move(value), keyword);
       }
 
       stmt_t print_statement()
       {
+        const source_loc keyword = loc(m_current-1);
         expr_t value = expression();
         consume(token_type::SEMICOLON, "Expect \';\' after value.");
   
-        return std::make_unique<stmt_print<value_t>>(std::move(value));
+        return std::make_unique<stmt_print<value_t>>(std::move(value), keyword);
       }
       
       stmt_t expression_statement()
       {
         expr_t expr = expression();
         consume(token_type::SEMICOLON, "Expect \';\' after expression.");
-        return std::make_unique<stmt_expression<value_t>>(std::move(expr));
+        const source_loc expr_loc = expr->loc;
+        return std::make_unique<stmt_expression<value_t>>(std::move(expr), expr_loc);
       }
 
       std::vector<stmt_t> block()
@@ -255,16 +273,21 @@ namespace cwt
         expr_t expr = or_operator();
         if(match(token_type::EQUAL))
         {
-          token equals = previous();
+          const std::size_t equals = m_current-1;
           expr_t value = assignment();
           if(expr->type() == expr_type::_variable)
           {
-            token name = static_cast<expr_variable<value_t>*>(expr.get())->name;
-            return std::make_unique<expr_assign<lox_obj>>(name, std::move(value));
+            auto* target = static_cast<expr_variable<value_t>*>(expr.get());
+            return std::make_unique<expr_assign<value_t>>(std::move(target->name), std::move(value), target->loc);
+          }
+          else if (expr->type() == expr_type::_index)
+          {
+            auto* target = static_cast<expr_index<value_t>*>(expr.get());
+            return std::make_unique<expr_index_set<value_t>>(std::move(target->obj), std::move(target->index), std::move(value), target->loc);
           }
           else
           {
-            error(equals, "Invalid assignment target.");
+            error(m_tokens.at(equals), "Invalid assignment target.");
           }
         }
         return expr;
@@ -276,9 +299,10 @@ namespace cwt
         expr_t expr = and_operator();
         while(match(token_type::OR))
         {
-          token op = previous();
+          const token_type op = m_tokens.type(m_current-1);
+          const source_loc op_loc = loc(m_current-1);
           expr_t right = and_operator();
-          expr = std::make_unique<expr_logical<value_t>>(std::move(expr), op, std::move(right));
+          expr = std::make_unique<expr_logical<value_t>>(std::move(expr), op, std::move(right), op_loc);
         }
         return std::move(expr);
       }
@@ -287,9 +311,10 @@ namespace cwt
         expr_t expr = equality();
         while (match(token_type::AND))
         {
-          token op = previous();
+          const token_type op = m_tokens.type(m_current-1);
+          const source_loc op_loc = loc(m_current-1);
           expr_t right = equality();
-          expr = std::make_unique<expr_logical<value_t>>(std::move(expr), op, std::move(right));
+          expr = std::make_unique<expr_logical<value_t>>(std::move(expr), op, std::move(right), op_loc);
         }
         return std::move(expr);
       }
@@ -299,9 +324,10 @@ namespace cwt
         expr_t expr = comparison();
         while (match(token_type::BANG_EQUAL, token_type::EQUAL_EQUAL))
         {
-          token op = previous();
+          const token_type op = m_tokens.type(m_current-1);
+          const source_loc op_loc = loc(m_current-1);
           expr_t right = comparison();
-          expr = std::make_unique<expr_binary<value_t>>(std::move(expr), op, std::move(right));
+          expr = std::make_unique<expr_binary<value_t>>(std::move(expr), op, std::move(right), op_loc);
         }
         return expr; 
       }
@@ -329,29 +355,41 @@ namespace cwt
         }
         else 
         {
-          return peek().type == t;
+          return peek_type() == t;
         }
       }
 
-      token advance()
+      std::size_t advance()
       {
         if (!is_at_end()) ++m_current;
-        return previous();
+        return m_current-1;
       }
 
       bool is_at_end() 
       {
-        return peek().type == token_type::END_OF_FILE;
+        return peek_type() == token_type::END_OF_FILE;
       }
 
+      token_type peek_type()
+      {
+        return m_tokens.type(m_current);
+      }
+
+      // tokens are only materialized for nodes and diagnostics, 
+      // matching and checking looks at the type array alone 
       token peek()
       {
-        return m_tokens[m_current];
+        return m_tokens.at(m_current);
+      }
+
+      source_loc loc(std::size_t i)
+      {
+        return source_loc{m_base.offset + static_cast<std::uint32_t>(m_tokens.offset(i))};
       }
 
-      token previous()
+      std::string lexeme(std::size_t i)
       {
-        return m_tokens[m_current-1];
+        return std::string(m_tokens.lexeme(i));
       }
 
       expr_t comparison()
@@ -359,9 +397,10 @@ namespace cwt
         expr_t expr = term();
         while(match(token_type::GREATER, token_type::GREATER_EQUAL, token_type::LESS, token_type::LESS_EQUAL))
         {
-          token op = previous();
+          const token_type op = m_tokens.type(m_current-1);
+          const source_loc op_loc = loc(m_current-1);
           expr_t right = term();
-          expr = std::make_unique<cwt::expr_binary<value_t>>(std::move(expr), op, std::move(right));
+          expr = std::make_unique<expr_binary<value_t>>(std::move(expr), op, std::move(right), op_loc);
         }
         return expr;
       }
@@ -371,9 +410,10 @@ namespace cwt
         expr_t expr = factor();
         while(match(token_type::MINUS, token_type::PLUS))
         {
-          token op = previous();
+          const token_type op = m_tokens.type(m_current-1);
+          const source_loc op_loc = loc(m_current-1);
           expr_t right = factor();
-          expr = std::make_unique<expr_binary<value_t>>(std::move(expr), op, std::move(right));
+          expr = std::make_unique<expr_binary<value_t>>(std::move(expr), op, std::move(right), op_loc);
         }
         return expr; 
       }
@@ -383,9 +423,10 @@ namespace cwt
         expr_t expr = unary();
         while (match(token_type::SLASH, token_type::STAR))
         {
-          token op = previous();
+          const token_type op = m_tokens.type(m_current-1);
+          const source_loc op_loc = loc(m_current-1);
           expr_t right = unary();
-          expr = std::make_unique<expr_binary<value_t>>(std::move(expr), op, std::move(right));
+          expr = std::make_unique<expr_binary<value_t>>(std::move(expr), op, std::move(right), op_loc);
         }
         return expr; 
       }
@@ -394,9 +435,10 @@ namespace cwt
       {
         if (match(token_type::BANG, token_type::MINUS))
         {
-          token op = previous();
+          const token_type op = m_tokens.type(m_current-1);
+          const source_loc op_loc = loc(m_current-1);
           expr_t right = unary();
-          return std::make_unique<expr_unary<value_t>>(op, std::move(right));
+          return std::make_unique<expr_unary<value_t>>(op, std::move(right), op_loc);
         }
         return call();
       }
@@ -410,6 +452,13 @@ namespace cwt
           {
             expr = finish_call(std::move(expr));
           }
+          else if (match(token_type::LEFT_BRACKET))
+          {
+            const source_loc bracket = loc(m_current-1);
+            expr_t index = expression();
+            consume(token_type::RIGHT_BRACKET, "Expected \']\' after index.");
+            expr = std::make_unique<expr_index<value_t>>(std::move(expr), std::move(index), bracket);
+          }
           else 
           {
             break;
@@ -430,37 +479,71 @@ namespace cwt
             args.push_back(expression()); 
           } while (match(token_type::COMMA));
         }
-        token paren = consume(token_type::RIGHT_PAREN, "Expected \')\' after arguments.");
-        return std::make_unique<expr_call<value_t>>(std::move(callee), paren, std::move(args));
+        const std::size_t paren = consume(token_type::RIGHT_PAREN, "Expected \')\' after arguments.");
+        return std::make_unique<expr_call<value_t>>(std::move(callee), std::move(args), loc(paren));
       }
 
       expr_t primary()
       {
-        if (match(token_type::FALSE)) return std::make_unique<expr_literal<value_t>>(false);
-        if (match(token_type::TRUE)) return std::make_unique<expr_literal<value_t>>(true);
-        if (match(token_type::NIL)) return std::make_unique<expr_literal<value_t>>();
+        if (match(token_type::FALSE)) return std::make_unique<expr_literal<value_t>>(false, loc(m_current-1));
+        if (match(token_type::TRUE)) return std::make_unique<expr_literal<value_t>>(true, loc(m_current-1));
+        if (match(token_type::NIL)) return std::make_unique<expr_literal<value_t>>(loc(m_current-1));
         if (match(token_type::NUMBER))
         {
-          return std::make_unique<expr_literal<value_t>>(std::stod(previous().literal));
+          const std::string_view txt = m_tokens.literal(m_current-1);
+          double value = 0;
+          std::from_chars(txt.data(), txt.data() + txt.size(), value);
+          return std::make_unique<expr_literal<value_t>>(value, loc(m_current-1));
         }
         if (match(token_type::STRING))
         {
-          return std::make_unique<expr_literal<value_t>>(previous().literal);
+          return std::make_unique<expr_literal<value_t>>(std::string(m_tokens.literal(m_current-1)), loc(m_current-1));
         }
         if (match(token_type::IDENTIFIER))
         {
-          return std::make_unique<expr_variable<value_t>>(previous());
+          return std::make_unique<expr_variable<value_t>>(lexeme(m_current-1), loc(m_current-1));
         }
         if (match(token_type::LEFT_PAREN))
         {
+          const source_loc paren = loc(m_current-1);
           expr_t expr = expression();
           consume(token_type::RIGHT_PAREN, "Expect: \')\' after expression.");
-          return std::make_unique<expr_grouping<value_t>>(std::move(expr));
+          return std::make_unique<expr_grouping<value_t>>(std::move(expr), paren);
+        }
+        if (match(token_type::LEFT_BRACKET))
+        {
+          const source_loc bracket = loc(m_current-1);
+          std::vector<expr_t> elements;
+          if (!check(token_type::RIGHT_BRACKET))
+          {
+            do {
+              elements.push_back(expression());
+            } while (match(token_type::COMMA));
+          }
+          consume(token_type::RIGHT_BRACKET, "Expected \']\' after array elements.");
+          return std::make_unique<expr_array<value_t>>(std::move(elements), bracket);
+        }
+        // a statement starting with a brace is a block, elsewhere it is a map
+        if (match(token_type::LEFT_BRACE))
+        {
+          const source_loc brace = loc(m_current-1);
+          std::vector<expr_t> keys;
+          std::vector<expr_t> values;
+          if (!check(token_type::RIGHT_BRACE))
+          {
+            do {
+              keys.push_back(expression());
+              consume(token_type::COLON, "Expected \':\' after map key.");
+              values.push_back(expression());
+            } while (match(token_type::COMMA));
+          }
+          consume(token_type::RIGHT_BRACE, "Expected \'}\' after map entries.");
+          return std::make_unique<expr_map<value_t>>(std::move(keys), std::move(values), brace);
         }
         throw std::runtime_error(error(peek(), "Expected expression."));
       }
 
-      token consume(token_type type, const std::string& msg) 
+      std::size_t consume(token_type type, const std::string& msg) 
       {
         if(check(type)) {
           return advance();
@@ -490,8 +573,8 @@ namespace cwt
         advance();
         while (!is_at_end())
         {
-          if (previous().type == token_type::SEMICOLON) return; 
-          switch (peek().type)
+          if (m_tokens.type(m_current-1) == token_type::SEMICOLON) return; 
+          switch (peek_type())
           {
           case token_type::CLASS :
           case token_type::FOR :
@@ -509,6 +592,7 @@ namespace cwt
 
     private:
       std::size_t m_current{0};
-      std::vector<token> m_tokens;
+      const token_stream& m_tokens;
+      source_loc m_base;
   };
 } // namespace cwt
@@ -13,7 +13,7 @@ namespace cwt
 
       std::string visit(const expr_binary<std::string>& e) override
       {
-        return parenthesize(e.op.lexeme, *e.left, *e.right);
+        return parenthesize(lexeme_of(e.op), *e.left, *e.right);
       }
 
       std::string visit(const expr_grouping<std::string>& e) override
@@ -28,7 +28,7 @@ namespace cwt
 
       std::string visit(const expr_unary<std::string>& e) override
       {
-        return parenthesize(e.op.lexeme, *e.right);
+        return parenthesize(lexeme_of(e.op), *e.right);
       }
 
     private:
@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <utility>
+
+#include "profiler.hpp"
+
+namespace cwt
+{
+  namespace 
+  {
+    double to_ms(std::chrono::steady_clock::duration d)
+    {
+      return std::chrono::duration<double, std::milli>(d).count();
+    }
+  } // namespace 
+
+profiler::profiler()
+{
+  const std::size_t root = intern("<main>");
+  m_nodes.push_back(call_node{root, 0});
+  m_stats[root].calls = 1;
+  m_stats[root].active = 1;
+  m_frames.push_back(frame{0, root, clock::now()});
+}
+
+std::size_t profiler::intern(const std::string& function)
+{
+  auto [it, inserted] = m_ids.try_emplace(function, m_stats.size());
+  if (inserted)
+  {
+    m_stats.push_back(function_stats{function});
+  }
+  return it->second;
+}
+
+void profiler::enter(const std::string& function)
+{
+  const std::size_t id = intern(function);
+  function_stats& stats = m_stats[id];
+  ++stats.calls;
+  ++stats.active;
+
+  const std::size_t parent = m_frames.back().node;
+  auto [it, inserted] = m_nodes[parent].children.try_emplace(id, m_nodes.size());
+  const std::size_t node = it->second;
+  if (inserted)
+  {
+    m_nodes.push_back(call_node{id, parent});
+  }
+  m_frames.push_back(frame{node, id, clock::now()});
+}
+
+void profiler::exit()
+{
+  const frame f = m_frames.back();
+  m_frames.pop_back();
+  const clock::duration elapsed = clock::now() - f.start;
+  const clock::duration self = elapsed - f.children;
+
+  function_stats& stats = m_stats[f.function];
+  m_nodes[f.node].self += self;
+  stats.exclusive += self;
+  if (--stats.active == 0)
+  {
+    stats.inclusive += elapsed;
+  }
+  if (!m_frames.empty())
+  {
+    m_frames.back().children += elapsed;
+  }
+}
+
+profiler::call_stack profiler::fiber_stack() const
+{
+  call_stack stack;
+  stack.m_paused = clock::now();
+  stack.m_frames.push_back(frame{0, m_nodes[0].function, stack.m_paused});
+  return stack;
+}
+
+void profiler::switch_stack(call_stack& stack)
+{
+  const clock::time_point now = clock::now();
+  for (frame& f : stack.m_frames)
+  {
+    f.start += now - stack.m_paused;
+  }
+  std::swap(m_frames, stack.m_frames);
+  stack.m_paused = now;
+}
+
+void profiler::finish()
+{
+  while (!m_frames.empty())
+  {
+    exit();
+  }
+}
+
+void profiler::report(std::ostream& out, const source_map* sources) const
+{
+  std::vector<const function_stats*> functions;
+  for (const auto& s : m_stats) 
+  {
+    functions.push_back(&s);
+  }
+  std::sort(functions.begin(), functions.end(), 
+    [](const function_stats* a, const function_stats* b) { return a->exclusive > b->exclusive; });
+
+  out << "\n===== profile: functions =====\n";
+  out << std::left << std::setw(32) << "function" << std::right 
+      << std::setw(12) << "calls" << std::setw(14) << "incl ms" << std::setw(14) << "excl ms" 
+      << std::setw(14) << "evals" << '\n';
+  out << std::fixed << std::setprecision(3);
+  for (const function_stats* s : functions)
+  {
+    out << std::left << std::setw(32) << s->name << std::right 
+        << std::setw(12) << s->calls << std::setw(14) << to_ms(s->inclusive) 
+        << std::setw(14) << to_ms(s->exclusive) << std::setw(14) << s->evaluations << '\n';
+  }
+
+  // statement locations are folded into lines only here
+  std::map<std::pair<std::string, std::size_t>, std::pair<std::uint64_t, std::string>> lines;
+  for (const auto& [offset, hits] : m_line_hits)
+  {
+    std::optional<source_map::position> pos = sources ? sources->decode(source_loc{offset}) : std::nullopt;
+    if (!pos) 
+    {
+      continue;
+    }
+    auto& entry = lines[{std::string(pos->name), pos->line}];
+    entry.first += hits;
+    entry.second = std::string(pos->line_text);
+  }
+  std::vector<std::pair<std::uint64_t, std::string>> hottest;
+  for (const auto& [where, entry] : lines)
+  {
+    std::string s{where.first};
+    s.append(":");
+    s.append(std::to_string(where.second));
+    s.append(": ");
+    s.append(entry.second);
+    hottest.emplace_back(entry.first, std::move(s));
+  }
+  std::sort(hottest.begin(), hottest.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+  if (hottest.size() > 20) 
+  {
+    hottest.resize(20);
+  }
+
+  out << "\n===== profile: hottest lines =====\n";
+  for (const auto& [hits, line] : hottest)
+  {
+    out << std::setw(12) << hits << "  " << line << '\n';
+  }
+  out << std::defaultfloat;
+}
+
+void profiler::collapsed(std::ostream& out, std::size_t node, const std::string& prefix) const
+{
+  std::string path{prefix};
+  if (!path.empty()) 
+  {
+    path.push_back(';');
+  }
+  path.append(m_stats[m_nodes[node].function].name);
+
+  const auto us = std::chrono::duration_cast<std::chrono::microseconds>(m_nodes[node].self).count();
+  if (us > 0)
+  {
+    out << path << ' ' << us << '\n';
+  }
+  for (const auto& [function, child] : m_nodes[node].children)
+  {
+    collapsed(out, child, path);
+  }
+}
+
+void profiler::write_collapsed(std::ostream& out) const
+{
+  collapsed(out, 0, "");
+}
+
+} // namespace cwt
@@ -0,0 +1,104 @@
+#pragma once 
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "source_map.hpp"
+
+namespace cwt
+{
+  // instrumenting profiler. the interpreter only holds a pointer to it, so 
+  // without a profiler every hook is a single null check.
+  class profiler
+  {
+    using clock = std::chrono::steady_clock;
+
+    struct frame 
+    {
+      std::size_t node;
+      std::size_t function;
+      clock::time_point start;
+      clock::duration children{0};
+    };
+
+    public:
+      // the open frames of one fiber, innermost last. time a stack spends
+      // switched out is not charged to its frames
+      class call_stack
+      {
+        friend class profiler;
+        std::vector<frame> m_frames;
+        clock::time_point m_paused;
+      };
+
+      profiler();
+
+      void enter(const std::string& function);
+      void exit();
+      void statement(source_loc loc) { ++m_line_hits[loc.offset]; }
+      void evaluation() { ++m_stats[m_frames.back().function].evaluations; }
+
+      // a stack for a new fiber, its calls show up under <main>
+      call_stack fiber_stack() const;
+      // runs on stack from now on, the stack running before is left in it
+      void switch_stack(call_stack& stack);
+
+      // stops the root frame, no more hooks may be called afterwards
+      void finish();
+
+      // per function calls, inclusive/exclusive time and evaluated nodes, then the hottest lines
+      void report(std::ostream& out, const source_map* sources) const;
+      // one line per call stack: "<main>;outer;inner <exclusive microseconds>", as read by flamegraph.pl
+      void write_collapsed(std::ostream& out) const;
+
+    private:
+      struct function_stats 
+      {
+        std::string name;
+        std::uint64_t calls{0};
+        std::uint64_t evaluations{0};
+        clock::duration inclusive{0};
+        clock::duration exclusive{0};
+        std::size_t active{0};   // recursion depth, inclusive time is only taken by the outermost frame
+      };
+
+      struct call_node 
+      {
+        std::size_t function;
+        std::size_t parent;
+        clock::duration self{0};
+        std::unordered_map<std::size_t, std::size_t> children;
+      };
+
+      std::size_t intern(const std::string& function);
+      void collapsed(std::ostream& out, std::size_t node, const std::string& prefix) const;
+
+    private:
+      std::unordered_map<std::string, std::size_t> m_ids;
+      std::vector<function_stats> m_stats;
+      std::vector<call_node> m_nodes;
+      std::vector<frame> m_frames;
+      std::unordered_map<std::uint32_t, std::uint64_t> m_line_hits;
+  };
+
+  class profile_scope
+  {
+    public:
+      profile_scope(profiler* p, const std::string& function) : m_profiler(p) 
+      {
+        if (m_profiler) { m_profiler->enter(function); }
+      }
+      ~profile_scope() 
+      {
+        if (m_profiler) { m_profiler->exit(); }
+      }
+      profile_scope(const profile_scope&) = delete;
+      profile_scope& operator=(const profile_scope&) = delete;
+    private:
+      profiler* m_profiler;
+  };
+} // namespace cwt
@@ -0,0 +1,100 @@
+#include <fstream>
+#include <optional>
+#include <sstream>
+
+#include "program.hpp"
+#include "error.hpp"
+#include "fast_scanner.hpp"
+#include "parser.hpp"
+#include "scanner.hpp"
+#include "thread_pool.hpp"
+
+namespace cwt
+{
+  namespace 
+  {
+    struct parsed_file 
+    {
+      std::optional<std::string> text;
+      source_loc base;
+      std::vector<std::unique_ptr<lox_statement<lox_obj>>> statements;
+      std::string diagnostics;
+      bool ok = false;
+    };
+
+    std::optional<std::string> read_file(const std::string& path)
+    {
+      std::ifstream file(path, std::ios::in | std::ios::binary);
+      if (!file)
+      {
+        return std::nullopt;
+      }
+      std::stringstream buffer;
+      buffer << file.rdbuf(); 
+      return buffer.str();
+    }
+
+    void parse_file(const source_map& sources, parsed_file& file, bool fast_scan)
+    {
+      std::ostringstream diagnostics;
+      error_state state;
+      state.diagnostics = &diagnostics;
+      scoped_error_state scope(state);
+
+      const std::string& text = sources.text(file.base);
+      token_stream tokens = fast_scan 
+        ? fast_scanner(text).scan_stream() 
+        : scanner(text).scan_stream();
+      parser<lox_obj> parser(tokens, file.base);
+      file.statements = parser.parse();
+
+      file.ok = !state.has_error;
+      file.diagnostics = diagnostics.str();
+    }
+  } // namespace 
+
+  program load_program(thread_pool& pool, const std::vector<std::string>& paths, bool fast_scan)
+  {
+    std::vector<parsed_file> files(paths.size());
+    pool.parallel_for(paths.size(), [&paths, &files](std::size_t i) {
+      files[i].text = read_file(paths[i]);
+    });
+
+    // locations are handed out in file order, so the map is filled before parsing
+    program linked;
+    for (std::size_t i = 0 ; i < files.size() ; ++i)
+    {
+      if (files[i].text)
+      {
+        files[i].base = linked.sources.add(paths[i], std::move(*files[i].text));
+      }
+      else 
+      {
+        files[i].diagnostics = "could not open file\n";
+      }
+    }
+
+    pool.parallel_for(paths.size(), [&linked, &files, fast_scan](std::size_t i) {
+      if (files[i].text)
+      {
+        parse_file(linked.sources, files[i], fast_scan);
+      }
+    });
+
+    for (std::size_t i = 0 ; i < files.size() ; ++i)
+    {
+      if (!files[i].ok)
+      {
+        linked.ok = false;
+        current_error_state().has_error = true;
+        error_stream() << paths[i] << ":\n" << files[i].diagnostics;
+      }
+      for (auto& s : files[i].statements)
+      {
+        linked.statements.push_back(std::move(s));
+      }
+    }
+    return linked;
+  }
+
+} // namespace cwt
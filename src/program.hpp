@@ -0,0 +1,28 @@
+#pragma once 
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "source_map.hpp"
+#include "stmt.hpp"
+
+namespace cwt
+{
+  class thread_pool;
+
+  // several source files linked into one program. statements of all files 
+  // are kept in the order the files were given and executed in that order.
+  struct program
+  {
+    source_map sources;
+    std::vector<std::unique_ptr<lox_statement<lox_obj>>> statements;
+    bool ok = true;
+  };
+
+  // scans and parses every file on the pool into its own tree, then links them. 
+  // diagnostics are reported per file in the given order once all files are done.
+  // fast_scan selects the SIMD scanner (fast_scanner.hpp).
+  program load_program(thread_pool& pool, const std::vector<std::string>& paths, bool fast_scan = false);
+
+} // namespace cwt
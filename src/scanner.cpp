@@ -1,20 +1,30 @@
 #include "scanner.hpp"
+#include "keywords.hpp"
 
 namespace cwt
 {
 
-      scanner::scanner(const std::string& src) : m_src(src) {}
+      scanner::scanner(const std::string& src, std::size_t first_line) : m_src(src), m_first_line(first_line) {}
 
-      std::vector<token> scanner::scan_tokens()
+      token_stream scanner::scan_stream()
       {
+        m_stream = token_stream(m_src);
+        m_start = 0;
+        m_current = 0;
+        m_line = m_first_line;
         while(!is_at_end())
         {
           m_start = m_current;
           scan_token();
         }
 
-        m_tokens.push_back(token{token_type::END_OF_FILE, "", m_line});
-        return m_tokens;    
+        m_stream.push(token_type::END_OF_FILE, m_src.size(), 0, m_line);
+        return std::move(m_stream);    
+      }
+
+      std::vector<token> scanner::scan_tokens()
+      {
+        return scan_stream().to_tokens();
       }
 
       void scanner::scan_token()
@@ -26,8 +36,11 @@ namespace cwt
           break; case ')': add_token(token_type::RIGHT_PAREN);
           break; case '{': add_token(token_type::LEFT_BRACE);
           break; case '}': add_token(token_type::RIGHT_BRACE);
+          break; case '[': add_token(token_type::LEFT_BRACKET);
+          break; case ']': add_token(token_type::RIGHT_BRACKET);
           break; case ',': add_token(token_type::COMMA);
           break; case '.': add_token(token_type::DOT);
+          break; case ':': add_token(token_type::COLON);
           break; case '-': add_token(token_type::MINUS);
           break; case '+': add_token(token_type::PLUS);
           break; case '/': add_token(token_type::SLASH);
@@ -64,13 +77,7 @@ namespace cwt
       void scanner::identifier()
       {
         while (is_alpha_numeric(peek())) advance();
-        // substr works different in cpp as in java
-        std::string txt = m_src.substr(m_start, m_current-m_start);
-        if (m_keywords.count(txt)) {
-          add_token(m_keywords.at(txt));
-        } else {
-          add_token(token_type::IDENTIFIER);
-        }
+        add_token(keyword_or_identifier(std::string_view(m_src).substr(m_start, m_current-m_start)));
       }
 
       bool scanner::is_alpha_numeric(const char c)
@@ -98,8 +105,7 @@ namespace cwt
           advance();
           while (is_digit(peek())) advance();
         }
-                                                // substr works different in cpp as in java
-        add_token(token_type::NUMBER, m_src.substr(m_start, m_current-m_start));
+        add_token(token_type::NUMBER);
       }
 
       bool scanner::is_digit(const char c) 
@@ -120,9 +126,8 @@ namespace cwt
           return;
         }
         advance();
-        // substr works different in cpp as in java
-        std::string value = m_src.substr(m_start+1, (m_current-1)-(m_start+1));
-        add_token(token_type::STRING, value);
+        // the literal (without quotes) is derived from the lexeme by token_stream
+        add_token(token_type::STRING);
       }
 
       char scanner::peek() 
@@ -138,13 +143,7 @@ namespace cwt
 
       void scanner::add_token(token_type type) 
       {
-        add_token(type, "");
-      }
-      void scanner::add_token(token_type type, const std::string& literal) 
-      {
-        // substr works different in cpp as in java
-        const std::string txt = m_src.substr(m_start, m_current-m_start);
-        m_tokens.push_back(token{type, txt, m_line, literal});
+        m_stream.push(type, m_start, m_current-m_start, m_line);
       }
       char scanner::advance() 
       { 
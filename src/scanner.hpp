@@ -1,19 +1,21 @@
 #pragma once 
 
-#include <unordered_map>
 #include <string>
 #include <vector>
 
 #include "error.hpp"
 #include "token.hpp"
+#include "token_stream.hpp"
 namespace cwt
 {
 
   class scanner 
   {
     public:
-      scanner(const std::string& src);
+      // first_line numbers the lines of src when it starts further down a file
+      scanner(const std::string& src, std::size_t first_line = 1);
 
+      token_stream scan_stream();
       std::vector<token> scan_tokens();
 
     private:
@@ -37,34 +39,16 @@ namespace cwt
       bool is_at_end();
 
       void add_token(token_type type) ;
-      void add_token(token_type type, const std::string& literal) ;
       char advance() ;
 
       bool match(const char expected) ;
 
     private: 
       std::string m_src;
-      std::vector<token> m_tokens{};
+      token_stream m_stream;
       std::size_t m_start{0};
       std::size_t m_current{0};
+      std::size_t m_first_line{1};
       std::size_t m_line{1};  
-      const std::unordered_map<std::string, token_type> m_keywords {
-        {"and", token_type::AND},
-        {"class", token_type::CLASS},
-        {"else", token_type::ELSE},
-        {"false", token_type::FALSE},
-        {"for", token_type::FOR},
-        {"fun", token_type::FUN},
-        {"if", token_type::IF},
-        {"nil", token_type::NIL},
-        {"or", token_type::OR},
-        {"print", token_type::PRINT},
-        {"return", token_type::RETURN},
-        {"super", token_type::SUPER},
-        {"this", token_type::THIS},
-        {"true", token_type::TRUE},
-        {"var", token_type::VAR},
-        {"while", token_type::WHILE},
-      };
     };
 } // namespace cwt
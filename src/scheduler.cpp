@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+
+#include "scheduler.hpp"
+#include "interpreter.hpp"
+
+namespace cwt
+{
+  namespace
+  {
+    constexpr std::size_t spare_stacks = 64;
+
+    // thrown into a suspended fiber when it is cancelled. it is no
+    // std::exception, so no block of the script reports it on the way up
+    struct fiber_cancelled
+    {
+    };
+  }
+
+  struct scheduler::fiber
+  {
+    enum class state
+    {
+      ready = 0, sleeping, done
+    };
+
+    std::unique_ptr<stack_context> context;
+    std::shared_ptr<lox_callable> function;
+    std::unique_ptr<environment> env;
+    std::vector<interpreter::loop_run> loops;
+    profiler::call_stack frames;
+    state current = state::ready;
+    clock::time_point wake;
+    std::uint64_t sequence = 0;
+  };
+
+  scheduler::scheduler(interpreter& i) : m_interpreter(i)
+  {
+  }
+
+  scheduler::~scheduler()
+  {
+    cancel();
+  }
+
+  bool scheduler::supported() noexcept
+  {
+    return stack_context::supported();
+  }
+
+  std::uint64_t scheduler::spawn(std::shared_ptr<lox_callable> f)
+  {
+    auto created = std::make_unique<fiber>();
+    if (!m_spare.empty())
+    {
+      created->context = std::move(m_spare.back());
+      m_spare.pop_back();
+      created->context->reset(&scheduler::entry, this);
+    }
+    else
+    {
+      created->context = std::make_unique<stack_context>(&scheduler::entry, this);
+    }
+    created->function = std::move(f);
+    created->env = std::make_unique<environment>();
+    created->env->set_enclosing(m_interpreter.m_globals);
+    if (m_interpreter.m_profiler)
+    {
+      created->frames = m_interpreter.m_profiler->fiber_stack();
+    }
+    m_ready.push_back(std::move(created));
+    return m_next_id++;
+  }
+
+  void scheduler::yield()
+  {
+    if (m_current)
+    {
+      m_current->current = fiber::state::ready;
+      suspend();
+      return;
+    }
+    // only the fibers ready now, one that yields again waits for the next round
+    wake_due(clock::now());
+    for (std::size_t n = m_ready.size() ; n > 0 && !m_ready.empty() ; --n)
+    {
+      std::unique_ptr<fiber> next = std::move(m_ready.front());
+      m_ready.pop_front();
+      resume(std::move(next));
+    }
+  }
+
+  void scheduler::sleep(double seconds)
+  {
+    const double clamped = seconds > 0 ? std::min(seconds, 1e9) : 0.0;
+    const clock::time_point deadline = clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(clamped));
+    if (m_current)
+    {
+      m_current->current = fiber::state::sleeping;
+      m_current->wake = deadline;
+      suspend();
+      return;
+    }
+    for (;;)
+    {
+      const clock::time_point now = clock::now();
+      wake_due(now);
+      if (now >= deadline)
+      {
+        return;
+      }
+      if (!m_ready.empty())
+      {
+        std::unique_ptr<fiber> next = std::move(m_ready.front());
+        m_ready.pop_front();
+        resume(std::move(next));
+      }
+      else
+      {
+        std::this_thread::sleep_until(m_sleeping.empty() ? deadline : std::min(deadline, m_sleeping.front()->wake));
+      }
+    }
+  }
+
+  void scheduler::run()
+  {
+    while (!m_ready.empty() || !m_sleeping.empty())
+    {
+      wake_due(clock::now());
+      if (m_ready.empty())
+      {
+        std::this_thread::sleep_until(m_sleeping.front()->wake);
+        continue;
+      }
+      std::unique_ptr<fiber> next = std::move(m_ready.front());
+      m_ready.pop_front();
+      resume(std::move(next));
+    }
+  }
+
+  // every fiber is resumed once more, a suspended one unwinds from where
+  // it stopped, one that never ran ends right away
+  void scheduler::cancel()
+  {
+    m_cancelling = true;
+    while (!m_ready.empty() || !m_sleeping.empty())
+    {
+      wake_due(clock::time_point::max());
+      std::unique_ptr<fiber> next = std::move(m_ready.front());
+      m_ready.pop_front();
+      resume(std::move(next));
+    }
+    m_cancelling = false;
+  }
+
+  std::size_t scheduler::pending() const noexcept
+  {
+    return m_ready.size() + m_sleeping.size();
+  }
+
+  namespace
+  {
+    template<typename Fiber>
+    bool wakes_later(const Fiber& a, const Fiber& b)
+    {
+      return std::tie(a->wake, a->sequence) > std::tie(b->wake, b->sequence);
+    }
+  }
+
+  void scheduler::wake_due(clock::time_point now)
+  {
+    while (!m_sleeping.empty() && m_sleeping.front()->wake <= now)
+    {
+      std::pop_heap(m_sleeping.begin(), m_sleeping.end(), wakes_later<std::unique_ptr<fiber>>);
+      m_ready.push_back(std::move(m_sleeping.back()));
+      m_sleeping.pop_back();
+    }
+  }
+
+  // loops hoisted by the optimizer keep their invariants per epoch, the
+  // epoch of a loop node is the one of whoever entered it last. outer runs
+  // go first, a loop running recursively ends up with its innermost epoch
+  void scheduler::restore_epochs()
+  {
+    for (const interpreter::loop_run& run : m_interpreter.m_loops)
+    {
+      run.loop->epoch = run.epoch;
+    }
+  }
+
+  // switches from the script to f and back. f runs on the interpreter
+  // with its own environment chain until it yields, sleeps or returns.
+  void scheduler::resume(std::unique_ptr<fiber> f)
+  {
+    m_current = f.get();
+    std::unique_ptr<environment> script_env = std::move(m_interpreter.m_env);
+    m_interpreter.m_env = std::move(f->env);
+    std::vector<interpreter::loop_run> script_loops = std::move(m_interpreter.m_loops);
+    m_interpreter.m_loops = std::move(f->loops);
+    restore_epochs();
+    if (m_interpreter.m_profiler)
+    {
+      m_interpreter.m_profiler->switch_stack(f->frames);
+    }
+
+    m_main.switch_to(*f->context);
+
+    if (m_interpreter.m_profiler)
+    {
+      m_interpreter.m_profiler->switch_stack(f->frames);
+    }
+
+    f->env = std::move(m_interpreter.m_env);
+    m_interpreter.m_env = std::move(script_env);
+    f->loops = std::move(m_interpreter.m_loops);
+    m_interpreter.m_loops = std::move(script_loops);
+    restore_epochs();
+    m_current = nullptr;
+
+    switch (f->current)
+    {
+      case fiber::state::ready: m_ready.push_back(std::move(f));
+      break; case fiber::state::sleeping:
+      {
+        f->sequence = m_sequence++;
+        m_sleeping.push_back(std::move(f));
+        std::push_heap(m_sleeping.begin(), m_sleeping.end(), wakes_later<std::unique_ptr<fiber>>);
+      }
+      break; case fiber::state::done:
+      {
+        if (m_spare.size() < spare_stacks)
+        {
+          m_spare.push_back(std::move(f->context));
+        }
+      }
+    }
+    if (m_failure)
+    {
+      std::rethrow_exception(std::exchange(m_failure, nullptr));
+    }
+  }
+
+  // back from the running fiber to the script
+  void scheduler::suspend()
+  {
+    m_current->context->switch_to(m_main);
+    if (m_cancelling)
+    {
+      throw fiber_cancelled{};
+    }
+  }
+
+  void scheduler::entry(void* self)
+  {
+    auto* s = static_cast<scheduler*>(self);
+    fiber& f = *s->m_current;
+    try
+    {
+      if (!s->m_cancelling)
+      {
+        f.function->call(s->m_interpreter, {});
+      }
+    }
+    catch(const fiber_cancelled&)
+    {
+    }
+    catch(const std::exception& e)
+    {
+      report_runtime_error(e, s->m_interpreter.m_sources);
+    }
+    catch(...)
+    {
+      s->m_failure = std::current_exception();
+    }
+    f.current = fiber::state::done;
+    f.context->exit_to(s->m_main);
+  }
+
+} // namespace cwt
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <vector>
+
+#include "lox_callable.hpp"
+#include "stack_context.hpp"
+
+namespace cwt
+{
+  class interpreter;
+
+  // cooperative fibers on one os thread, stackful so a fiber can suspend
+  // anywhere in the tree walker. every fiber owns its environment chain
+  // and starts with the globals as its enclosing scope. the script itself
+  // runs on the thread's own stack and drives the event loop: fibers run
+  // while it yields or sleeps and after it finished, until none is left.
+  class scheduler
+  {
+    using clock = std::chrono::steady_clock;
+
+    public:
+      explicit scheduler(interpreter& i);
+      ~scheduler();
+      scheduler(const scheduler&) = delete;
+      scheduler& operator=(const scheduler&) = delete;
+
+      static bool supported() noexcept;
+
+      // queues f, it is called without arguments once the loop gets to it
+      std::uint64_t spawn(std::shared_ptr<lox_callable> f);
+      // lets every fiber that is ready run once before the caller continues
+      void yield();
+      void sleep(double seconds);
+      // the event loop, returns when every fiber has finished
+      void run();
+      // unwinds every fiber that has not finished, none of them runs on
+      void cancel();
+
+      std::size_t pending() const noexcept;
+
+    private:
+      struct fiber;
+
+      void wake_due(clock::time_point now);
+      void resume(std::unique_ptr<fiber> f);
+      void suspend();
+      // puts the epochs of the loops the running code is inside back on their nodes
+      void restore_epochs();
+      static void entry(void* self);
+
+    private:
+      interpreter& m_interpreter;
+      stack_context m_main;
+      fiber* m_current = nullptr;
+      std::deque<std::unique_ptr<fiber>> m_ready;
+      // a heap on the wake up time
+      std::vector<std::unique_ptr<fiber>> m_sleeping;
+      // stacks of finished fibers, for the next spawn
+      std::vector<std::unique_ptr<stack_context>> m_spare;
+      std::uint64_t m_next_id = 1;
+      // orders fibers that wake at the same time
+      std::uint64_t m_sequence = 0;
+      bool m_cancelling = false;
+      // anything but a runtime error leaves its fiber and goes on in the script
+      std::exception_ptr m_failure;
+  };
+
+} // namespace cwt
@@ -0,0 +1,464 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "simd_numeric.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define LOX_SIMD_SSE2 1
+  #include <immintrin.h>
+#endif
+
+#if LOX_SIMD_SSE2 && (defined(__GNUC__) || defined(__clang__))
+  #define LOX_SIMD_AVX2 1
+#endif
+
+namespace cwt::simd
+{
+  namespace
+  {
+    // element i of a block goes to lane i, the reductions work on whole blocks
+    constexpr std::size_t lanes = 8;
+
+    // sum leaves y alone
+    using reduce_fn = void(*)(const double* x, const double* y, std::size_t blocks, double* acc);
+    // true if it saw a NaN
+    using extremum_fn = bool(*)(const double* x, std::size_t blocks, double* acc);
+    using axpy_fn = void(*)(double a, const double* x, double* y, std::size_t n);
+    using arith_fn = void(*)(const double* x, const double* y, double* out, std::size_t n);
+    using count_fn = std::size_t(*)(const double* x, double y, std::size_t n);
+
+    struct kernel_set
+    {
+      const char* name;
+      reduce_fn sum;
+      reduce_fn dot;
+      extremum_fn min;
+      extremum_fn max;
+      axpy_fn axpy;
+      arith_fn elementwise[static_cast<std::size_t>(arith::count)];
+      // y points to a single value
+      arith_fn broadcast[static_cast<std::size_t>(arith::count)];
+      count_fn count[static_cast<std::size_t>(compare::count)];
+    };
+
+    template<arith A>
+    constexpr double apply(double x, double y)
+    {
+      if constexpr (A == arith::add) { return x + y; }
+      else if constexpr (A == arith::sub) { return x - y; }
+      else if constexpr (A == arith::mul) { return x * y; }
+      else { return x / y; }
+    }
+
+    template<compare C>
+    constexpr bool holds(double x, double y)
+    {
+      if constexpr (C == compare::less) { return x < y; }
+      else if constexpr (C == compare::less_equal) { return x <= y; }
+      else if constexpr (C == compare::greater) { return x > y; }
+      else if constexpr (C == compare::greater_equal) { return x >= y; }
+      else if constexpr (C == compare::equal) { return x == y; }
+      else { return x != y; }
+    }
+
+    // what minpd and maxpd do with v and m, NaN in v leaves m
+    template<bool max>
+    constexpr double pick(double m, double v)
+    {
+      return (max ? v > m : v < m) ? v : m;
+    }
+
+    // the vector kernels hand what does not fill a vector to these
+    template<arith A, bool broadcast>
+    void scalar_arith(const double* x, const double* y, double* out, std::size_t n)
+    {
+      for (std::size_t i = 0 ; i < n ; ++i)
+      {
+        out[i] = apply<A>(x[i], broadcast ? *y : y[i]);
+      }
+    }
+
+    template<compare C>
+    std::size_t scalar_count(const double* x, double y, std::size_t n)
+    {
+      std::size_t count = 0;
+      for (std::size_t i = 0 ; i < n ; ++i)
+      {
+        count += holds<C>(x[i], y);
+      }
+      return count;
+    }
+
+    void scalar_axpy(double a, const double* x, double* y, std::size_t n)
+    {
+      for (std::size_t i = 0 ; i < n ; ++i)
+      {
+        y[i] = y[i] + a * x[i];
+      }
+    }
+
+    template<bool dot>
+    void scalar_reduce(const double* x, const double* y, std::size_t blocks, double* acc)
+    {
+      for (std::size_t i = 0 ; i < blocks * lanes ; i += lanes)
+      {
+        for (std::size_t k = 0 ; k < lanes ; ++k)
+        {
+          if constexpr (dot) { acc[k] += x[i + k] * y[i + k]; }
+          else { acc[k] += x[i + k]; }
+        }
+      }
+    }
+
+    template<bool max>
+    bool scalar_extremum(const double* x, std::size_t blocks, double* acc)
+    {
+      bool nan = false;
+      for (std::size_t i = 0 ; i < blocks * lanes ; ++i)
+      {
+        nan |= std::isnan(x[i]);
+        acc[i % lanes] = pick<max>(acc[i % lanes], x[i]);
+      }
+      return nan;
+    }
+
+    constexpr kernel_set scalar_kernels{"scalar",
+      &scalar_reduce<false>, &scalar_reduce<true>, &scalar_extremum<false>, &scalar_extremum<true>, &scalar_axpy,
+      {&scalar_arith<arith::add, false>, &scalar_arith<arith::sub, false>, &scalar_arith<arith::mul, false>, &scalar_arith<arith::div, false>},
+      {&scalar_arith<arith::add, true>, &scalar_arith<arith::sub, true>, &scalar_arith<arith::mul, true>, &scalar_arith<arith::div, true>},
+      {&scalar_count<compare::less>, &scalar_count<compare::less_equal>, &scalar_count<compare::greater>,
+       &scalar_count<compare::greater_equal>, &scalar_count<compare::equal>, &scalar_count<compare::not_equal>}
+    };
+
+#if LOX_SIMD_SSE2
+    template<arith A>
+    inline __m128d sse2_apply(__m128d x, __m128d y)
+    {
+      if constexpr (A == arith::add) { return _mm_add_pd(x, y); }
+      else if constexpr (A == arith::sub) { return _mm_sub_pd(x, y); }
+      else if constexpr (A == arith::mul) { return _mm_mul_pd(x, y); }
+      else { return _mm_div_pd(x, y); }
+    }
+
+    template<compare C>
+    inline __m128d sse2_holds(__m128d x, __m128d y)
+    {
+      if constexpr (C == compare::less) { return _mm_cmplt_pd(x, y); }
+      else if constexpr (C == compare::less_equal) { return _mm_cmple_pd(x, y); }
+      else if constexpr (C == compare::greater) { return _mm_cmpgt_pd(x, y); }
+      else if constexpr (C == compare::greater_equal) { return _mm_cmpge_pd(x, y); }
+      else if constexpr (C == compare::equal) { return _mm_cmpeq_pd(x, y); }
+      else { return _mm_cmpneq_pd(x, y); }
+    }
+
+    template<bool dot>
+    void sse2_reduce(const double* x, const double* y, std::size_t blocks, double* acc)
+    {
+      __m128d a[lanes / 2];
+      for (std::size_t j = 0 ; j < lanes / 2 ; ++j) { a[j] = _mm_loadu_pd(acc + 2 * j); }
+      for (std::size_t i = 0 ; i < blocks * lanes ; i += lanes)
+      {
+        for (std::size_t j = 0 ; j < lanes / 2 ; ++j)
+        {
+          __m128d v = _mm_loadu_pd(x + i + 2 * j);
+          if constexpr (dot) { v = _mm_mul_pd(v, _mm_loadu_pd(y + i + 2 * j)); }
+          a[j] = _mm_add_pd(a[j], v);
+        }
+      }
+      for (std::size_t j = 0 ; j < lanes / 2 ; ++j) { _mm_storeu_pd(acc + 2 * j, a[j]); }
+    }
+
+    template<bool max>
+    bool sse2_extremum(const double* x, std::size_t blocks, double* acc)
+    {
+      __m128d a[lanes / 2];
+      __m128d nan = _mm_setzero_pd();
+      for (std::size_t j = 0 ; j < lanes / 2 ; ++j) { a[j] = _mm_loadu_pd(acc + 2 * j); }
+      for (std::size_t i = 0 ; i < blocks * lanes ; i += lanes)
+      {
+        for (std::size_t j = 0 ; j < lanes / 2 ; ++j)
+        {
+          const __m128d v = _mm_loadu_pd(x + i + 2 * j);
+          nan = _mm_or_pd(nan, _mm_cmpunord_pd(v, v));
+          a[j] = max ? _mm_max_pd(v, a[j]) : _mm_min_pd(v, a[j]);
+        }
+      }
+      for (std::size_t j = 0 ; j < lanes / 2 ; ++j) { _mm_storeu_pd(acc + 2 * j, a[j]); }
+      return _mm_movemask_pd(nan) != 0;
+    }
+
+    void sse2_axpy(double a, const double* x, double* y, std::size_t n)
+    {
+      const __m128d av = _mm_set1_pd(a);
+      std::size_t i = 0;
+      for (; i + 2 <= n ; i += 2)
+      {
+        _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), _mm_mul_pd(av, _mm_loadu_pd(x + i))));
+      }
+      scalar_axpy(a, x + i, y + i, n - i);
+    }
+
+    template<arith A, bool broadcast>
+    void sse2_arith(const double* x, const double* y, double* out, std::size_t n)
+    {
+      std::size_t i = 0;
+      for (; i + 2 <= n ; i += 2)
+      {
+        const __m128d yv = broadcast ? _mm_set1_pd(*y) : _mm_loadu_pd(y + i);
+        _mm_storeu_pd(out + i, sse2_apply<A>(_mm_loadu_pd(x + i), yv));
+      }
+      scalar_arith<A, broadcast>(x + i, broadcast ? y : y + i, out + i, n - i);
+    }
+
+    template<compare C>
+    std::size_t sse2_count(const double* x, double y, std::size_t n)
+    {
+      // a true compare is all ones, -1 in each 64 bit lane
+      const __m128d yv = _mm_set1_pd(y);
+      __m128i counts = _mm_setzero_si128();
+      std::size_t i = 0;
+      for (; i + 2 <= n ; i += 2)
+      {
+        counts = _mm_sub_epi64(counts, _mm_castpd_si128(sse2_holds<C>(_mm_loadu_pd(x + i), yv)));
+      }
+      std::uint64_t c[2];
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(c), counts);
+      return static_cast<std::size_t>(c[0] + c[1]) + scalar_count<C>(x + i, y, n - i);
+    }
+
+    constexpr kernel_set sse2_kernels{"sse2",
+      &sse2_reduce<false>, &sse2_reduce<true>, &sse2_extremum<false>, &sse2_extremum<true>, &sse2_axpy,
+      {&sse2_arith<arith::add, false>, &sse2_arith<arith::sub, false>, &sse2_arith<arith::mul, false>, &sse2_arith<arith::div, false>},
+      {&sse2_arith<arith::add, true>, &sse2_arith<arith::sub, true>, &sse2_arith<arith::mul, true>, &sse2_arith<arith::div, true>},
+      {&sse2_count<compare::less>, &sse2_count<compare::less_equal>, &sse2_count<compare::greater>,
+       &sse2_count<compare::greater_equal>, &sse2_count<compare::equal>, &sse2_count<compare::not_equal>}
+    };
+#endif
+
+#if LOX_SIMD_AVX2
+    template<arith A>
+    __attribute__((target("avx2"))) inline __m256d avx2_apply(__m256d x, __m256d y)
+    {
+      if constexpr (A == arith::add) { return _mm256_add_pd(x, y); }
+      else if constexpr (A == arith::sub) { return _mm256_sub_pd(x, y); }
+      else if constexpr (A == arith::mul) { return _mm256_mul_pd(x, y); }
+      else { return _mm256_div_pd(x, y); }
+    }
+
+    template<compare C>
+    __attribute__((target("avx2"))) inline __m256d avx2_holds(__m256d x, __m256d y)
+    {
+      if constexpr (C == compare::less) { return _mm256_cmp_pd(x, y, _CMP_LT_OQ); }
+      else if constexpr (C == compare::less_equal) { return _mm256_cmp_pd(x, y, _CMP_LE_OQ); }
+      else if constexpr (C == compare::greater) { return _mm256_cmp_pd(x, y, _CMP_GT_OQ); }
+      else if constexpr (C == compare::greater_equal) { return _mm256_cmp_pd(x, y, _CMP_GE_OQ); }
+      else if constexpr (C == compare::equal) { return _mm256_cmp_pd(x, y, _CMP_EQ_OQ); }
+      else { return _mm256_cmp_pd(x, y, _CMP_NEQ_UQ); }
+    }
+
+    template<bool dot>
+    __attribute__((target("avx2"))) void avx2_reduce(const double* x, const double* y, std::size_t blocks, double* acc)
+    {
+      __m256d lo = _mm256_loadu_pd(acc);
+      __m256d hi = _mm256_loadu_pd(acc + 4);
+      for (std::size_t i = 0 ; i < blocks * lanes ; i += lanes)
+      {
+        __m256d l = _mm256_loadu_pd(x + i);
+        __m256d h = _mm256_loadu_pd(x + i + 4);
+        if constexpr (dot)
+        {
+          l = _mm256_mul_pd(l, _mm256_loadu_pd(y + i));
+          h = _mm256_mul_pd(h, _mm256_loadu_pd(y + i + 4));
+        }
+        lo = _mm256_add_pd(lo, l);
+        hi = _mm256_add_pd(hi, h);
+      }
+      _mm256_storeu_pd(acc, lo);
+      _mm256_storeu_pd(acc + 4, hi);
+    }
+
+    template<bool max>
+    __attribute__((target("avx2"))) bool avx2_extremum(const double* x, std::size_t blocks, double* acc)
+    {
+      __m256d lo = _mm256_loadu_pd(acc);
+      __m256d hi = _mm256_loadu_pd(acc + 4);
+      __m256d nan = _mm256_setzero_pd();
+      for (std::size_t i = 0 ; i < blocks * lanes ; i += lanes)
+      {
+        const __m256d l = _mm256_loadu_pd(x + i);
+        const __m256d h = _mm256_loadu_pd(x + i + 4);
+        nan = _mm256_or_pd(nan, _mm256_cmp_pd(l, h, _CMP_UNORD_Q));
+        lo = max ? _mm256_max_pd(l, lo) : _mm256_min_pd(l, lo);
+        hi = max ? _mm256_max_pd(h, hi) : _mm256_min_pd(h, hi);
+      }
+      _mm256_storeu_pd(acc, lo);
+      _mm256_storeu_pd(acc + 4, hi);
+      return _mm256_movemask_pd(nan) != 0;
+    }
+
+    __attribute__((target("avx2"))) void avx2_axpy(double a, const double* x, double* y, std::size_t n)
+    {
+      const __m256d av = _mm256_set1_pd(a);
+      std::size_t i = 0;
+      for (; i + 4 <= n ; i += 4)
+      {
+        _mm256_storeu_pd(y + i, _mm256_add_pd(_mm256_loadu_pd(y + i), _mm256_mul_pd(av, _mm256_loadu_pd(x + i))));
+      }
+      scalar_axpy(a, x + i, y + i, n - i);
+    }
+
+    template<arith A, bool broadcast>
+    __attribute__((target("avx2"))) void avx2_arith(const double* x, const double* y, double* out, std::size_t n)
+    {
+      std::size_t i = 0;
+      for (; i + 4 <= n ; i += 4)
+      {
+        const __m256d yv = broadcast ? _mm256_set1_pd(*y) : _mm256_loadu_pd(y + i);
+        _mm256_storeu_pd(out + i, avx2_apply<A>(_mm256_loadu_pd(x + i), yv));
+      }
+      scalar_arith<A, broadcast>(x + i, broadcast ? y : y + i, out + i, n - i);
+    }
+
+    template<compare C>
+    __attribute__((target("avx2"))) std::size_t avx2_count(const double* x, double y, std::size_t n)
+    {
+      const __m256d yv = _mm256_set1_pd(y);
+      __m256i counts = _mm256_setzero_si256();
+      std::size_t i = 0;
+      for (; i + 4 <= n ; i += 4)
+      {
+        counts = _mm256_sub_epi64(counts, _mm256_castpd_si256(avx2_holds<C>(_mm256_loadu_pd(x + i), yv)));
+      }
+      std::uint64_t c[4];
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(c), counts);
+      return static_cast<std::size_t>(c[0] + c[1] + c[2] + c[3]) + scalar_count<C>(x + i, y, n - i);
+    }
+
+    constexpr kernel_set avx2_kernels{"avx2",
+      &avx2_reduce<false>, &avx2_reduce<true>, &avx2_extremum<false>, &avx2_extremum<true>, &avx2_axpy,
+      {&avx2_arith<arith::add, false>, &avx2_arith<arith::sub, false>, &avx2_arith<arith::mul, false>, &avx2_arith<arith::div, false>},
+      {&avx2_arith<arith::add, true>, &avx2_arith<arith::sub, true>, &avx2_arith<arith::mul, true>, &avx2_arith<arith::div, true>},
+      {&avx2_count<compare::less>, &avx2_count<compare::less_equal>, &avx2_count<compare::greater>,
+       &avx2_count<compare::greater_equal>, &avx2_count<compare::equal>, &avx2_count<compare::not_equal>}
+    };
+#endif
+
+    const kernel_set& select_kernels()
+    {
+#if LOX_SIMD_AVX2
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2")) { return avx2_kernels; }
+#endif
+#if LOX_SIMD_SSE2
+      return sse2_kernels;
+#else
+      return scalar_kernels;
+#endif
+    }
+
+    const kernel_set& kernels()
+    {
+      static const kernel_set& k = select_kernels();
+      return k;
+    }
+
+    // halves the lanes until one is left, the same order on every kernel set
+    template<typename F>
+    double fold(double* acc, F f)
+    {
+      for (std::size_t half = lanes / 2 ; half > 0 ; half /= 2)
+      {
+        for (std::size_t k = 0 ; k < half ; ++k)
+        {
+          acc[k] = f(acc[k], acc[k + half]);
+        }
+      }
+      return acc[0];
+    }
+
+    template<bool max>
+    double extremum(std::span<const double> x)
+    {
+      const std::size_t blocks = x.size() / lanes;
+      double result = x.front();
+      bool nan = false;
+      if (blocks)
+      {
+        double acc[lanes];
+        std::copy_n(x.data(), lanes, acc);
+        const kernel_set& k = kernels();
+        nan = (max ? k.max : k.min)(x.data(), blocks, acc);
+        result = fold(acc, &pick<max>);
+      }
+      for (std::size_t i = blocks * lanes ; i < x.size() ; ++i)
+      {
+        nan |= std::isnan(x[i]);
+        result = pick<max>(result, x[i]);
+      }
+      return nan ? std::numeric_limits<double>::quiet_NaN() : result;
+    }
+
+    template<bool dot>
+    double reduce(std::span<const double> x, const double* y)
+    {
+      const std::size_t blocks = x.size() / lanes;
+      double acc[lanes] = {};
+      const kernel_set& k = kernels();
+      (dot ? k.dot : k.sum)(x.data(), y, blocks, acc);
+      double result = fold(acc, [](double l, double r) { return l + r; });
+      for (std::size_t i = blocks * lanes ; i < x.size() ; ++i)
+      {
+        result += dot ? x[i] * y[i] : x[i];
+      }
+      return result;
+    }
+  } // namespace
+
+  double sum(std::span<const double> x)
+  {
+    return reduce<false>(x, nullptr);
+  }
+
+  double dot(std::span<const double> x, std::span<const double> y)
+  {
+    return reduce<true>(x, y.data());
+  }
+
+  double min(std::span<const double> x)
+  {
+    return extremum<false>(x);
+  }
+
+  double max(std::span<const double> x)
+  {
+    return extremum<true>(x);
+  }
+
+  void axpy(double a, std::span<const double> x, std::span<double> y)
+  {
+    kernels().axpy(a, x.data(), y.data(), x.size());
+  }
+
+  void elementwise(arith op, std::span<const double> x, std::span<const double> y, std::span<double> out)
+  {
+    kernels().elementwise[static_cast<std::size_t>(op)](x.data(), y.data(), out.data(), x.size());
+  }
+
+  void elementwise(arith op, std::span<const double> x, double y, std::span<double> out)
+  {
+    kernels().broadcast[static_cast<std::size_t>(op)](x.data(), &y, out.data(), x.size());
+  }
+
+  std::size_t count_if(compare op, std::span<const double> x, double y)
+  {
+    return kernels().count[static_cast<std::size_t>(op)](x.data(), y, x.size());
+  }
+
+  const char* numeric_kernel_name()
+  {
+    return kernels().name;
+  }
+
+} // namespace cwt::simd
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+namespace cwt::simd
+{
+  // bulk arithmetic on arrays of doubles for the array builtins. the kernels
+  // use AVX2 or SSE2 when the cpu has them and plain loops otherwise. sums,
+  // dot products, min and max fold eight interleaved lanes in the same order
+  // on every kernel set, so the result does not depend on the cpu. it can
+  // differ in the last bits from adding up the elements one after another.
+
+  enum class arith { add, sub, mul, div, count };
+  enum class compare { less, less_equal, greater, greater_equal, equal, not_equal, count };
+
+  double sum(std::span<const double> x);
+  // x and y have the same size
+  double dot(std::span<const double> x, std::span<const double> y);
+  // x is not empty. NaN if any element is NaN
+  double min(std::span<const double> x);
+  double max(std::span<const double> x);
+
+  // y[i] += a * x[i], x and y have the same size
+  void axpy(double a, std::span<const double> x, std::span<double> y);
+  // out[i] = x[i] op y[i], all three have the same size
+  void elementwise(arith op, std::span<const double> x, std::span<const double> y, std::span<double> out);
+  // out[i] = x[i] op y
+  void elementwise(arith op, std::span<const double> x, double y, std::span<double> out);
+  // how many x[i] op y hold
+  std::size_t count_if(compare op, std::span<const double> x, double y);
+
+  // name of the kernel set picked at runtime: "avx2", "sse2" or "scalar"
+  const char* numeric_kernel_name();
+
+} // namespace cwt::simd
@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <string_view>
+
+#include "simd_scan.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define LOX_SIMD_SSE2 1
+  #include <immintrin.h>
+#endif
+
+#if LOX_SIMD_SSE2 && (defined(__GNUC__) || defined(__clang__))
+  #define LOX_SIMD_AVX2 1
+#endif
+
+namespace cwt::simd
+{
+  namespace 
+  {
+    enum class char_class { whitespace = 0, newline, identifier, digit, quote, count };
+
+    constexpr bool is_digit(char c) { return c >= '0' && c <= '9'; }
+    constexpr bool is_ident(char c) 
+    { 
+      return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || is_digit(c); 
+    }
+    constexpr bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+    template<char_class C>
+    constexpr bool in_class(char c)
+    {
+      if constexpr (C == char_class::whitespace) { return is_space(c); }
+      else if constexpr (C == char_class::newline) { return c == '\n'; }
+      else if constexpr (C == char_class::identifier) { return is_ident(c); }
+      else if constexpr (C == char_class::digit) { return is_digit(c); }
+      else { return c == '\"'; }
+    }
+
+    // bit i of the mask is set if byte i of the block belongs to the class
+    using mask_fn = std::uint32_t(*)(const char*);
+
+    struct kernel_set
+    {
+      const char* name;
+      std::size_t width;
+      mask_fn mask[static_cast<std::size_t>(char_class::count)];
+    };
+
+#if LOX_SIMD_SSE2
+    inline __m128i sse2_in_range(__m128i v, char lo, char hi)
+    {
+      const __m128i below = _mm_cmplt_epi8(v, _mm_set1_epi8(lo));
+      const __m128i above = _mm_cmpgt_epi8(v, _mm_set1_epi8(hi));
+      return _mm_andnot_si128(_mm_or_si128(below, above), _mm_set1_epi8(-1));
+    }
+
+    template<char_class C>
+    std::uint32_t sse2_mask(const char* p)
+    {
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      __m128i m;
+      if constexpr (C == char_class::whitespace)
+      {
+        m = _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+          _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+      }
+      else if constexpr (C == char_class::newline) { m = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')); }
+      else if constexpr (C == char_class::quote) { m = _mm_cmpeq_epi8(v, _mm_set1_epi8('\"')); }
+      else if constexpr (C == char_class::digit) { m = sse2_in_range(v, '0', '9'); }
+      else 
+      {
+        // setting bit 5 folds upper case onto lower case, digits and '_' are checked separately
+        const __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        m = _mm_or_si128(
+          _mm_or_si128(sse2_in_range(lower, 'a', 'z'), sse2_in_range(v, '0', '9')),
+          _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+      }
+      return static_cast<std::uint32_t>(_mm_movemask_epi8(m));
+    }
+
+    constexpr kernel_set sse2_kernels{"sse2", 16, {
+      &sse2_mask<char_class::whitespace>, &sse2_mask<char_class::newline>,
+      &sse2_mask<char_class::identifier>, &sse2_mask<char_class::digit>, &sse2_mask<char_class::quote>
+    }};
+#endif
+
+#if LOX_SIMD_AVX2
+    __attribute__((target("avx2"))) inline __m256i avx2_in_range(__m256i v, char lo, char hi)
+    {
+      const __m256i below = _mm256_cmpgt_epi8(_mm256_set1_epi8(lo), v);
+      const __m256i above = _mm256_cmpgt_epi8(v, _mm256_set1_epi8(hi));
+      return _mm256_andnot_si256(_mm256_or_si256(below, above), _mm256_set1_epi8(-1));
+    }
+
+    template<char_class C>
+    __attribute__((target("avx2"))) std::uint32_t avx2_mask(const char* p)
+    {
+      const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+      __m256i m;
+      if constexpr (C == char_class::whitespace)
+      {
+        m = _mm256_or_si256(
+          _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+          _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))));
+      }
+      else if constexpr (C == char_class::newline) { m = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')); }
+      else if constexpr (C == char_class::quote) { m = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\"')); }
+      else if constexpr (C == char_class::digit) { m = avx2_in_range(v, '0', '9'); }
+      else 
+      {
+        const __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        m = _mm256_or_si256(
+          _mm256_or_si256(avx2_in_range(lower, 'a', 'z'), avx2_in_range(v, '0', '9')),
+          _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+      }
+      return static_cast<std::uint32_t>(_mm256_movemask_epi8(m));
+    }
+
+    constexpr kernel_set avx2_kernels{"avx2", 32, {
+      &avx2_mask<char_class::whitespace>, &avx2_mask<char_class::newline>,
+      &avx2_mask<char_class::identifier>, &avx2_mask<char_class::digit>, &avx2_mask<char_class::quote>
+    }};
+#endif
+
+    constexpr kernel_set scalar_kernels{"scalar", 0, {}};
+
+    const kernel_set& select_kernels()
+    {
+#if LOX_SIMD_AVX2
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2")) { return avx2_kernels; }
+#endif
+#if LOX_SIMD_SSE2
+      return sse2_kernels;
+#else
+      return scalar_kernels;
+#endif
+    }
+
+    const kernel_set*& active_kernels()
+    {
+      static const kernel_set* k = &select_kernels();
+      return k;
+    }
+
+    const kernel_set& kernels()
+    {
+      return *active_kernels();
+    }
+
+    std::uint32_t full_mask(std::size_t width)
+    {
+      return width == 32 ? 0xFFFFFFFFu : ((1u << width) - 1u);
+    }
+
+    // first index in [from, to) whose membership in C differs from `member`
+    // most runs in source code are short, so the first bytes are checked 
+    // one at a time before paying for a kernel call
+    constexpr std::size_t scalar_prefix = 8;
+
+    template<char_class C, bool member>
+    std::size_t find_boundary(const char* s, std::size_t from, std::size_t to)
+    {
+      const std::size_t prefix_end = std::min(to, from + scalar_prefix);
+      while (from < prefix_end)
+      {
+        if (in_class<C>(s[from]) != member) 
+        {
+          return from;
+        }
+        ++from;
+      }
+
+      const kernel_set& k = kernels();
+      if (k.width)
+      {
+        const mask_fn mask = k.mask[static_cast<std::size_t>(C)];
+        const std::uint32_t full = full_mask(k.width);
+        while (from + k.width <= to)
+        {
+          std::uint32_t m = mask(s + from);
+          if constexpr (member) { m = ~m & full; }
+          if (m) 
+          {
+            return from + std::countr_zero(m);
+          }
+          from += k.width;
+        }
+      }
+      while (from < to && in_class<C>(s[from]) == member) 
+      {
+        ++from;
+      }
+      return from;
+    }
+  } // namespace 
+
+  std::size_t skip_whitespace(const char* s, std::size_t from, std::size_t to, std::size_t& newlines)
+  {
+    const std::size_t end = find_boundary<char_class::whitespace, true>(s, from, to);
+    newlines += count_newlines(s, from, end);
+    return end;
+  }
+
+  std::size_t skip_identifier(const char* s, std::size_t from, std::size_t to)
+  {
+    return find_boundary<char_class::identifier, true>(s, from, to);
+  }
+
+  std::size_t skip_digits(const char* s, std::size_t from, std::size_t to)
+  {
+    return find_boundary<char_class::digit, true>(s, from, to);
+  }
+
+  std::size_t find_newline(const char* s, std::size_t from, std::size_t to)
+  {
+    return find_boundary<char_class::newline, false>(s, from, to);
+  }
+
+  std::size_t find_quote(const char* s, std::size_t from, std::size_t to)
+  {
+    return find_boundary<char_class::quote, false>(s, from, to);
+  }
+
+  std::size_t count_newlines(const char* s, std::size_t from, std::size_t to)
+  {
+    std::size_t count = 0;
+    const kernel_set& k = kernels();
+    if (k.width && to - from >= k.width)
+    {
+      const mask_fn mask = k.mask[static_cast<std::size_t>(char_class::newline)];
+      for (; from + k.width <= to ; from += k.width)
+      {
+        count += std::popcount(mask(s + from));
+      }
+    }
+    for (; from < to ; ++from)
+    {
+      count += s[from] == '\n';
+    }
+    return count;
+  }
+
+  const char* kernel_name()
+  {
+    return kernels().name;
+  }
+
+  bool use_kernels(std::string_view name)
+  {
+#if LOX_SIMD_AVX2
+    __builtin_cpu_init();
+#endif
+    const kernel_set* candidates[] = {
+#if LOX_SIMD_AVX2
+      __builtin_cpu_supports("avx2") ? &avx2_kernels : nullptr,
+#endif
+#if LOX_SIMD_SSE2
+      &sse2_kernels,
+#endif
+      &scalar_kernels
+    };
+    for (const kernel_set* k : candidates)
+    {
+      if (k && name == k->name)
+      {
+        active_kernels() = k;
+        return true;
+      }
+    }
+    return false;
+  }
+
+} // namespace cwt::simd
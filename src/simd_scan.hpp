@@ -0,0 +1,31 @@
+#pragma once 
+
+#include <cstddef>
+#include <string_view>
+
+namespace cwt::simd
+{
+  // bulk character classification for the fast scanner. every function looks 
+  // at [from, to) and returns an index in that range, or `to` if the run does not end.
+  // the kernels use AVX2 or SSE2 when the cpu has them and plain loops otherwise.
+
+  // skips ' ', '\t', '\r' and '\n', counting the newlines it passes
+  std::size_t skip_whitespace(const char* s, std::size_t from, std::size_t to, std::size_t& newlines);
+  // skips [a-zA-Z0-9_]
+  std::size_t skip_identifier(const char* s, std::size_t from, std::size_t to);
+  // skips [0-9]
+  std::size_t skip_digits(const char* s, std::size_t from, std::size_t to);
+  // first '\n' 
+  std::size_t find_newline(const char* s, std::size_t from, std::size_t to);
+  // first '"'
+  std::size_t find_quote(const char* s, std::size_t from, std::size_t to);
+  std::size_t count_newlines(const char* s, std::size_t from, std::size_t to);
+
+  // name of the kernel set picked at runtime: "avx2", "sse2" or "scalar"
+  const char* kernel_name();
+  // switches to the kernel set of that name, for tests that compare them.
+  // false if the build or the cpu does not have it. not thread safe, call
+  // it while nothing is being scanned
+  bool use_kernels(std::string_view name);
+
+} // namespace cwt::simd
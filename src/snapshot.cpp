@@ -0,0 +1,632 @@
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "snapshot.hpp"
+#include "interpreter.hpp"
+#include "lox_function.hpp"
+#include "lox_native.hpp"
+
+namespace cwt
+{
+  namespace
+  {
+    using expr_t = std::unique_ptr<lox_expression<lox_obj>>;
+    using stmt_t = std::unique_ptr<lox_statement<lox_obj>>;
+
+    constexpr char magic[8] = {'L', 'O', 'X', 'S', 'N', 'A', 'P', '3'};
+    // no expression where one is optional: a var without initializer, a bare return
+    constexpr std::uint8_t no_expr = 0xFF;
+
+    enum class value_tag : std::uint8_t
+    {
+      nil = 0, number, boolean, string, function, native
+    };
+
+    [[noreturn]] void unsupported(const std::string& what)
+    {
+      throw std::runtime_error("snapshot: " + what + " cannot be saved.");
+    }
+
+    // little endian, sizes and counts as 32 bit
+    class writer
+    {
+      public:
+        void u8(std::uint8_t v) { m_out.push_back(static_cast<char>(v)); }
+        void u32(std::uint32_t v)
+        {
+          for (int i = 0 ; i < 4 ; ++i)
+          {
+            u8(static_cast<std::uint8_t>(v >> (8 * i)));
+          }
+        }
+        void f64(double v)
+        {
+          std::uint64_t bits;
+          std::memcpy(&bits, &v, sizeof(bits));
+          u32(static_cast<std::uint32_t>(bits));
+          u32(static_cast<std::uint32_t>(bits >> 32));
+        }
+        void str(std::string_view s)
+        {
+          u32(static_cast<std::uint32_t>(s.size()));
+          m_out.append(s);
+        }
+
+        void value(const lox_obj& v)
+        {
+          switch (v.type())
+          {
+            case value_type::number:
+            {
+              u8(static_cast<std::uint8_t>(value_tag::number));
+              f64(v.number());
+            }
+            break; case value_type::boolean:
+            {
+              u8(static_cast<std::uint8_t>(value_tag::boolean));
+              u8(v.boolean());
+            }
+            break; case value_type::string:
+            {
+              u8(static_cast<std::uint8_t>(value_tag::string));
+              str(v.string());
+            }
+            break; case value_type::callable:
+            {
+              std::shared_ptr<lox_callable> c = v.callable();
+              if (auto* f = dynamic_cast<lox_function*>(c.get()))
+              {
+                u8(static_cast<std::uint8_t>(value_tag::function));
+                u32(function(*f->declaration()));
+              }
+              else if (auto* n = dynamic_cast<lox_native*>(c.get()))
+              {
+                u8(static_cast<std::uint8_t>(value_tag::native));
+                str(n->name());
+              }
+              else
+              {
+                unsupported(c->to_string());
+              }
+            }
+            break; case value_type::array: unsupported("an array");
+            break; case value_type::map: unsupported("a map");
+            break; default: u8(static_cast<std::uint8_t>(value_tag::nil));
+          }
+        }
+
+        // every declaration is written once, values refer to it by index
+        std::uint32_t function(const stmt_function<lox_obj>& f)
+        {
+          auto [it, inserted] = m_function_index.try_emplace(&f, static_cast<std::uint32_t>(m_functions.size()));
+          if (inserted)
+          {
+            m_functions.push_back(&f);
+          }
+          return it->second;
+        }
+
+        void statement(const lox_statement<lox_obj>& s)
+        {
+          u8(static_cast<std::uint8_t>(s.type()));
+          u32(s.loc.offset);
+          switch (s.type())
+          {
+            case stmt_type::_block: statements(static_cast<const stmt_block<lox_obj>&>(s).statements);
+            break; case stmt_type::_expression: expression(static_cast<const stmt_expression<lox_obj>&>(s).expression);
+            break; case stmt_type::_print: expression(static_cast<const stmt_print<lox_obj>&>(s).expression);
+            break; case stmt_type::_function: function_body(static_cast<const stmt_function<lox_obj>&>(s));
+            break; case stmt_type::_if:
+            {
+              const auto& i = static_cast<const stmt_if<lox_obj>&>(s);
+              expression(i.condition);
+              statements(i.then_branch);
+              statements(i.else_branch);
+            }
+            break; case stmt_type::_return: expression(static_cast<const stmt_return<lox_obj>&>(s).value);
+            break; case stmt_type::_var:
+            {
+              const auto& v = static_cast<const stmt_var<lox_obj>&>(s);
+              str(v.name);
+              expression(v.initializer);
+            }
+            break; case stmt_type::_while:
+            {
+              const auto& w = static_cast<const stmt_while<lox_obj>&>(s);
+              expression(w.condition);
+              statements(w.body);
+            }
+            break; default: unsupported("a class");
+          }
+        }
+
+        void function_body(const stmt_function<lox_obj>& f)
+        {
+          str(f.name);
+          u32(static_cast<std::uint32_t>(f.parameters.size()));
+          for (const auto& p : f.parameters)
+          {
+            str(p);
+          }
+          statements(f.body);
+        }
+
+        void statements(const std::vector<stmt_t>& list)
+        {
+          u32(static_cast<std::uint32_t>(list.size()));
+          for (const auto& s : list)
+          {
+            statement(*s);
+          }
+        }
+
+        // memo nodes of the optimizer are left out, a loaded tree can be
+        // optimized again
+        void expression(const expr_t& e)
+        {
+          if (!e)
+          {
+            u8(no_expr);
+            return;
+          }
+          if (e->type() == expr_type::_cached)
+          {
+            expression(static_cast<const expr_cached<lox_obj>&>(*e).expr);
+            return;
+          }
+          u8(static_cast<std::uint8_t>(e->type()));
+          u32(e->loc.offset);
+          switch (e->type())
+          {
+            case expr_type::_assign:
+            {
+              const auto& a = static_cast<const expr_assign<lox_obj>&>(*e);
+              str(a.name);
+              expression(a.value);
+            }
+            break; case expr_type::_binary:
+            {
+              const auto& b = static_cast<const expr_binary<lox_obj>&>(*e);
+              expression(b.left);
+              u8(static_cast<std::uint8_t>(b.op));
+              expression(b.right);
+            }
+            break; case expr_type::_call:
+            {
+              const auto& c = static_cast<const expr_call<lox_obj>&>(*e);
+              expression(c.callee);
+              u32(static_cast<std::uint32_t>(c.args.size()));
+              for (const auto& a : c.args)
+              {
+                expression(a);
+              }
+            }
+            break; case expr_type::_grouping: expression(static_cast<const expr_grouping<lox_obj>&>(*e).expr);
+            break; case expr_type::_literal: value(static_cast<const expr_literal<lox_obj>&>(*e).value);
+            break; case expr_type::_logical:
+            {
+              const auto& l = static_cast<const expr_logical<lox_obj>&>(*e);
+              expression(l.left);
+              u8(static_cast<std::uint8_t>(l.op));
+              expression(l.right);
+            }
+            break; case expr_type::_unary:
+            {
+              const auto& u = static_cast<const expr_unary<lox_obj>&>(*e);
+              u8(static_cast<std::uint8_t>(u.op));
+              expression(u.right);
+            }
+            break; case expr_type::_variable: str(static_cast<const expr_variable<lox_obj>&>(*e).name);
+            break; case expr_type::_array:
+            {
+              const auto& a = static_cast<const expr_array<lox_obj>&>(*e);
+              u32(static_cast<std::uint32_t>(a.elements.size()));
+              for (const auto& element : a.elements)
+              {
+                expression(element);
+              }
+            }
+            break; case expr_type::_index:
+            {
+              const auto& i = static_cast<const expr_index<lox_obj>&>(*e);
+              expression(i.obj);
+              expression(i.index);
+            }
+            break; case expr_type::_index_set:
+            {
+              const auto& i = static_cast<const expr_index_set<lox_obj>&>(*e);
+              expression(i.obj);
+              expression(i.index);
+              expression(i.value);
+            }
+            break; case expr_type::_map:
+            {
+              const auto& m = static_cast<const expr_map<lox_obj>&>(*e);
+              u32(static_cast<std::uint32_t>(m.keys.size()));
+              for (std::size_t i = 0 ; i < m.keys.size() ; ++i)
+              {
+                expression(m.keys[i]);
+                expression(m.values[i]);
+              }
+            }
+            break; default: unsupported("a class expression");
+          }
+        }
+
+        // functions found while writing values and trees are appended, the
+        // loop picks them up as well
+        void functions()
+        {
+          std::string globals = std::move(m_out);
+          m_out.clear();
+          for (std::size_t i = 0 ; i < m_functions.size() ; ++i)
+          {
+            u32(m_functions[i]->loc.offset);
+            function_body(*m_functions[i]);
+          }
+          std::string bodies = std::move(m_out);
+          m_out.clear();
+          u32(static_cast<std::uint32_t>(m_functions.size()));
+          m_out.append(bodies);
+          m_out.append(globals);
+        }
+
+        std::string& out() { return m_out; }
+
+      private:
+        std::string m_out;
+        std::vector<const stmt_function<lox_obj>*> m_functions;
+        std::unordered_map<const stmt_function<lox_obj>*, std::uint32_t> m_function_index;
+    };
+
+    class reader
+    {
+      public:
+        struct file
+        {
+          std::uint32_t old_base;
+          std::uint32_t size;
+          std::uint32_t new_base;
+        };
+
+        reader(std::string_view in, std::vector<file>& files) : m_in(in), m_files(files) {}
+
+        std::uint8_t u8()
+        {
+          need(1);
+          return static_cast<std::uint8_t>(m_in[m_pos++]);
+        }
+        std::uint32_t u32()
+        {
+          std::uint32_t v = 0;
+          for (int i = 0 ; i < 4 ; ++i)
+          {
+            v |= static_cast<std::uint32_t>(u8()) << (8 * i);
+          }
+          return v;
+        }
+        double f64()
+        {
+          const std::uint64_t low = u32();
+          const std::uint64_t bits = low | (static_cast<std::uint64_t>(u32()) << 32);
+          double v;
+          std::memcpy(&v, &bits, sizeof(v));
+          return v;
+        }
+        std::string str()
+        {
+          const std::uint32_t size = u32();
+          need(size);
+          std::string s(m_in.substr(m_pos, size));
+          m_pos += size;
+          return s;
+        }
+        bool at_end() const { return m_pos == m_in.size(); }
+        // a number of elements that take at least min_size bytes each, checked
+        // against what is left before anything is allocated for them
+        std::uint32_t count(std::size_t min_size)
+        {
+          const std::uint32_t n = u32();
+          if ((m_in.size() - m_pos) / min_size < n)
+          {
+            corrupt();
+          }
+          return n;
+        }
+
+        // where a location of the image lands in the source map it is loaded into
+        source_loc loc()
+        {
+          const std::uint32_t offset = u32();
+          if (offset == 0)
+          {
+            return source_loc{};
+          }
+          for (const file& f : m_files)
+          {
+            if (offset >= f.old_base && offset - f.old_base <= f.size)
+            {
+              return source_loc{offset - f.old_base + f.new_base};
+            }
+          }
+          corrupt();
+        }
+
+        lox_obj literal(value_tag tag)
+        {
+          switch (tag)
+          {
+            case value_tag::nil: return lox_obj();
+            break; case value_tag::number: return lox_obj(f64());
+            break; case value_tag::boolean: return lox_obj(u8() != 0);
+            break; case value_tag::string: return lox_obj(str());
+            break; default: corrupt();
+          }
+        }
+
+        std::unique_ptr<stmt_function<lox_obj>> function(source_loc loc)
+        {
+          std::string name = str();
+          std::vector<std::string> parameters(count(4));
+          for (auto& p : parameters)
+          {
+            p = str();
+          }
+          return std::make_unique<stmt_function<lox_obj>>(std::move(name), std::move(parameters), statements(), loc);
+        }
+
+        std::vector<stmt_t> statements()
+        {
+          std::vector<stmt_t> list(count(5));
+          for (auto& s : list)
+          {
+            s = statement();
+          }
+          return list;
+        }
+
+        stmt_t statement()
+        {
+          const auto kind = static_cast<stmt_type>(u8());
+          const source_loc at = loc();
+          switch (kind)
+          {
+            case stmt_type::_block: return std::make_unique<stmt_block<lox_obj>>(statements(), at);
+            break; case stmt_type::_expression: return std::make_unique<stmt_expression<lox_obj>>(expression(), at);
+            break; case stmt_type::_print: return std::make_unique<stmt_print<lox_obj>>(expression(), at);
+            break; case stmt_type::_function: return function(at);
+            break; case stmt_type::_if:
+            {
+              expr_t condition = expression();
+              std::vector<stmt_t> then_branch = statements();
+              return std::make_unique<stmt_if<lox_obj>>(std::move(condition), std::move(then_branch), statements(), at);
+            }
+            break; case stmt_type::_return: return std::make_unique<stmt_return<lox_obj>>(expression(), at);
+            break; case stmt_type::_var:
+            {
+              std::string name = str();
+              return std::make_unique<stmt_var<lox_obj>>(std::move(name), expression(), at);
+            }
+            break; case stmt_type::_while:
+            {
+              expr_t condition = expression();
+              return std::make_unique<stmt_while<lox_obj>>(std::move(condition), statements(), at);
+            }
+            break; default: corrupt();
+          }
+        }
+
+        expr_t expression()
+        {
+          const std::uint8_t kind = u8();
+          if (kind == no_expr)
+          {
+            return nullptr;
+          }
+          const source_loc at = loc();
+          switch (static_cast<expr_type>(kind))
+          {
+            case expr_type::_assign:
+            {
+              std::string name = str();
+              return std::make_unique<expr_assign<lox_obj>>(std::move(name), expression(), at);
+            }
+            break; case expr_type::_binary:
+            {
+              expr_t left = expression();
+              const auto op = static_cast<token_type>(u8());
+              return std::make_unique<expr_binary<lox_obj>>(std::move(left), op, expression(), at);
+            }
+            break; case expr_type::_call:
+            {
+              expr_t callee = expression();
+              std::vector<expr_t> args(count(1));
+              for (auto& a : args)
+              {
+                a = expression();
+              }
+              return std::make_unique<expr_call<lox_obj>>(std::move(callee), std::move(args), at);
+            }
+            break; case expr_type::_grouping: return std::make_unique<expr_grouping<lox_obj>>(expression(), at);
+            break; case expr_type::_literal:
+            {
+              auto l = std::make_unique<expr_literal<lox_obj>>(at);
+              l->value = literal(static_cast<value_tag>(u8()));
+              return l;
+            }
+            break; case expr_type::_logical:
+            {
+              expr_t left = expression();
+              const auto op = static_cast<token_type>(u8());
+              return std::make_unique<expr_logical<lox_obj>>(std::move(left), op, expression(), at);
+            }
+            break; case expr_type::_unary:
+            {
+              const auto op = static_cast<token_type>(u8());
+              return std::make_unique<expr_unary<lox_obj>>(op, expression(), at);
+            }
+            break; case expr_type::_variable: return std::make_unique<expr_variable<lox_obj>>(str(), at);
+            break; case expr_type::_array:
+            {
+              std::vector<expr_t> elements(count(1));
+              for (auto& element : elements)
+              {
+                element = expression();
+              }
+              return std::make_unique<expr_array<lox_obj>>(std::move(elements), at);
+            }
+            break; case expr_type::_index:
+            {
+              expr_t obj = expression();
+              return std::make_unique<expr_index<lox_obj>>(std::move(obj), expression(), at);
+            }
+            break; case expr_type::_index_set:
+            {
+              expr_t obj = expression();
+              expr_t index = expression();
+              return std::make_unique<expr_index_set<lox_obj>>(std::move(obj), std::move(index), expression(), at);
+            }
+            break; case expr_type::_map:
+            {
+              const std::uint32_t pairs = count(2);
+              std::vector<expr_t> keys;
+              std::vector<expr_t> values;
+              for (std::uint32_t i = 0 ; i < pairs ; ++i)
+              {
+                keys.push_back(expression());
+                values.push_back(expression());
+              }
+              return std::make_unique<expr_map<lox_obj>>(std::move(keys), std::move(values), at);
+            }
+            break; default: corrupt();
+          }
+        }
+
+        [[noreturn]] void corrupt() const
+        {
+          throw std::runtime_error("snapshot: the image is corrupt.");
+        }
+
+      private:
+        void need(std::size_t n) const
+        {
+          if (m_in.size() - m_pos < n)
+          {
+            corrupt();
+          }
+        }
+
+      private:
+        std::string_view m_in;
+        std::size_t m_pos = 0;
+        std::vector<file>& m_files;
+    };
+  }
+
+  // layout: magic, the files, the function trees, then name and value of
+  // every global
+  void save_snapshot(interpreter& i, const source_map& sources, std::ostream& out)
+  {
+    std::vector<std::pair<std::string, const lox_obj*>> globals;
+    i.get_globals_ptr()->for_each([&globals](const std::string& name, const lox_obj& value) {
+      globals.emplace_back(name, &value);
+    });
+    std::sort(globals.begin(), globals.end());
+
+    writer w;
+    w.u32(static_cast<std::uint32_t>(globals.size()));
+    for (const auto& [name, value] : globals)
+    {
+      w.str(name);
+      w.value(*value);
+    }
+    w.functions();
+
+    std::string header(magic, sizeof(magic));
+    writer files;
+    const auto list = sources.files();
+    files.u32(static_cast<std::uint32_t>(list.size()));
+    // files get consecutive ranges in the order they were added, one past the end each
+    std::uint32_t base = 1;
+    for (const auto& [name, text] : list)
+    {
+      files.u32(base);
+      files.str(name);
+      files.str(text);
+      base += static_cast<std::uint32_t>(text.size()) + 1;
+    }
+    out.write(header.data(), static_cast<std::streamsize>(header.size()));
+    out.write(files.out().data(), static_cast<std::streamsize>(files.out().size()));
+    out.write(w.out().data(), static_cast<std::streamsize>(w.out().size()));
+  }
+
+  snapshot load_snapshot(interpreter& i, source_map& sources, std::istream& in)
+  {
+    const std::string image{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    if (image.size() < sizeof(magic) || image.compare(0, sizeof(magic), magic, sizeof(magic)) != 0)
+    {
+      throw std::runtime_error("snapshot: not a snapshot image.");
+    }
+
+    std::vector<reader::file> files;
+    reader r(std::string_view(image).substr(sizeof(magic)), files);
+    // base, name and text
+    files.resize(r.count(12));
+    for (auto& f : files)
+    {
+      f.old_base = r.u32();
+      std::string name = r.str();
+      std::string text = r.str();
+      f.size = static_cast<std::uint32_t>(text.size());
+      f.new_base = sources.add(std::move(name), std::move(text)).offset;
+    }
+
+    snapshot loaded;
+    // location, name, parameter and statement counts
+    loaded.functions.resize(r.count(16));
+    for (auto& f : loaded.functions)
+    {
+      f = r.function(r.loc());
+    }
+
+    environment* globals = i.get_globals_ptr();
+    const std::uint32_t count = r.u32();
+    for (std::uint32_t n = 0 ; n < count ; ++n)
+    {
+      const std::string name = r.str();
+      const auto tag = static_cast<value_tag>(r.u8());
+      switch (tag)
+      {
+        case value_tag::function:
+        {
+          const std::uint32_t index = r.u32();
+          if (index >= loaded.functions.size())
+          {
+            r.corrupt();
+          }
+          globals->define(name, lox_obj(lox_function(loaded.functions[index].get())));
+        }
+        break; case value_tag::native:
+        {
+          const std::string native = r.str();
+          if (!globals->contains(native))
+          {
+            throw std::runtime_error("snapshot: native '" + native + "' is not defined.");
+          }
+          globals->define(name, globals->get(native, source_loc{}));
+        }
+        break; default: globals->define(name, r.literal(tag));
+      }
+    }
+    if (!r.at_end())
+    {
+      r.corrupt();
+    }
+    return loaded;
+  }
+
+} // namespace cwt
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "source_map.hpp"
+#include "stmt.hpp"
+
+namespace cwt
+{
+  class interpreter;
+
+  // the syntax trees of the functions a loaded snapshot defined. lox
+  // functions point into them, so it has to outlive the interpreter.
+  struct snapshot
+  {
+    std::vector<std::unique_ptr<stmt_function<lox_obj>>> functions;
+  };
+
+  // writes the globals of i after a prelude ran: numbers, strings, bools,
+  // nil, lox functions with their syntax trees and natives by name, plus
+  // the files in sources that locations point into. functions of the flat
+  // and vm backends are not supported.
+  void save_snapshot(interpreter& i, const source_map& sources, std::ostream& out);
+
+  // defines the globals of an image in i without running anything. the
+  // files of the image are added to sources and locations moved to where
+  // they land. natives are bound to what i has under the same name.
+  snapshot load_snapshot(interpreter& i, source_map& sources, std::istream& in);
+
+} // namespace cwt
@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "source_map.hpp"
+
+namespace cwt
+{
+
+source_loc source_map::add(std::string name, std::string text)
+{
+  const source_loc base = place(text.size());
+  add_at(base, std::move(name), std::move(text));
+  return base;
+}
+
+source_loc source_map::place(std::size_t size) const
+{
+  if (size < UINT32_MAX - m_next_base)
+  {
+    return source_loc{m_next_base};
+  }
+  // pieces of a split file are not one apart, the gap after them is
+  std::uint32_t free = 1;
+  for (const auto& f : m_files)
+  {
+    if (f->base > free && f->base - free > size)
+    {
+      return source_loc{free};
+    }
+    free = std::max(free, f->base + static_cast<std::uint32_t>(f->text.size()) + 1);
+  }
+  throw std::runtime_error("source_map: program too large.");
+}
+
+void source_map::add_at(source_loc base, std::string name, std::string text)
+{
+  auto it = std::lower_bound(m_files.begin(), m_files.end(), base.offset, 
+    [](const std::unique_ptr<file>& f, std::uint32_t offset) { return f->base < offset; });
+  // one extra slot so the end of file has a location as well
+  const std::uint64_t end = std::uint64_t{base.offset} + text.size() + 1;
+  if (base.offset == 0 || end > UINT32_MAX || (it != m_files.end() && (*it)->base < end)
+    || (it != m_files.begin() && (*std::prev(it))->base + (*std::prev(it))->text.size() >= base.offset))
+  {
+    throw std::runtime_error("source_map: location already taken.");
+  }
+  auto f = std::make_unique<file>();
+  f->name = std::move(name);
+  f->text = std::move(text);
+  f->base = base.offset;
+  m_files.insert(it, std::move(f));
+  m_next_base = std::max(m_next_base, static_cast<std::uint32_t>(end));
+}
+
+void source_map::remove(source_loc base)
+{
+  auto it = std::lower_bound(m_files.begin(), m_files.end(), base.offset, 
+    [](const std::unique_ptr<file>& f, std::uint32_t offset) { return f->base < offset; });
+  if (it == m_files.end() || (*it)->base != base.offset)
+  {
+    throw std::runtime_error("source_map: unknown location.");
+  }
+  m_files.erase(it);
+  // the end of the address space is handed out again as well
+  m_next_base = m_files.empty() ? 1 : m_files.back()->base + static_cast<std::uint32_t>(m_files.back()->text.size()) + 1;
+}
+
+void source_map::split(source_loc base, const std::vector<std::uint32_t>& offsets)
+{
+  file* whole = find_base(base);
+  std::vector<std::unique_ptr<file>> pieces;
+  pieces.reserve(offsets.size() + 1);
+  std::uint32_t begin = 0;
+  for (std::size_t i = 0 ; i <= offsets.size() ; ++i)
+  {
+    const std::uint32_t end = i < offsets.size() ? offsets[i] : static_cast<std::uint32_t>(whole->text.size());
+    if (end < begin || (i < offsets.size() && (end == begin || end >= whole->text.size())))
+    {
+      throw std::runtime_error("source_map: bad split.");
+    }
+    auto f = std::make_unique<file>();
+    f->name = whole->name;
+    f->text = whole->text.substr(begin, end - begin);
+    f->base = whole->base + begin;
+    pieces.push_back(std::move(f));
+    begin = end;
+  }
+  // bases stay ascending, the pieces take the place of the file
+  auto it = std::lower_bound(m_files.begin(), m_files.end(), base.offset, 
+    [](const std::unique_ptr<file>& f, std::uint32_t offset) { return f->base < offset; });
+  *it = std::move(pieces.front());
+  m_files.insert(std::next(it), std::make_move_iterator(std::next(pieces.begin())), std::make_move_iterator(pieces.end()));
+}
+
+void source_map::link_first_line(source_loc base, std::shared_ptr<const std::size_t> first_line)
+{
+  find_base(base)->first_line = std::move(first_line);
+}
+
+source_map::file* source_map::find_base(source_loc base)
+{
+  auto it = std::lower_bound(m_files.begin(), m_files.end(), base.offset, 
+    [](const std::unique_ptr<file>& f, std::uint32_t offset) { return f->base < offset; });
+  if (it == m_files.end() || (*it)->base != base.offset)
+  {
+    throw std::runtime_error("source_map: unknown location.");
+  }
+  return it->get();
+}
+
+const source_map::file* source_map::find(source_loc loc) const
+{
+  if (loc.offset == 0) 
+  {
+    return nullptr;
+  }
+  auto it = std::upper_bound(m_files.begin(), m_files.end(), loc.offset, 
+    [](std::uint32_t offset, const std::unique_ptr<file>& f) { return offset < f->base; });
+  if (it == m_files.begin()) 
+  {
+    return nullptr;
+  }
+  const file* f = std::prev(it)->get();
+  return loc.offset - f->base <= f->text.size() ? f : nullptr;
+}
+
+const std::string& source_map::text(source_loc base) const
+{
+  const file* f = find(base);
+  if (!f) 
+  {
+    throw std::runtime_error("source_map: unknown location.");
+  }
+  return f->text;
+}
+
+std::vector<std::pair<std::string_view, std::string_view>> source_map::files() const
+{
+  std::vector<std::pair<std::string_view, std::string_view>> result;
+  result.reserve(m_files.size());
+  for (const auto& f : m_files)
+  {
+    result.emplace_back(f->name, f->text);
+  }
+  return result;
+}
+
+std::optional<source_map::position> source_map::decode(source_loc loc) const
+{
+  const file* f = find(loc);
+  if (!f)
+  {
+    return std::nullopt;
+  }
+  std::call_once(f->lines_once, [f]() {
+    f->line_starts.push_back(0);
+    for (std::uint32_t i = 0 ; i < f->text.size() ; ++i)
+    {
+      if (f->text[i] == '\n') 
+      {
+        f->line_starts.push_back(i + 1);
+      }
+    }
+  });
+
+  const std::uint32_t offset = loc.offset - f->base;
+  auto it = std::upper_bound(f->line_starts.begin(), f->line_starts.end(), offset);
+  const std::size_t first_line = f->first_line ? *f->first_line : 1;
+  const std::size_t line = first_line - 1 + static_cast<std::size_t>(it - f->line_starts.begin());
+  const std::uint32_t start = *std::prev(it);
+  std::size_t end = f->text.find('\n', start);
+  if (end == std::string::npos) 
+  {
+    end = f->text.size();
+  }
+  return position{f->name, line, offset - start + 1, std::string_view(f->text).substr(start, end - start)};
+}
+
+std::string source_map::describe(source_loc loc) const
+{
+  std::optional<position> pos = decode(loc);
+  if (!pos)
+  {
+    return "<unknown>";
+  }
+  std::string s{pos->name};
+  s.append(":");
+  s.append(std::to_string(pos->line));
+  s.append(":");
+  s.append(std::to_string(pos->column));
+  return s;
+}
+
+std::string source_map::excerpt(source_loc loc) const
+{
+  std::optional<position> pos = decode(loc);
+  if (!pos)
+  {
+    return "";
+  }
+  std::string s{"    "};
+  s.append(pos->line_text);
+  s.append("\n    ");
+  for (std::size_t i = 1 ; i < pos->column ; ++i)
+  {
+    s.push_back(pos->line_text[i-1] == '\t' ? '\t' : ' ');
+  }
+  s.append("^");
+  return s;
+}
+
+} // namespace cwt
@@ -0,0 +1,81 @@
+#pragma once 
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace cwt
+{
+  // a position in the address space of a source_map. every file owns a range 
+  // [base, base + size] of it, offset 0 means "no location".
+  struct source_loc 
+  {
+    std::uint32_t offset = 0;
+  };
+
+  // owns the text of all files of a program. locations are decoded to 
+  // line:column only when a diagnostic is printed, the line start table 
+  // of a file is built the first time it is needed.
+  class source_map
+  {
+    public:
+      struct position 
+      {
+        std::string_view name;
+        std::size_t line;
+        std::size_t column;
+        std::string_view line_text;
+      };
+
+      // registers a file and returns the location of its first byte
+      source_loc add(std::string name, std::string text);
+      // where add puts a file of size bytes: after the last file while the
+      // address space lasts, then in the first gap a removed file left
+      source_loc place(std::size_t size) const;
+      // registers a file at a location place gave out for at least its size,
+      // for text that is parsed before it is known whether it is kept
+      void add_at(source_loc base, std::string name, std::string text);
+      // forgets the file or piece at base, its locations may be given out again
+      void remove(source_loc base);
+      // cuts the file at base into pieces that start at the given offsets,
+      // ascending, each numbering its lines from 1. locations stay valid,
+      // references to the text of the file do not.
+      void split(source_loc base, const std::vector<std::uint32_t>& offsets);
+      // the file at base starts on the line first_line holds when a location
+      // in it is decoded, for pieces of a text that moves while it is edited
+      void link_first_line(source_loc base, std::shared_ptr<const std::size_t> first_line);
+
+      const std::string& text(source_loc base) const;
+      // name and text of every file, in the order of their locations
+      std::vector<std::pair<std::string_view, std::string_view>> files() const;
+      std::optional<position> decode(source_loc loc) const;
+
+      // "name:line:column"
+      std::string describe(source_loc loc) const;
+      // the source line of loc and a caret below the column
+      std::string excerpt(source_loc loc) const;
+
+    private:
+      struct file 
+      {
+        std::string name;
+        std::string text;
+        std::uint32_t base;
+        std::shared_ptr<const std::size_t> first_line;
+        mutable std::once_flag lines_once;
+        mutable std::vector<std::uint32_t> line_starts;
+      };
+
+      const file* find(source_loc loc) const;
+      file* find_base(source_loc base);
+
+    private:
+      std::vector<std::unique_ptr<file>> m_files;
+      std::uint32_t m_next_base{1};
+  };
+} // namespace cwt
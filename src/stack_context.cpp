@@ -0,0 +1,258 @@
+#include <cstdint>
+#include <stdexcept>
+
+#include "stack_context.hpp"
+
+#if defined(__linux__)
+#define LOX_STACK_CONTEXT
+#include <sys/mman.h>
+#include <unistd.h>
+#if defined(__x86_64__)
+#define LOX_STACK_CONTEXT_X86_64
+#else
+#include <ucontext.h>
+#endif
+#endif
+
+#if defined(__SANITIZE_ADDRESS__)
+#define LOX_STACK_CONTEXT_ASAN
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define LOX_STACK_CONTEXT_ASAN
+#endif
+#endif
+
+#ifdef LOX_STACK_CONTEXT_ASAN
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+namespace cwt
+{
+  namespace
+  {
+    // reserved, not committed: pages are only backed once code on it
+    // recurses that deep, so thousands of stacks cost little more than
+    // their frames. as deep as the main thread may go by default.
+    constexpr std::size_t stack_size = 8 << 20;
+
+    thread_local stack_context* running = nullptr;
+    // the context the last switch came from
+    thread_local stack_context* previous = nullptr;
+
+    void begin_switch([[maybe_unused]] void** fake_stack, [[maybe_unused]] const void* bottom, [[maybe_unused]] std::size_t size)
+    {
+#ifdef LOX_STACK_CONTEXT_ASAN
+      __sanitizer_start_switch_fiber(fake_stack, bottom, size);
+#endif
+    }
+
+    void end_switch([[maybe_unused]] void* fake_stack, [[maybe_unused]] const void** bottom, [[maybe_unused]] std::size_t* size)
+    {
+#ifdef LOX_STACK_CONTEXT_ASAN
+      __sanitizer_finish_switch_fiber(fake_stack, bottom, size);
+#endif
+    }
+
+#ifdef LOX_STACK_CONTEXT
+    std::size_t guard_size()
+    {
+      static const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+      return page;
+    }
+
+    // the lowest page stays inaccessible, an overflow faults instead of
+    // running into the neighbouring mapping
+    void* allocate_stack()
+    {
+      void* base = mmap(nullptr, stack_size + guard_size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+      if (base == MAP_FAILED)
+      {
+        throw std::runtime_error("out of memory for fiber stacks.");
+      }
+      mprotect(base, guard_size(), PROT_NONE);
+      return base;
+    }
+
+    void free_stack(void* base)
+    {
+      munmap(base, stack_size + guard_size());
+    }
+#endif
+
+#ifdef LOX_STACK_CONTEXT_X86_64
+    extern "C" void lox_stack_switch(void** from, void* to);
+    extern "C" void lox_stack_start();
+    asm(R"(
+      .text
+      .globl lox_stack_switch
+      .type lox_stack_switch, @function
+    lox_stack_switch:
+      pushq %rbp
+      pushq %rbx
+      pushq %r12
+      pushq %r13
+      pushq %r14
+      pushq %r15
+      movq %rsp, (%rdi)
+      movq %rsi, %rsp
+      popq %r15
+      popq %r14
+      popq %r13
+      popq %r12
+      popq %rbx
+      popq %rbp
+      ret
+      .size lox_stack_switch, .-lox_stack_switch
+
+      .globl lox_stack_start
+      .type lox_stack_start, @function
+    lox_stack_start:
+      movq %r12, %rdi
+      callq *%r13
+      ud2
+      .size lox_stack_start, .-lox_stack_start
+    )");
+#elif defined(LOX_STACK_CONTEXT)
+    // makecontext only passes ints
+    void start_split(unsigned int entry_high, unsigned int entry_low, unsigned int arg_high, unsigned int arg_low)
+    {
+      auto entry = reinterpret_cast<void (*)(void*)>((static_cast<std::uintptr_t>(entry_high) << 32) | entry_low);
+      entry(reinterpret_cast<void*>((static_cast<std::uintptr_t>(arg_high) << 32) | arg_low));
+    }
+#endif
+  }
+
+  struct stack_context::machine
+  {
+#ifdef LOX_STACK_CONTEXT_X86_64
+    void* sp = nullptr;
+
+    // the first switch pops the entry and its argument into r13 and r12
+    // and returns into lox_stack_start, 16 byte aligned for its call
+    void prepare(void* stack, std::size_t size, void (*entry)(void*), void* arg)
+    {
+      auto top = reinterpret_cast<std::uintptr_t>(static_cast<char*>(stack) + size) & ~std::uintptr_t{15};
+      auto* frame = reinterpret_cast<void**>(top - 72);
+      frame[0] = nullptr;
+      frame[1] = nullptr;
+      frame[2] = reinterpret_cast<void*>(entry);
+      frame[3] = arg;
+      frame[4] = nullptr;
+      frame[5] = nullptr;
+      frame[6] = reinterpret_cast<void*>(&lox_stack_start);
+      sp = frame;
+    }
+
+    void switch_to(machine& to)
+    {
+      lox_stack_switch(&sp, to.sp);
+    }
+#elif defined(LOX_STACK_CONTEXT)
+    ucontext_t uc;
+
+    void prepare(void* stack, std::size_t size, void (*entry)(void*), void* arg)
+    {
+      const auto e = reinterpret_cast<std::uintptr_t>(entry);
+      const auto a = reinterpret_cast<std::uintptr_t>(arg);
+      getcontext(&uc);
+      uc.uc_stack.ss_sp = stack;
+      uc.uc_stack.ss_size = size;
+      uc.uc_link = nullptr;
+      makecontext(&uc, reinterpret_cast<void (*)()>(&start_split), 4,
+        static_cast<unsigned int>(e >> 32), static_cast<unsigned int>(e & 0xFFFFFFFF),
+        static_cast<unsigned int>(a >> 32), static_cast<unsigned int>(a & 0xFFFFFFFF));
+    }
+
+    void switch_to(machine& to)
+    {
+      swapcontext(&uc, &to.uc);
+    }
+#endif
+  };
+
+  stack_context::stack_context() : m_machine(std::make_unique<machine>())
+  {
+  }
+
+  stack_context::stack_context(entry_t entry, void* arg) : m_machine(std::make_unique<machine>())
+  {
+#ifdef LOX_STACK_CONTEXT
+    m_stack = allocate_stack();
+    m_bottom = static_cast<char*>(m_stack) + guard_size();
+    m_size = stack_size;
+    reset(entry, arg);
+#else
+    (void)entry;
+    (void)arg;
+    throw std::runtime_error("fibers are not supported on this platform.");
+#endif
+  }
+
+  stack_context::~stack_context()
+  {
+#ifdef LOX_STACK_CONTEXT
+    if (m_stack)
+    {
+      free_stack(m_stack);
+    }
+#endif
+  }
+
+  bool stack_context::supported() noexcept
+  {
+#ifdef LOX_STACK_CONTEXT
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  stack_context* stack_context::current() noexcept
+  {
+    return running;
+  }
+
+  void stack_context::reset(entry_t entry, void* arg)
+  {
+    m_entry = entry;
+    m_arg = arg;
+#ifdef LOX_STACK_CONTEXT
+    m_machine->prepare(static_cast<char*>(m_stack) + guard_size(), stack_size, &stack_context::start, this);
+#endif
+  }
+
+  void stack_context::switch_to(stack_context& to)
+  {
+#ifdef LOX_STACK_CONTEXT
+    previous = this;
+    running = &to;
+    begin_switch(&m_fake_stack, to.m_bottom, to.m_size);
+    m_machine->switch_to(*to.m_machine);
+    end_switch(m_fake_stack, &previous->m_bottom, &previous->m_size);
+#else
+    (void)to;
+#endif
+  }
+
+  void stack_context::exit_to(stack_context& to)
+  {
+#ifdef LOX_STACK_CONTEXT
+    previous = this;
+    running = &to;
+    begin_switch(nullptr, to.m_bottom, to.m_size);
+    m_machine->switch_to(*to.m_machine);
+#else
+    (void)to;
+#endif
+    __builtin_unreachable();
+  }
+
+  void stack_context::start(void* self)
+  {
+    auto* context = static_cast<stack_context*>(self);
+    end_switch(nullptr, &previous->m_bottom, &previous->m_size);
+    context->m_entry(context->m_arg);
+    __builtin_unreachable();
+  }
+
+} // namespace cwt
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+namespace cwt
+{
+  // code running on a stack of its own, switched to and away from by hand.
+  // linux only: on x86-64 a switch saves the callee saved registers and
+  // nothing else, no syscall, other targets go through ucontext.
+  class stack_context
+  {
+    public:
+      using entry_t = void (*)(void*);
+
+      // holds whatever runs when it switches away, the thread's own stack
+      // or another context
+      stack_context();
+      // a fresh stack, the first switch to it calls entry(arg). entry must
+      // not return, it ends with exit_to.
+      stack_context(entry_t entry, void* arg);
+      ~stack_context();
+      stack_context(const stack_context&) = delete;
+      stack_context& operator=(const stack_context&) = delete;
+
+      static bool supported() noexcept;
+      // the context code runs in now, null before the first switch
+      static stack_context* current() noexcept;
+
+      // starts over with another entry on the same stack, only after exit_to
+      void reset(entry_t entry, void* arg);
+      // continues in to, returns once something switches back to this
+      void switch_to(stack_context& to);
+      // the last switch away, the stack is not touched again until reset
+      [[noreturn]] void exit_to(stack_context& to);
+
+    private:
+      struct machine;
+
+      static void start(void* self);
+
+    private:
+      std::unique_ptr<machine> m_machine;
+      void* m_stack = nullptr;
+      entry_t m_entry = nullptr;
+      void* m_arg = nullptr;
+      // the stack a switch goes to, for asan. a context without a stack of
+      // its own learns it when something switches back from it
+      void* m_fake_stack = nullptr;
+      const void* m_bottom = nullptr;
+      std::size_t m_size = 0;
+  };
+
+} // namespace cwt
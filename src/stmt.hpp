@@ -29,11 +29,21 @@ namespace cwt
     virtual void visit(const stmt_while<T>& s) { throw std::runtime_error("stmt_visitor not implemented"); }
   };
 
+  enum class stmt_type
+  {
+    _block = 0, _class, _expression, _function, _if, _print, _return, _var, _while
+  };
+
   template<typename T>
   struct lox_statement
   {
+    lox_statement(source_loc loc, stmt_type kind) : loc(loc), kind(kind) {}
     virtual ~lox_statement() = default;
     virtual void accept(stmt_visitor<T>& v) = 0;
+    stmt_type type() const noexcept { return kind; }
+
+    source_loc loc;
+    stmt_type kind;
   };
 
   template<typename T>
@@ -41,7 +51,8 @@ namespace cwt
   {
     using stmt_t = std::unique_ptr<lox_statement<T>>;
     
-    stmt_block(std::vector<stmt_t> statements) : statements(std::move(statements)) {}
+    stmt_block(std::vector<stmt_t> statements, source_loc loc) 
+    : lox_statement<T>(loc, stmt_type::_block), statements(std::move(statements)) {}
     void accept(stmt_visitor<T>& v) override
     {
       return v.visit(*this);
@@ -56,15 +67,15 @@ namespace cwt
     using expr_t = std::unique_ptr<lox_expression<T>>;
     using func_t = stmt_function<T>;
 
-    stmt_class(token name, expr_t superclass, const std::vector<func_t*>& methods) 
-    : name(name), superclass(std::move(superclass)), methods(std::move(methods)) {}
+    stmt_class(std::string name, expr_t superclass, const std::vector<func_t*>& methods, source_loc loc) 
+    : lox_statement<T>(loc, stmt_type::_class), name(std::move(name)), superclass(std::move(superclass)), methods(std::move(methods)) {}
 
     void accept(stmt_visitor<T>& v) override
     {
       return v.visit(*this);
     }
 
-    token name;
+    std::string name;
     expr_t superclass; 
     std::vector<func_t*> methods;
   };
@@ -75,7 +86,8 @@ namespace cwt
     using stmt_t = std::unique_ptr<lox_statement<T>>;
     using expr_t = std::unique_ptr<lox_expression<T>>;
 
-    stmt_expression(expr_t expression) : expression(std::move(expression)) {}
+    stmt_expression(expr_t expression, source_loc loc) 
+    : lox_statement<T>(loc, stmt_type::_expression), expression(std::move(expression)) {}
 
     void accept( stmt_visitor<T>& v) override
     {
@@ -90,16 +102,16 @@ namespace cwt
   {
     using stmt_t = std::unique_ptr<lox_statement<T>>;
     
-    stmt_function(token name, const std::vector<token>& parameters, std::vector<stmt_t> body) 
-    : name(name), parameters(parameters), body(std::move(body)) {}
+    stmt_function(std::string name, std::vector<std::string> parameters, std::vector<stmt_t> body, source_loc loc) 
+    : lox_statement<T>(loc, stmt_type::_function), name(std::move(name)), parameters(std::move(parameters)), body(std::move(body)) {}
     
     void accept( stmt_visitor<T>& v) override
     {
       return v.visit(*this);
     }
 
-    token name; 
-    std::vector<token> parameters;
+    std::string name; 
+    std::vector<std::string> parameters;
     std::vector<stmt_t> body;
   };
 
@@ -109,8 +121,8 @@ namespace cwt
     using stmt_t = std::unique_ptr<lox_statement<T>>;
     using expr_t = std::unique_ptr<lox_expression<T>>;
     
-    stmt_if(expr_t condition, std::vector<stmt_t> then_branch, std::vector<stmt_t> else_branch) 
-    : condition(std::move(condition)), then_branch(std::move(then_branch)), else_branch(std::move(else_branch)) {}
+    stmt_if(expr_t condition, std::vector<stmt_t> then_branch, std::vector<stmt_t> else_branch, source_loc loc) 
+    : lox_statement<T>(loc, stmt_type::_if), condition(std::move(condition)), then_branch(std::move(then_branch)), else_branch(std::move(else_branch)) {}
     
     void accept( stmt_visitor<T>& v) override
     {
@@ -128,7 +140,8 @@ namespace cwt
     using stmt_t = std::unique_ptr<lox_statement<T>>;
     using expr_t = std::unique_ptr<lox_expression<T>>;
     
-    stmt_print(expr_t expression) : expression(std::move(expression)) {}
+    stmt_print(expr_t expression, source_loc loc) 
+    : lox_statement<T>(loc, stmt_type::_print), expression(std::move(expression)) {}
 
     void accept( stmt_visitor<T>& v) override
     {
@@ -144,15 +157,14 @@ namespace cwt
     using stmt_t = std::unique_ptr<lox_statement<T>>;
     using expr_t = std::unique_ptr<lox_expression<T>>;
   
-    stmt_return(token keyword, expr_t value) 
-    : keyword(keyword), value(std::move(value)) {}
+    stmt_return(expr_t value, source_loc loc) 
+    : lox_statement<T>(loc, stmt_type::_return), value(std::move(value)) {}
     
     void accept( stmt_visitor<T>& v) override
     {
       return v.visit(*this);
     }
 
-    token keyword; 
     expr_t value;
 
   };
@@ -162,15 +174,15 @@ namespace cwt
     using stmt_t = std::unique_ptr<lox_statement<T>>;
     using expr_t = std::unique_ptr<lox_expression<T>>;
 
-    stmt_var(token name, expr_t initializer) 
-    : name(name), initializer(std::move(initializer)) {}
+    stmt_var(std::string name, expr_t initializer, source_loc loc) 
+    : lox_statement<T>(loc, stmt_type::_var), name(std::move(name)), initializer(std::move(initializer)) {}
     
     void accept( stmt_visitor<T>& v) override
     {
       return v.visit(*this);
     }
   
-    token name; 
+    std::string name; 
     expr_t initializer;
   };
 
@@ -180,8 +192,8 @@ namespace cwt
     using stmt_t = std::unique_ptr<lox_statement<T>>;
     using expr_t = std::unique_ptr<lox_expression<T>>;
 
-    stmt_while(expr_t condition, std::vector<stmt_t> body) 
-    : condition(std::move(condition)), body(std::move(body)) {}
+    stmt_while(expr_t condition, std::vector<stmt_t> body, source_loc loc) 
+    : lox_statement<T>(loc, stmt_type::_while), condition(std::move(condition)), body(std::move(body)) {}
     
     void accept( stmt_visitor<T>& v) override
     {
@@ -190,6 +202,9 @@ namespace cwt
 
     expr_t condition;
     std::vector<stmt_t> body;
+    // changes every time the loop is entered, expr_cached nodes hoisted 
+    // out of this loop are only valid for one run
+    mutable std::uint64_t epoch = 0;
   };
 
 
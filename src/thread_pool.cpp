@@ -0,0 +1,56 @@
+#include "thread_pool.hpp"
+
+namespace cwt
+{
+
+thread_pool::thread_pool(std::size_t threads)
+{
+  if (threads == 0) 
+  {
+    threads = 1;
+  }
+  m_workers.reserve(threads);
+  for (std::size_t i = 0 ; i < threads ; ++i)
+  {
+    m_workers.emplace_back([this]() { worker_loop(); });
+  }
+}
+
+thread_pool::~thread_pool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+  for (auto& w : m_workers)
+  {
+    w.join();
+  }
+}
+
+std::size_t thread_pool::size() const noexcept
+{
+  return m_workers.size();
+}
+
+void thread_pool::worker_loop()
+{
+  while (true)
+  {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+      if (m_stop && m_tasks.empty()) 
+      {
+        return;
+      }
+      task = std::move(m_tasks.front());
+      m_tasks.pop();
+    }
+    task();
+  }
+}
+
+} // namespace cwt
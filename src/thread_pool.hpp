@@ -0,0 +1,91 @@
+#pragma once 
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace cwt
+{
+  class thread_pool
+  {
+    public:
+      explicit thread_pool(std::size_t threads = std::thread::hardware_concurrency());
+      ~thread_pool();
+      thread_pool(const thread_pool&) = delete;
+      thread_pool& operator=(const thread_pool&) = delete;
+
+      std::size_t size() const noexcept;
+
+      template<typename Func>
+      auto submit(Func&& func) -> std::future<std::invoke_result_t<Func>>
+      {
+        using result_t = std::invoke_result_t<Func>;
+        auto task = std::make_shared<std::packaged_task<result_t()>>(std::forward<Func>(func));
+        std::future<result_t> result = task->get_future();
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_tasks.push([task]() { (*task)(); });
+        }
+        m_cv.notify_one();
+        return result;
+      }
+
+      // calls func(i) for every i in [0, count) on all workers and blocks until done. 
+      // indices are handed out one at a time, so uneven jobs still balance.
+      // must not be called from inside a worker of the same pool.
+      template<typename Func>
+      void parallel_for(std::size_t count, Func&& func)
+      {
+        std::atomic<std::size_t> next{0};
+        std::vector<std::future<void>> done;
+        const std::size_t workers = std::min(size(), count);
+        done.reserve(workers);
+        for (std::size_t w = 0 ; w < workers ; ++w)
+        {
+          done.push_back(submit([&next, &func, count]() {
+            for (std::size_t i = next++ ; i < count ; i = next++)
+            {
+              func(i);
+            }
+          }));
+        }
+        // the tasks use next and func, every one has to finish before an
+        // exception leaves this frame
+        std::exception_ptr failed;
+        for (auto& f : done) 
+        {
+          try
+          {
+            f.get();
+          }
+          catch(...)
+          {
+            if (!failed) { failed = std::current_exception(); }
+          }
+        }
+        if (failed)
+        {
+          std::rethrow_exception(failed);
+        }
+      }
+
+    private:
+      void worker_loop();
+
+    private:
+      std::vector<std::thread> m_workers;
+      std::queue<std::function<void()>> m_tasks;
+      std::mutex m_mutex;
+      std::condition_variable m_cv;
+      bool m_stop{false};
+  };
+} // namespace cwt
@@ -9,6 +9,53 @@ token::token(const token_type type, const std::string& lexeme, const std::size_t
 token::token(const token_type type, const std::string& lexeme, const std::size_t line, const std::string& literal) 
 : type(type), lexeme(lexeme), line(line), literal(literal) {}
 
+const char* lexeme_of(token_type type) noexcept
+{
+  switch (type)
+  {
+    case token_type::LEFT_PAREN: return "(";
+    case token_type::RIGHT_PAREN: return ")";
+    case token_type::LEFT_BRACE: return "{";
+    case token_type::RIGHT_BRACE: return "}";
+    case token_type::LEFT_BRACKET: return "[";
+    case token_type::RIGHT_BRACKET: return "]";
+    case token_type::COMMA: return ",";
+    case token_type::DOT: return ".";
+    case token_type::COLON: return ":";
+    case token_type::MINUS: return "-";
+    case token_type::PLUS: return "+";
+    case token_type::SEMICOLON: return ";";
+    case token_type::SLASH: return "/";
+    case token_type::STAR: return "*";
+    case token_type::POUND: return "#";
+    case token_type::BANG: return "!";
+    case token_type::BANG_EQUAL: return "!=";
+    case token_type::EQUAL: return "=";
+    case token_type::EQUAL_EQUAL: return "==";
+    case token_type::GREATER: return ">";
+    case token_type::GREATER_EQUAL: return ">=";
+    case token_type::LESS: return "<";
+    case token_type::LESS_EQUAL: return "<=";
+    case token_type::AND: return "and";
+    case token_type::CLASS: return "class";
+    case token_type::ELSE: return "else";
+    case token_type::FALSE: return "false";
+    case token_type::FUN: return "fun";
+    case token_type::FOR: return "for";
+    case token_type::IF: return "if";
+    case token_type::NIL: return "nil";
+    case token_type::OR: return "or";
+    case token_type::PRINT: return "print";
+    case token_type::RETURN: return "return";
+    case token_type::SUPER: return "super";
+    case token_type::THIS: return "this";
+    case token_type::TRUE: return "true";
+    case token_type::VAR: return "var";
+    case token_type::WHILE: return "while";
+    default: return "";
+  }
+}
+
 std::string token::to_string() const noexcept
 {
   std::string s{std::to_string(static_cast<std::size_t>(type))};
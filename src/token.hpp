@@ -1,13 +1,15 @@
 #pragma once 
 
+#include <cstdint>
 #include <string>
 
 namespace cwt
 {
-  enum class token_type {
+  // one byte, token streams keep an array of them
+  enum class token_type : std::uint8_t {
     // single character tokens
-    LEFT_PAREN = 0, RIGHT_PAREN, LEFT_BRACE, RIGHT_BRACE,
-    COMMA, DOT, MINUS, PLUS, SEMICOLON, SLASH, STAR, POUND,
+    LEFT_PAREN = 0, RIGHT_PAREN, LEFT_BRACE, RIGHT_BRACE, LEFT_BRACKET, RIGHT_BRACKET,
+    COMMA, DOT, COLON, MINUS, PLUS, SEMICOLON, SLASH, STAR, POUND,
 
     // one or two character tokens
     BANG, BANG_EQUAL, EQUAL, EQUAL_EQUAL,
@@ -23,6 +25,9 @@ namespace cwt
     END_OF_FILE
   };
 
+  // source spelling of operators, punctuation and keywords, "" for everything else
+  const char* lexeme_of(token_type type) noexcept;
+
   struct token 
   {  
       token(const token_type type, const std::string& lexeme, const std::size_t line);
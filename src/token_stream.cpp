@@ -0,0 +1,61 @@
+#include <algorithm>
+
+#include "token_stream.hpp"
+
+namespace cwt
+{
+
+token_stream::token_stream(std::string src) : m_src(std::move(src)) {}
+
+void token_stream::push(token_type type, std::size_t offset, std::size_t length, std::size_t line)
+{
+  if (m_lines.empty() || m_lines.back().line != line)
+  {
+    m_lines.push_back(line_entry{static_cast<std::uint32_t>(m_types.size()), static_cast<std::uint32_t>(line)});
+  }
+  m_types.push_back(type);
+  m_offsets.push_back(static_cast<std::uint32_t>(offset));
+  m_lengths.push_back(static_cast<std::uint32_t>(length));
+}
+
+void token_stream::reserve(std::size_t count)
+{
+  m_types.reserve(count);
+  m_offsets.reserve(count);
+  m_lengths.reserve(count);
+}
+
+std::string_view token_stream::literal(std::size_t i) const noexcept
+{
+  switch (m_types[i])
+  {
+    case token_type::NUMBER: return lexeme(i);
+    case token_type::STRING: return lexeme(i).substr(1, m_lengths[i] - 2);
+    default: return std::string_view{};
+  }
+}
+
+std::size_t token_stream::line(std::size_t i) const noexcept
+{
+  auto it = std::upper_bound(m_lines.begin(), m_lines.end(), i, 
+    [](std::size_t idx, const line_entry& e) { return idx < e.first_token; });
+  return it == m_lines.begin() ? 1 : std::prev(it)->line;
+}
+
+token token_stream::at(std::size_t i) const
+{
+  return token{type(i), std::string(lexeme(i)), line(i), std::string(literal(i))};
+}
+
+std::vector<token> token_stream::to_tokens() const
+{
+  std::vector<token> tokens;
+  tokens.reserve(size());
+  for (std::size_t i = 0 ; i < size() ; ++i)
+  {
+    tokens.push_back(at(i));
+  }
+  return tokens;
+}
+
+} // namespace cwt
@@ -0,0 +1,50 @@
+#pragma once 
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "token.hpp"
+
+namespace cwt
+{
+  // tokens stored column wise: a type array and (offset, length) spans into the 
+  // source, 9 bytes a token. line numbers are kept run length encoded, one entry
+  // per line that starts a token. a full `token` is only built when someone asks
+  // for it. the stream keeps its own copy of the source, so it can outlive the
+  // text it was scanned from.
+  class token_stream
+  {
+    public:
+      token_stream() = default;
+      explicit token_stream(std::string src);
+
+      void push(token_type type, std::size_t offset, std::size_t length, std::size_t line);
+      void reserve(std::size_t count);
+
+      std::size_t size() const noexcept { return m_types.size(); }
+      token_type type(std::size_t i) const noexcept { return m_types[i]; }
+      std::string_view lexeme(std::size_t i) const noexcept { return std::string_view(m_src).substr(m_offsets[i], m_lengths[i]); }
+      std::string_view literal(std::size_t i) const noexcept;
+      std::size_t offset(std::size_t i) const noexcept { return m_offsets[i]; }
+      std::size_t line(std::size_t i) const noexcept;
+      const std::string& source() const noexcept { return m_src; }
+
+      token at(std::size_t i) const;
+      std::vector<token> to_tokens() const;
+
+    private:
+      struct line_entry 
+      {
+        std::uint32_t first_token;
+        std::uint32_t line;
+      };
+
+      std::string m_src;
+      std::vector<token_type> m_types;
+      std::vector<std::uint32_t> m_offsets;
+      std::vector<std::uint32_t> m_lengths;
+      std::vector<line_entry> m_lines;
+  };
+} // namespace cwt
@@ -0,0 +1,370 @@
+#include <charconv>
+#include <sstream>
+#include <unordered_map>
+
+#include "transpiler.hpp"
+
+namespace cwt
+{
+  namespace
+  {
+    using expr_t = std::unique_ptr<lox_expression<lox_obj>>;
+    using stmt_t = std::unique_ptr<lox_statement<lox_obj>>;
+
+    std::string quoted(std::string_view text)
+    {
+      std::string s{"\""};
+      for (const char c : text)
+      {
+        switch (c)
+        {
+          case '"': s.append("\\\"");
+          break; case '\\': s.append("\\\\");
+          break; case '\n': s.append("\\n");
+          break; case '\t': s.append("\\t");
+          break; default:
+          {
+            const auto u = static_cast<unsigned char>(c);
+            if (u < 0x20 || u >= 0x7F)
+            {
+              // always three digits, so a digit after it cannot extend the escape
+              const char octal[] = {'\\', static_cast<char>('0' + (u >> 6)), static_cast<char>('0' + ((u >> 3) & 7)), static_cast<char>('0' + (u & 7))};
+              s.append(octal, sizeof(octal));
+            }
+            else
+            {
+              s.push_back(c);
+            }
+          }
+        }
+      }
+      s.push_back('"');
+      return s;
+    }
+
+    std::string token_name(token_type t)
+    {
+      switch (t)
+      {
+        case token_type::BANG: return "BANG";
+        break; case token_type::BANG_EQUAL: return "BANG_EQUAL";
+        break; case token_type::EQUAL_EQUAL: return "EQUAL_EQUAL";
+        break; case token_type::GREATER: return "GREATER";
+        break; case token_type::GREATER_EQUAL: return "GREATER_EQUAL";
+        break; case token_type::LESS: return "LESS";
+        break; case token_type::LESS_EQUAL: return "LESS_EQUAL";
+        break; case token_type::MINUS: return "MINUS";
+        break; case token_type::PLUS: return "PLUS";
+        break; case token_type::SLASH: return "SLASH";
+        break; case token_type::STAR: return "STAR";
+        break; default: return "NIL";
+      }
+    }
+
+    std::string location(source_loc loc)
+    {
+      return "cwt::source_loc{" + std::to_string(loc.offset) + "}";
+    }
+
+    // every lox function becomes a c++ function of its own. scoping is
+    // dynamic, so nothing has to be captured: names are looked up in the
+    // environments at runtime, as in the interpreter.
+    class transpiler
+    {
+      public:
+        void program(const std::vector<stmt_t>& statements, const source_map& sources, std::ostream& out)
+        {
+          std::ostringstream main;
+          m_depth = 2;
+          statements_of(statements, main);
+
+          out << "// generated by the lox transpiler, do not edit\n"
+              << "#include \"aot_runtime.hpp\"\n\n"
+              << "namespace\n{\n";
+          for (std::size_t i = 0 ; i < m_names.size() ; ++i)
+          {
+            out << "  const std::string name_" << i << "{" << quoted(m_names[i]) << "};\n";
+          }
+          for (std::size_t i = 0 ; i < m_strings.size() ; ++i)
+          {
+            out << "  const cwt::lox_obj string_" << i << "{std::string(" << quoted(m_strings[i]) << ", " << m_strings[i].size() << ")};\n";
+          }
+          out << '\n';
+          for (std::size_t i = 0 ; i < m_functions.size() ; ++i)
+          {
+            out << "  cwt::lox_obj function_" << i << "(cwt::aot_runtime& rt, std::span<const cwt::lox_obj> args);\n";
+          }
+          out << '\n';
+          for (const auto& f : m_functions)
+          {
+            out << f << '\n';
+          }
+          out << "}\n\n"
+              << "int main()\n{\n"
+              << "  cwt::aot_runtime rt;\n";
+          for (const auto& [name, text] : sources.files())
+          {
+            out << "  rt.add_source(" << quoted(name) << ", std::string(" << quoted(text) << ", " << text.size() << "));\n";
+          }
+          out << "  try\n  {\n" << main.str()
+              << "  }\n  catch(const std::exception& e)\n  {\n    rt.report(e);\n  }\n"
+              << "  return 0;\n}\n";
+        }
+
+      private:
+        void statements_of(const std::vector<stmt_t>& list, std::ostream& out)
+        {
+          for (const auto& s : list)
+          {
+            statement(*s, out);
+          }
+        }
+
+        std::string indent() const { return std::string(2 * m_depth, ' '); }
+
+        // a block or a function body: its own environment, runtime errors
+        // end it and are reported
+        void scoped(const std::vector<stmt_t>& list, std::ostream& out, const std::string& prologue = {})
+        {
+          const std::string in = indent();
+          out << in << "try\n" << in << "{\n";
+          ++m_depth;
+          out << indent() << "cwt::aot_runtime::scope scope(rt);\n" << prologue;
+          statements_of(list, out);
+          --m_depth;
+          out << in << "}\n";
+          if (!m_in_function)
+          {
+            out << in << "catch(const cwt::lox_return&)\n" << in << "{\n" << in << "  throw;\n" << in << "}\n";
+          }
+          out << in << "catch(const std::exception& e)\n" << in << "{\n" << in << "  rt.report(e);\n" << in << "}\n";
+        }
+
+        void statement(lox_statement<lox_obj>& s, std::ostream& out)
+        {
+          switch (s.type())
+          {
+            case stmt_type::_expression:
+            {
+              out << indent() << expression(*static_cast<const stmt_expression<lox_obj>&>(s).expression) << ";\n";
+            }
+            break; case stmt_type::_print:
+            {
+              out << indent() << "rt.print(" << expression(*static_cast<const stmt_print<lox_obj>&>(s).expression) << ");\n";
+            }
+            break; case stmt_type::_var:
+            {
+              const auto& v = static_cast<const stmt_var<lox_obj>&>(s);
+              out << indent() << "rt.define(" << name(v.name) << ", "
+                  << (v.initializer ? expression(*v.initializer) : "cwt::lox_obj()") << ");\n";
+            }
+            break; case stmt_type::_block: scoped(static_cast<const stmt_block<lox_obj>&>(s).statements, out);
+            break; case stmt_type::_if:
+            {
+              const auto& i = static_cast<const stmt_if<lox_obj>&>(s);
+              const std::string in = indent();
+              out << in << "if (rt.truthy(" << expression(*i.condition) << "))\n" << in << "{\n";
+              ++m_depth;
+              statements_of(i.then_branch, out);
+              --m_depth;
+              out << in << "}\n";
+              if (!i.else_branch.empty())
+              {
+                out << in << "else\n" << in << "{\n";
+                ++m_depth;
+                statements_of(i.else_branch, out);
+                --m_depth;
+                out << in << "}\n";
+              }
+            }
+            break; case stmt_type::_while:
+            {
+              const auto& w = static_cast<const stmt_while<lox_obj>&>(s);
+              const std::string in = indent();
+              out << in << "while (rt.truthy(" << expression(*w.condition) << "))\n" << in << "{\n";
+              ++m_depth;
+              statements_of(w.body, out);
+              --m_depth;
+              out << in << "}\n";
+            }
+            break; case stmt_type::_function:
+            {
+              const auto& f = static_cast<const stmt_function<lox_obj>&>(s);
+              out << indent() << "rt.define(" << name(f.name) << ", rt.function(" << name(f.name) << ", "
+                  << f.parameters.size() << ", &function_" << function(f) << "));\n";
+            }
+            break; case stmt_type::_return:
+            {
+              const auto& r = static_cast<const stmt_return<lox_obj>&>(s);
+              const std::string value = r.value ? expression(*r.value) : "cwt::lox_obj()";
+              // outside of a function it unwinds the script like in the interpreter
+              if (m_in_function)
+              {
+                out << indent() << "return " << value << ";\n";
+              }
+              else
+              {
+                out << indent() << "throw cwt::lox_return(" << value << ");\n";
+              }
+            }
+            break; default: out << indent() << "rt.unsupported(\"stmt_visitor not implemented\");\n";
+          }
+        }
+
+        std::size_t function(const stmt_function<lox_obj>& f)
+        {
+          const std::size_t index = m_functions.size();
+          m_functions.emplace_back();
+
+          std::ostringstream body;
+          std::string prologue;
+          const bool in_function = m_in_function;
+          const std::size_t depth = m_depth;
+          m_in_function = true;
+          m_depth = 2;
+          for (std::size_t i = 0 ; i < f.parameters.size() ; ++i)
+          {
+            prologue += indent() + "rt.define(" + name(f.parameters[i]) + ", args[" + std::to_string(i) + "]);\n";
+          }
+          body << "  cwt::lox_obj function_" << index << "(cwt::aot_runtime& rt, std::span<const cwt::lox_obj> args)\n  {\n"
+               << "    // " << f.name << "\n";
+          scoped(f.body, body, prologue);
+          body << "    return cwt::lox_obj();\n  }\n";
+          m_in_function = in_function;
+          m_depth = depth;
+
+          m_functions[index] = body.str();
+          return index;
+        }
+
+        std::string expression(lox_expression<lox_obj>& e)
+        {
+          switch (e.type())
+          {
+            case expr_type::_grouping: return expression(*static_cast<const expr_grouping<lox_obj>&>(e).expr);
+            break; case expr_type::_cached: return expression(*static_cast<const expr_cached<lox_obj>&>(e).expr);
+            break; case expr_type::_literal: return literal(static_cast<const expr_literal<lox_obj>&>(e).value);
+            break; case expr_type::_variable:
+            {
+              return "rt.get(" + name(static_cast<const expr_variable<lox_obj>&>(e).name) + ", " + location(e.loc) + ")";
+            }
+            break; case expr_type::_assign:
+            {
+              const auto& a = static_cast<const expr_assign<lox_obj>&>(e);
+              return "rt.assign(" + name(a.name) + ", " + location(e.loc) + ", " + expression(*a.value) + ")";
+            }
+            break; case expr_type::_unary:
+            {
+              const auto& u = static_cast<const expr_unary<lox_obj>&>(e);
+              return "rt.unary(cwt::token_type::" + token_name(u.op) + ", " + location(e.loc) + ", " + expression(*u.right) + ")";
+            }
+            break; case expr_type::_binary:
+            {
+              const auto& b = static_cast<const expr_binary<lox_obj>&>(e);
+              return "rt.binary(cwt::token_type::" + token_name(b.op) + ", " + location(e.loc)
+                + ", cwt::aot_operands{" + expression(*b.left) + ", " + expression(*b.right) + "})";
+            }
+            break; case expr_type::_logical:
+            {
+              const auto& l = static_cast<const expr_logical<lox_obj>&>(e);
+              const std::string test = l.op == token_type::OR ? "rt.truthy(left)" : "!rt.truthy(left)";
+              return "[&]() -> cwt::lox_obj { cwt::lox_obj left = " + expression(*l.left) + "; if (" + test
+                + ") { return left; } return " + expression(*l.right) + "; }()";
+            }
+            break; case expr_type::_call:
+            {
+              const auto& c = static_cast<const expr_call<lox_obj>&>(e);
+              std::string s = "rt.call(" + location(e.loc) + ", cwt::aot_call<" + std::to_string(c.args.size()) + ">{"
+                + expression(*c.callee) + ", {";
+              for (std::size_t i = 0 ; i < c.args.size() ; ++i)
+              {
+                s.append(i ? ", " : "");
+                s.append(expression(*c.args[i]));
+              }
+              return s + "}})";
+            }
+            break; case expr_type::_array:
+            {
+              const auto& a = static_cast<const expr_array<lox_obj>&>(e);
+              std::string s = "rt.array(std::array<cwt::lox_obj, " + std::to_string(a.elements.size()) + ">{";
+              for (std::size_t i = 0 ; i < a.elements.size() ; ++i)
+              {
+                s.append(i ? ", " : "");
+                s.append(expression(*a.elements[i]));
+              }
+              return s + "})";
+            }
+            break; case expr_type::_map:
+            {
+              const auto& m = static_cast<const expr_map<lox_obj>&>(e);
+              std::string s = "rt.map(" + location(e.loc) + ", std::array<cwt::lox_obj, " + std::to_string(2 * m.keys.size()) + ">{";
+              for (std::size_t i = 0 ; i < m.keys.size() ; ++i)
+              {
+                s.append(i ? ", " : "");
+                s.append(expression(*m.keys[i]) + ", " + expression(*m.values[i]));
+              }
+              return s + "})";
+            }
+            break; case expr_type::_index:
+            {
+              const auto& i = static_cast<const expr_index<lox_obj>&>(e);
+              return "rt.index(" + location(e.loc) + ", cwt::aot_operands{" + expression(*i.obj) + ", " + expression(*i.index) + "})";
+            }
+            break; case expr_type::_index_set:
+            {
+              const auto& i = static_cast<const expr_index_set<lox_obj>&>(e);
+              return "rt.index_set(" + location(e.loc) + ", cwt::aot_store{" + expression(*i.obj) + ", " + expression(*i.index)
+                + ", " + expression(*i.value) + "})";
+            }
+            break; default: return "rt.unsupported(\"expr_visitor not implemented\")";
+          }
+        }
+
+        std::string literal(const lox_obj& value)
+        {
+          switch (value.type())
+          {
+            case value_type::number:
+            {
+              // hexadecimal, so the constant is the same double bit for bit
+              char buffer[64];
+              auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value.number(), std::chars_format::hex);
+              return "cwt::lox_obj(0x" + std::string(buffer, end) + ")";
+            }
+            break; case value_type::boolean: return value.boolean() ? "cwt::lox_obj(true)" : "cwt::lox_obj(false)";
+            break; case value_type::string:
+            {
+              m_strings.push_back(value.string());
+              return "cwt::create_another(string_" + std::to_string(m_strings.size() - 1) + ")";
+            }
+            break; default: return "cwt::lox_obj()";
+          }
+        }
+
+        std::string name(const std::string& n)
+        {
+          auto [it, inserted] = m_name_index.try_emplace(n, m_names.size());
+          if (inserted)
+          {
+            m_names.push_back(n);
+          }
+          return "name_" + std::to_string(it->second);
+        }
+
+      private:
+        std::vector<std::string> m_names;
+        std::unordered_map<std::string, std::size_t> m_name_index;
+        std::vector<std::string> m_strings;
+        std::vector<std::string> m_functions;
+        std::size_t m_depth = 0;
+        bool m_in_function = false;
+    };
+  }
+
+  void transpile(const std::vector<stmt_t>& statements, const source_map& sources, std::ostream& out)
+  {
+    transpiler t;
+    t.program(statements, sources, out);
+  }
+
+} // namespace cwt
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "source_map.hpp"
+#include "stmt.hpp"
+
+namespace cwt
+{
+  // writes a C++ translation unit with a main that runs statements like the
+  // interpreter does. it includes aot_runtime.hpp and links against the lox
+  // library. the files in sources are embedded, runtime errors show the
+  // same positions and excerpts as in the interpreter.
+  void transpile(const std::vector<std::unique_ptr<lox_statement<lox_obj>>>& statements, const source_map& sources, std::ostream& out);
+
+} // namespace cwt
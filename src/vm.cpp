@@ -0,0 +1,369 @@
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+#include "interpreter.hpp"
+#include "metrics.hpp"
+#include "vm.hpp"
+
+namespace cwt
+{
+  namespace
+  {
+    using expr_t = std::unique_ptr<lox_expression<lox_obj>>;
+    using stmt_t = std::unique_ptr<lox_statement<lox_obj>>;
+
+    constexpr std::uint32_t none = vm_instr::none;
+
+    // registers are handed out like a stack: a statement or an operator
+    // gives back everything its operands used once it has its result
+    class compiler
+    {
+      public:
+        compiler(vm_program& program) : m_program(program) {}
+
+        std::uint32_t chunk(std::string name, std::vector<std::string> parameters, const std::vector<stmt_t>& body, bool function)
+        {
+          const auto index = static_cast<std::uint32_t>(m_program.chunks.size());
+          m_program.chunks.push_back(vm_chunk{std::move(name), std::move(parameters)});
+
+          // nested functions add chunks, the code is kept here until the body is done
+          frame outer = std::exchange(m_frame, frame{});
+          m_frame.function = function;
+          statements(body);
+          emit(vm_instr{.op = vm_op::return_});
+
+          vm_chunk& c = m_program.chunks[index];
+          c.code = std::move(m_frame.code);
+          c.registers = m_frame.high;
+          m_frame = std::move(outer);
+          return index;
+        }
+
+      private:
+        void statements(const std::vector<stmt_t>& list)
+        {
+          for (const auto& s : list)
+          {
+            statement(s);
+          }
+        }
+
+        void statement(const stmt_t& s)
+        {
+          const std::uint32_t mark = m_frame.next;
+          switch (s->type())
+          {
+            case stmt_type::_expression:
+            {
+              operand(static_cast<const stmt_expression<lox_obj>&>(*s).expression);
+            }
+            break; case stmt_type::_print:
+            {
+              emit(vm_instr{.op = vm_op::print, .a = operand(static_cast<const stmt_print<lox_obj>&>(*s).expression), .loc = s->loc});
+            }
+            break; case stmt_type::_var:
+            {
+              const auto& v = static_cast<const stmt_var<lox_obj>&>(*s);
+              const std::uint32_t value = v.initializer ? operand(v.initializer) : none;
+              emit(vm_instr{.op = vm_op::define, .a = name(v.name), .b = value, .loc = s->loc});
+            }
+            break; case stmt_type::_block:
+            {
+              const std::uint32_t enter = emit(vm_instr{.op = vm_op::enter, .loc = s->loc});
+              statements(static_cast<const stmt_block<lox_obj>&>(*s).statements);
+              emit(vm_instr{.op = vm_op::leave, .loc = s->loc});
+              m_frame.code[enter].a = here();
+            }
+            break; case stmt_type::_if:
+            {
+              const auto& i = static_cast<const stmt_if<lox_obj>&>(*s);
+              const std::uint32_t skip_then = emit(vm_instr{.op = vm_op::jump_if_false, .a = operand(i.condition), .loc = s->loc});
+              m_frame.next = mark;
+              statements(i.then_branch);
+              if (i.else_branch.empty())
+              {
+                m_frame.code[skip_then].b = here();
+              }
+              else
+              {
+                const std::uint32_t skip_else = emit(vm_instr{.op = vm_op::jump, .loc = s->loc});
+                m_frame.code[skip_then].b = here();
+                statements(i.else_branch);
+                m_frame.code[skip_else].a = here();
+              }
+            }
+            break; case stmt_type::_while:
+            {
+              const auto& w = static_cast<const stmt_while<lox_obj>&>(*s);
+              const std::uint32_t top = here();
+              const std::uint32_t exit = emit(vm_instr{.op = vm_op::jump_if_false, .a = operand(w.condition), .loc = s->loc});
+              m_frame.next = mark;
+              statements(w.body);
+              emit(vm_instr{.op = vm_op::loop, .a = top, .loc = s->loc});
+              m_frame.code[exit].b = here();
+            }
+            break; case stmt_type::_function:
+            {
+              const auto& f = static_cast<const stmt_function<lox_obj>&>(*s);
+              const std::uint32_t body = chunk(f.name, f.parameters, f.body, true);
+              emit(vm_instr{.op = vm_op::function, .a = name(f.name), .b = body, .loc = s->loc});
+            }
+            break; case stmt_type::_return:
+            {
+              // outside of a function it unwinds the script, the tree walker knows how
+              if (!m_frame.function)
+              {
+                fallback(s);
+                break;
+              }
+              const auto& r = static_cast<const stmt_return<lox_obj>&>(*s);
+              emit(vm_instr{.op = vm_op::return_, .a = r.value ? operand(r.value) : none, .loc = s->loc});
+            }
+            break; default: fallback(s);
+          }
+          m_frame.next = mark;
+        }
+
+        void fallback(const stmt_t& s)
+        {
+          m_program.statements.push_back(&s);
+          emit(vm_instr{.op = vm_op::statement, .a = static_cast<std::uint32_t>(m_program.statements.size() - 1), .loc = s->loc});
+        }
+
+        // the result is in target if there is one, otherwise in a register
+        // of its own or, for literals, a constant
+        std::uint32_t operand(const expr_t& e, std::uint32_t target = none)
+        {
+          const std::uint32_t mark = m_frame.next;
+          switch (e->type())
+          {
+            case expr_type::_grouping: return operand(static_cast<const expr_grouping<lox_obj>&>(*e).expr, target);
+            break; case expr_type::_cached: return operand(static_cast<const expr_cached<lox_obj>&>(*e).expr, target);
+            break; case expr_type::_literal:
+            {
+              const auto index = static_cast<std::uint32_t>(m_program.constants.size());
+              m_program.constants.push_back(create_another(static_cast<const expr_literal<lox_obj>&>(*e).value));
+              if (target == none)
+              {
+                return index | vm_constant;
+              }
+              emit(vm_instr{.op = vm_op::move, .a = target, .b = index | vm_constant, .loc = e->loc});
+              return target;
+            }
+            break; case expr_type::_variable:
+            {
+              const std::uint32_t dst = destination(target);
+              emit(vm_instr{.op = vm_op::get, .a = dst, .b = name(static_cast<const expr_variable<lox_obj>&>(*e).name), .loc = e->loc});
+              return dst;
+            }
+            break; case expr_type::_assign:
+            {
+              const auto& a = static_cast<const expr_assign<lox_obj>&>(*e);
+              const std::uint32_t value = operand(a.value, target);
+              emit(vm_instr{.op = vm_op::set, .a = name(a.name), .b = value, .loc = e->loc});
+              return value;
+            }
+            break; case expr_type::_unary:
+            {
+              const auto& u = static_cast<const expr_unary<lox_obj>&>(*e);
+              const std::uint32_t right = operand(u.right);
+              m_frame.next = mark;
+              const std::uint32_t dst = destination(target);
+              emit(vm_instr{.op = vm_op::unary, .token = u.op, .a = dst, .b = right, .loc = e->loc});
+              return dst;
+            }
+            break; case expr_type::_binary:
+            {
+              const auto& b = static_cast<const expr_binary<lox_obj>&>(*e);
+              const std::uint32_t left = operand(b.left);
+              const std::uint32_t right = operand(b.right);
+              m_frame.next = mark;
+              const std::uint32_t dst = destination(target);
+              emit(vm_instr{.op = vm_op::binary, .token = b.op, .a = dst, .b = left, .c = right, .loc = e->loc});
+              return dst;
+            }
+            break; case expr_type::_logical:
+            {
+              const auto& l = static_cast<const expr_logical<lox_obj>&>(*e);
+              const std::uint32_t dst = destination(target);
+              const std::uint32_t inner = m_frame.next;
+              operand(l.left, dst);
+              const vm_op skip = l.op == token_type::OR ? vm_op::jump_if_true : vm_op::jump_if_false;
+              const std::uint32_t jump = emit(vm_instr{.op = skip, .a = dst, .loc = e->loc});
+              m_frame.next = inner;
+              operand(l.right, dst);
+              m_frame.next = inner;
+              m_frame.code[jump].b = here();
+              return dst;
+            }
+            break; case expr_type::_call:
+            {
+              const auto& c = static_cast<const expr_call<lox_obj>&>(*e);
+              const std::uint32_t callee = allocate();
+              for (std::size_t i = 0 ; i < c.args.size() ; ++i)
+              {
+                allocate();
+              }
+              operand(c.callee, callee);
+              for (std::size_t i = 0 ; i < c.args.size() ; ++i)
+              {
+                operand(c.args[i], callee + 1 + static_cast<std::uint32_t>(i));
+              }
+              m_frame.next = mark;
+              const std::uint32_t dst = destination(target);
+              emit(vm_instr{.op = vm_op::call, .a = dst, .b = callee, .c = static_cast<std::uint32_t>(c.args.size()), .loc = e->loc});
+              return dst;
+            }
+            break; case expr_type::_array:
+            {
+              const auto& a = static_cast<const expr_array<lox_obj>&>(*e);
+              const std::uint32_t first = m_frame.next;
+              for (std::size_t i = 0 ; i < a.elements.size() ; ++i)
+              {
+                allocate();
+              }
+              for (std::size_t i = 0 ; i < a.elements.size() ; ++i)
+              {
+                operand(a.elements[i], first + static_cast<std::uint32_t>(i));
+              }
+              m_frame.next = mark;
+              const std::uint32_t dst = destination(target);
+              emit(vm_instr{.op = vm_op::array, .a = dst, .b = first, .c = static_cast<std::uint32_t>(a.elements.size()), .loc = e->loc});
+              return dst;
+            }
+            break; case expr_type::_map:
+            {
+              const auto& m = static_cast<const expr_map<lox_obj>&>(*e);
+              const std::uint32_t first = m_frame.next;
+              for (std::size_t i = 0 ; i < 2 * m.keys.size() ; ++i)
+              {
+                allocate();
+              }
+              for (std::size_t i = 0 ; i < m.keys.size() ; ++i)
+              {
+                operand(m.keys[i], first + 2 * static_cast<std::uint32_t>(i));
+                operand(m.values[i], first + 2 * static_cast<std::uint32_t>(i) + 1);
+              }
+              m_frame.next = mark;
+              const std::uint32_t dst = destination(target);
+              emit(vm_instr{.op = vm_op::map, .a = dst, .b = first, .c = static_cast<std::uint32_t>(m.keys.size()), .loc = e->loc});
+              return dst;
+            }
+            break; case expr_type::_index:
+            {
+              const auto& i = static_cast<const expr_index<lox_obj>&>(*e);
+              const std::uint32_t obj = operand(i.obj);
+              const std::uint32_t index = operand(i.index);
+              m_frame.next = mark;
+              const std::uint32_t dst = destination(target);
+              emit(vm_instr{.op = vm_op::index, .a = dst, .b = obj, .c = index, .loc = e->loc});
+              return dst;
+            }
+            break; case expr_type::_index_set:
+            {
+              // the operands stay allocated until the store, the value may go to target
+              const auto& i = static_cast<const expr_index_set<lox_obj>&>(*e);
+              const std::uint32_t obj = operand(i.obj);
+              const std::uint32_t index = operand(i.index);
+              const std::uint32_t value = operand(i.value, target);
+              emit(vm_instr{.op = vm_op::index_set, .a = obj, .b = index, .c = value, .loc = e->loc});
+              return value;
+            }
+            break; default:
+            {
+              m_program.expressions.push_back(&e);
+              const std::uint32_t dst = destination(target);
+              emit(vm_instr{.op = vm_op::expression, .a = dst, .b = static_cast<std::uint32_t>(m_program.expressions.size() - 1), .loc = e->loc});
+              return dst;
+            }
+          }
+        }
+
+        std::uint32_t allocate()
+        {
+          const std::uint32_t r = m_frame.next++;
+          m_frame.high = std::max(m_frame.high, m_frame.next);
+          return r;
+        }
+
+        std::uint32_t destination(std::uint32_t target)
+        {
+          return target != none ? target : allocate();
+        }
+
+        std::uint32_t emit(const vm_instr& i)
+        {
+          m_frame.code.push_back(i);
+          return static_cast<std::uint32_t>(m_frame.code.size() - 1);
+        }
+
+        std::uint32_t here() const
+        {
+          return static_cast<std::uint32_t>(m_frame.code.size());
+        }
+
+        std::uint32_t name(const std::string& n)
+        {
+          auto [it, inserted] = m_names.try_emplace(n, static_cast<std::uint32_t>(m_program.names.size()));
+          if (inserted)
+          {
+            m_program.names.push_back(n);
+          }
+          return it->second;
+        }
+
+      private:
+        struct frame
+        {
+          std::vector<vm_instr> code;
+          std::uint32_t next = 0;
+          std::uint32_t high = 0;
+          bool function = false;
+        };
+
+        vm_program& m_program;
+        frame m_frame;
+        std::unordered_map<std::string, std::uint32_t> m_names;
+    };
+  }
+
+  vm_program compile(const std::vector<stmt_t>& statements)
+  {
+    vm_program program;
+    compiler c(program);
+    c.chunk("script", {}, statements, false);
+    return program;
+  }
+
+  vm_function::vm_function(const vm_program* program, std::uint32_t chunk)
+  : m_program(program), m_chunk(chunk)
+  {
+  }
+  std::string vm_function::to_string()
+  {
+    std::string s{"<fn "};
+    s.append(m_program->chunks[m_chunk].name);
+    s.append(">");
+    return s;
+  }
+  std::size_t vm_function::arity()
+  {
+    return m_program->chunks[m_chunk].parameters.size();
+  }
+
+  lox_obj vm_function::call(interpreter& interpreter, std::span<const lox_obj> args)
+  {
+    const vm_chunk& chunk = m_program->chunks[m_chunk];
+    profile_scope scope(interpreter.get_profiler(), chunk.name);
+    LOX_COUNT(function_calls);
+    auto env = std::make_unique<environment>();
+    env->set_enclosing(interpreter.get_env_ptr());
+    for (std::size_t i = 0 ; i < chunk.parameters.size() ; ++i)
+    {
+      env->define(chunk.parameters[i], args[i]);
+    }
+    return interpreter.execute(*m_program, m_chunk, std::move(env));
+  }
+
+} // namespace cwt
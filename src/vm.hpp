@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "lox_callable.hpp"
+#include "lox_obj.hpp"
+#include "stmt.hpp"
+
+namespace cwt
+{
+  enum class vm_op : std::uint8_t
+  {
+    move = 0, get, set, define, unary, binary, jump, loop, jump_if_false, jump_if_true,
+    call, array, map, index, index_set, print, function, enter, leave, return_, statement, expression
+  };
+
+  // operands with this bit set index vm_program::constants, registers otherwise
+  constexpr std::uint32_t vm_constant = 0x80000000u;
+
+  // three address code over the registers of a frame. what a, b and c
+  // hold depends on op:
+  //
+  //   move           a: dst, b: operand
+  //   get            a: dst, b: name
+  //   set            a: name, b: operand
+  //   define         a: name, b: operand or none
+  //   unary          a: dst, b: operand
+  //   binary         a: dst, b: left operand, c: right operand
+  //   jump           a: target
+  //   loop           a: target, a jump back to the condition of a while
+  //   jump_if_false  a: operand, b: target    (jump_if_true too)
+  //   call           a: dst, b: callee register, the arguments follow it, c: argument count
+  //   array          a: dst, b: first element register, c: element count
+  //   map            a: dst, b: first register, each key is followed by its value, c: entry count
+  //   index          a: dst, b: array operand, c: index operand
+  //   index_set      a: array operand, b: index operand, c: value operand
+  //   print          a: operand
+  //   function       a: name, b: chunk
+  //   enter          a: where to go on a runtime error, after the matching leave
+  //   return_        a: operand or none
+  //   statement      a: statement run by the tree walker
+  //   expression     a: dst, b: expression evaluated by the tree walker
+  struct vm_instr
+  {
+    static constexpr std::uint32_t none = UINT32_MAX;
+
+    vm_op op;
+    // binary only
+    mutable type_feedback feedback = type_feedback::none;
+    token_type token = token_type::NIL;
+    std::uint32_t a = none;
+    std::uint32_t b = none;
+    std::uint32_t c = none;
+    source_loc loc;
+  };
+
+  struct vm_chunk
+  {
+    std::string name;
+    std::vector<std::string> parameters;
+    std::vector<vm_instr> code;
+    std::uint32_t registers = 0;
+  };
+
+  // chunk 0 is the script itself. statements and expressions the compiler
+  // does not know point back into the tree, which has to outlive the program.
+  struct vm_program
+  {
+    std::vector<vm_chunk> chunks;
+    std::vector<lox_obj> constants;
+    std::vector<std::string> names;
+    std::vector<const std::unique_ptr<lox_statement<lox_obj>>*> statements;
+    std::vector<const std::unique_ptr<lox_expression<lox_obj>>*> expressions;
+  };
+
+  vm_program compile(const std::vector<std::unique_ptr<lox_statement<lox_obj>>>& statements);
+
+  class vm_function : public lox_callable
+  {
+    public:
+      vm_function(const vm_program* program, std::uint32_t chunk);
+      std::string to_string() override;
+      std::size_t arity() override;
+      lox_obj call(interpreter& interpreter, std::span<const lox_obj> args) override;
+
+    private:
+      const vm_program* m_program;
+      std::uint32_t m_chunk;
+  };
+
+} // namespace cwt
@@ -0,0 +1,156 @@
+#include "interpreter.hpp"
+
+namespace cwt
+{
+
+void interpreter::interpret(const vm_program& program)
+{
+  try
+  {
+    run(program, program.chunks.front());
+    m_scheduler.run();
+  }
+  catch(const std::exception& e)
+  {
+    report_runtime_error(e, m_sources);
+  }
+  catch(const budget_exhausted& e)
+  {
+    m_scheduler.cancel();
+    report_budget_exhausted(e, m_sources);
+  }
+}
+
+lox_obj interpreter::execute(const vm_program& program, std::uint32_t chunk, std::unique_ptr<environment> new_env)
+{
+  lox_obj result;
+  scoped(std::move(new_env), [&]() { result = run(program, program.chunks[chunk]); });
+  return result;
+}
+
+lox_obj interpreter::run(const vm_program& program, const vm_chunk& chunk)
+{
+  inline_buffer<16> window(chunk.registers);
+  const std::span<lox_obj> registers = window.values();
+  auto value = [&](std::uint32_t operand) -> const lox_obj&
+  {
+    return (operand & vm_constant) ? program.constants[operand & ~vm_constant] : registers[operand];
+  };
+
+  // blocks entered by this frame. a runtime error ends the innermost one
+  // and is reported, like the tree walker does in scoped. anything else
+  // leaving the frame, budget_exhausted and a cancelled fiber included,
+  // gives the environments back first
+  struct scope
+  {
+    std::unique_ptr<environment> outer;
+    std::uint32_t resume;
+  };
+  std::vector<scope> scopes;
+  auto leave = [this, &scopes]()
+  {
+    m_env = std::move(scopes.back().outer);
+    scopes.pop_back();
+  };
+  auto leave_all = [&]()
+  {
+    while (!scopes.empty())
+    {
+      leave();
+    }
+  };
+  finally restore([&leave_all]() { leave_all(); });
+
+  const vm_instr* const code = chunk.code.data();
+  std::uint32_t pc = 0;
+  for (;;)
+  {
+    try
+    {
+      for (;;)
+      {
+        const vm_instr& i = code[pc++];
+        switch (i.op)
+        {
+          case vm_op::move: registers[i.a] = create_another(value(i.b));
+          break; case vm_op::get:
+          {
+            LOX_COUNT(lookups);
+            registers[i.a] = create_another(m_env->get(program.names[i.b], i.loc));
+          }
+          break; case vm_op::set:
+          {
+            LOX_COUNT(assignments);
+            m_env->assign(program.names[i.a], i.loc, value(i.b));
+          }
+          break; case vm_op::define:
+          {
+            if (i.b != vm_instr::none)
+            {
+              m_env->define(program.names[i.a], value(i.b));
+            }
+            else
+            {
+              m_env->define(program.names[i.a], lox_obj());
+            }
+          }
+          break; case vm_op::unary: registers[i.a] = unary(i.token, i.loc, value(i.b));
+          break; case vm_op::binary: registers[i.a] = binary(i.token, i.loc, value(i.b), value(i.c), i.feedback);
+          break; case vm_op::jump: pc = i.a;
+          break; case vm_op::loop:
+          {
+            if (m_meter)
+            {
+              m_meter->step(i.loc);
+            }
+            pc = i.a;
+          }
+          break; case vm_op::jump_if_false: if (!is_truthy(value(i.a))) { pc = i.b; }
+          break; case vm_op::jump_if_true: if (is_truthy(value(i.a))) { pc = i.b; }
+          break; case vm_op::call: registers[i.a] = call(registers[i.b], registers.subspan(i.b + 1, i.c), i.loc);
+          break; case vm_op::array: registers[i.a] = make_array(registers.subspan(i.b, i.c));
+          break; case vm_op::map: registers[i.a] = make_map(registers.subspan(i.b, 2 * i.c), i.loc);
+          break; case vm_op::index: registers[i.a] = index(value(i.b), value(i.c), i.loc);
+          break; case vm_op::index_set: index_set(value(i.a), value(i.b), value(i.c), i.loc);
+          break; case vm_op::print: *m_out << value(i.a).to_string() << std::endl;
+          break; case vm_op::function:
+          {
+            std::shared_ptr<lox_callable> f = std::make_shared<vm_function>(&program, i.b);
+            m_env->define(program.names[i.a], lox_obj(std::move(f)));
+          }
+          break; case vm_op::enter:
+          {
+            scopes.push_back(scope{std::move(m_env), i.a});
+            m_env = std::make_unique<environment>();
+            m_env->set_enclosing(scopes.back().outer.get());
+          }
+          break; case vm_op::leave: leave();
+          break; case vm_op::return_:
+          {
+            lox_obj result = i.a != vm_instr::none ? create_another(value(i.a)) : lox_obj();
+            leave_all();
+            return result;
+          }
+          break; case vm_op::statement: execute(*program.statements[i.a]);
+          break; case vm_op::expression: registers[i.a] = evaluate(*program.expressions[i.b]);
+        }
+      }
+    }
+    catch(const lox_return&)
+    {
+      throw;
+    }
+    catch(const std::exception& e)
+    {
+      if (scopes.empty())
+      {
+        throw;
+      }
+      pc = scopes.back().resume;
+      leave();
+      report_runtime_error(e, m_sources);
+    }
+  }
+}
+
+} // namespace cwt
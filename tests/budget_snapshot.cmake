@@ -0,0 +1,20 @@
+# runs SCRIPT through EXAMPLE with FLAGS until its budget runs out and saves
+# a snapshot, then runs CHECK on the loaded snapshot. fails unless the first
+# run reports the budget and CHECK prints EXPECTED.
+#   cmake -DEXAMPLE=<path> -DSCRIPT=<path> -DCHECK=<path> -DFLAGS=... -DEXPECTED=<regex> -DIMAGE=<path> -P budget_snapshot.cmake
+
+file(REMOVE ${IMAGE})
+execute_process(COMMAND ${EXAMPLE} ${FLAGS} --save-snapshot=${IMAGE} ${SCRIPT}
+    OUTPUT_VARIABLE output ERROR_VARIABLE diagnostics RESULT_VARIABLE status)
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "${SCRIPT}: exit status ${status} with '${FLAGS}'\n${diagnostics}")
+endif()
+if(NOT diagnostics MATCHES "\\[BUDGET\\]")
+    message(FATAL_ERROR "${SCRIPT}: no budget reported with '${FLAGS}'\n${diagnostics}")
+endif()
+
+execute_process(COMMAND ${EXAMPLE} --load-snapshot=${IMAGE} ${CHECK}
+    OUTPUT_VARIABLE output ERROR_VARIABLE diagnostics RESULT_VARIABLE status)
+if(NOT status EQUAL 0 OR NOT output MATCHES "${EXPECTED}")
+    message(FATAL_ERROR "${CHECK}: the snapshot of ${SCRIPT} gave\n${output}${diagnostics}")
+endif()
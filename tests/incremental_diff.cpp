@@ -0,0 +1,240 @@
+// differential check of incremental_program against a parse of the whole
+// text: after every random edit both have to give the same syntax trees,
+// with the same line and column on every node, and the same diagnostics.
+// the text starts out as the files named on the command line, one after
+// another, and the edits paste in fragments that break and mend it.
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "error.hpp"
+#include "incremental.hpp"
+#include "parser.hpp"
+#include "scanner.hpp"
+
+namespace
+{
+  using stmt_t = std::unique_ptr<cwt::lox_statement<cwt::lox_obj>>;
+  using expr_t = std::unique_ptr<cwt::lox_expression<cwt::lox_obj>>;
+
+  // one line per node: kind, position and whatever is not a child
+  class dumper : public cwt::expr_visitor<cwt::lox_obj>, public cwt::stmt_visitor<cwt::lox_obj>
+  {
+    public:
+      explicit dumper(const cwt::source_map& sources) : m_sources(sources) {}
+
+      std::string dump(const std::vector<stmt_t>& statements)
+      {
+        m_out.str("");
+        statements_of(statements);
+        return m_out.str();
+      }
+
+      cwt::lox_obj visit(const cwt::expr_assign<cwt::lox_obj>& e) override { node("assign", e.loc, e.name); child(e.value); return {}; }
+      cwt::lox_obj visit(const cwt::expr_binary<cwt::lox_obj>& e) override { node("binary", e.loc, op(e.op)); child(e.left); child(e.right); return {}; }
+      cwt::lox_obj visit(const cwt::expr_call<cwt::lox_obj>& e) override { node("call", e.loc); child(e.callee); children(e.args); return {}; }
+      cwt::lox_obj visit(const cwt::expr_get<cwt::lox_obj>& e) override { node("get", e.loc, e.name); child(e.obj); return {}; }
+      cwt::lox_obj visit(const cwt::expr_grouping<cwt::lox_obj>& e) override { node("grouping", e.loc); child(e.expr); return {}; }
+      cwt::lox_obj visit(const cwt::expr_literal<cwt::lox_obj>& e) override { node("literal", e.loc, e.value.to_string()); return {}; }
+      cwt::lox_obj visit(const cwt::expr_logical<cwt::lox_obj>& e) override { node("logical", e.loc, op(e.op)); child(e.left); child(e.right); return {}; }
+      cwt::lox_obj visit(const cwt::expr_set<cwt::lox_obj>& e) override { node("set", e.loc, e.name); child(e.obj); child(e.value); return {}; }
+      cwt::lox_obj visit(const cwt::expr_super<cwt::lox_obj>& e) override { node("super", e.loc, e.method); return {}; }
+      cwt::lox_obj visit(const cwt::expr_this<cwt::lox_obj>& e) override { node("this", e.loc); return {}; }
+      cwt::lox_obj visit(const cwt::expr_unary<cwt::lox_obj>& e) override { node("unary", e.loc, op(e.op)); child(e.right); return {}; }
+      cwt::lox_obj visit(const cwt::expr_variable<cwt::lox_obj>& e) override { node("variable", e.loc, e.name); return {}; }
+      cwt::lox_obj visit(const cwt::expr_array<cwt::lox_obj>& e) override { node("array", e.loc); children(e.elements); return {}; }
+      cwt::lox_obj visit(const cwt::expr_index<cwt::lox_obj>& e) override { node("index", e.loc); child(e.obj); child(e.index); return {}; }
+      cwt::lox_obj visit(const cwt::expr_index_set<cwt::lox_obj>& e) override { node("index_set", e.loc); child(e.obj); child(e.index); child(e.value); return {}; }
+      cwt::lox_obj visit(const cwt::expr_map<cwt::lox_obj>& e) override { node("map", e.loc); children(e.keys); children(e.values); return {}; }
+
+      void visit(const cwt::stmt_block<cwt::lox_obj>& s) override { node("block", s.loc); nested(s.statements); }
+      void visit(const cwt::stmt_class<cwt::lox_obj>& s) override
+      {
+        node("class", s.loc, s.name);
+        if (s.superclass) { child(s.superclass); }
+        ++m_depth;
+        for (auto* method : s.methods)
+        {
+          method->accept(*this);
+        }
+        --m_depth;
+      }
+      void visit(const cwt::stmt_expression<cwt::lox_obj>& s) override { node("expression", s.loc); child(s.expression); }
+      void visit(const cwt::stmt_function<cwt::lox_obj>& s) override
+      {
+        std::string signature = s.name + "(";
+        for (const std::string& p : s.parameters)
+        {
+          signature.append(p).append(",");
+        }
+        node("function", s.loc, signature + ")");
+        nested(s.body);
+      }
+      void visit(const cwt::stmt_if<cwt::lox_obj>& s) override { node("if", s.loc); child(s.condition); nested(s.then_branch); node("else", s.loc); nested(s.else_branch); }
+      void visit(const cwt::stmt_print<cwt::lox_obj>& s) override { node("print", s.loc); child(s.expression); }
+      void visit(const cwt::stmt_return<cwt::lox_obj>& s) override { node("return", s.loc); if (s.value) { child(s.value); } }
+      void visit(const cwt::stmt_var<cwt::lox_obj>& s) override { node("var", s.loc, s.name); if (s.initializer) { child(s.initializer); } }
+      void visit(const cwt::stmt_while<cwt::lox_obj>& s) override { node("while", s.loc); child(s.condition); nested(s.body); }
+
+    private:
+      static std::string op(cwt::token_type t) { return std::to_string(static_cast<int>(t)); }
+
+      void node(const char* kind, cwt::source_loc loc, const std::string& detail = {})
+      {
+        m_out << std::string(2 * m_depth, ' ') << kind << ' ' << m_sources.describe(loc) << ' ' << detail << '\n';
+      }
+      void child(const expr_t& e)
+      {
+        ++m_depth;
+        e->accept(*this);
+        --m_depth;
+      }
+      void children(const std::vector<expr_t>& list)
+      {
+        for (const expr_t& e : list)
+        {
+          child(e);
+        }
+      }
+      void statements_of(const std::vector<stmt_t>& statements)
+      {
+        for (const stmt_t& s : statements)
+        {
+          s->accept(*this);
+        }
+      }
+      void nested(const std::vector<stmt_t>& statements)
+      {
+        ++m_depth;
+        statements_of(statements);
+        --m_depth;
+      }
+
+      const cwt::source_map& m_sources;
+      std::ostringstream m_out;
+      std::size_t m_depth = 0;
+  };
+
+  struct full_parse
+  {
+    cwt::source_map sources;
+    std::vector<stmt_t> statements;
+    std::string diagnostics;
+  };
+
+  void parse_whole(const std::string& text, full_parse& out)
+  {
+    std::ostringstream diagnostics;
+    cwt::error_state state;
+    state.diagnostics = &diagnostics;
+    cwt::scoped_error_state scope(state);
+    const cwt::token_stream tokens = cwt::scanner(text).scan_stream();
+    cwt::parser<cwt::lox_obj> p(tokens, out.sources.add("input", text));
+    out.statements = p.parse();
+    out.diagnostics = diagnostics.str();
+  }
+
+  // what an edit pastes in: pieces of declarations, the tokens that pair up
+  // and the ones that start a comment or string to the end of the line
+  const std::vector<std::string> fragments = {
+    "", "", "", "\n", "\n\n", " ", ";", "{", "}", "(", ")", "[", "]", ",", ".", "=", "+", "\"", "#", "/",
+    "else", "if (x) ", "else print 2;", "var a = 1;\n", "fun f(a, b) {\n  return a + b;\n}\n",
+    "print \"two\nlines\";\n", "class C {\n  m() { return this; }\n}\n", "while (i < 3) i = i + 1;\n",
+    "{ var inner = [1, 2, {\"k\": 3}]; }\n", "# a comment\n", "return;", "@", "x", "123.5", "\r\n",
+  };
+} // namespace
+
+int main(int argc, char** argv)
+{
+  std::string corpus;
+  for (int i = 1 ; i < argc ; ++i)
+  {
+    std::ifstream in(argv[i], std::ios::binary);
+    if (!in)
+    {
+      std::cerr << "cannot read " << argv[i] << '\n';
+      return 2;
+    }
+    std::ostringstream text;
+    text << in.rdbuf();
+    corpus.append(text.str());
+  }
+
+  constexpr std::uint32_t seeds = 20;
+  constexpr std::size_t edits = 400;
+  std::size_t failures = 0;
+  for (std::uint32_t seed = 1 ; seed <= seeds && failures == 0 ; ++seed)
+  {
+    // the engine is the same everywhere, the distributions are not
+    std::mt19937 rng(seed);
+    const auto below = [&rng](std::size_t n) { return n == 0 ? 0 : static_cast<std::size_t>(rng() % n); };
+
+    cwt::source_map sources;
+    cwt::incremental_program program(sources, "input", corpus);
+    for (std::size_t n = 0 ; n < edits ; ++n)
+    {
+      const std::string& text = program.text();
+      const std::size_t begin = below(text.size() + 1);
+      // mostly small edits, now and then a large cut
+      const std::size_t length = below(8) == 0 ? below(text.size() - begin + 1) : below(std::min<std::size_t>(text.size() - begin, 12) + 1);
+      std::string replacement = fragments[below(fragments.size())];
+      if (below(6) == 0)
+      {
+        // a piece of the corpus
+        const std::size_t from = below(corpus.size());
+        replacement = corpus.substr(from, below(200));
+      }
+      program.edit(begin, begin + length, replacement);
+
+      full_parse whole;
+      parse_whole(program.text(), whole);
+      const std::string expected = dumper(whole.sources).dump(whole.statements);
+      const std::string actual = dumper(sources).dump(program.statements());
+      std::string difference;
+      if (expected != actual)
+      {
+        difference = "trees differ:\n" + expected + "---\n" + actual;
+      }
+      else if (whole.diagnostics != program.diagnostics())
+      {
+        difference = "diagnostics differ:\n" + whole.diagnostics + "---\n" + program.diagnostics();
+      }
+      else if (program.ok() != whole.diagnostics.empty())
+      {
+        difference = "ok() is wrong";
+      }
+      else
+      {
+        // replaced text leaves the source map, what is left is the text
+        std::size_t mapped = 0;
+        for (const auto& [name, piece] : sources.files())
+        {
+          mapped += piece.size();
+        }
+        if (mapped != program.text().size())
+        {
+          difference = "the source map holds " + std::to_string(mapped) + " bytes for " + std::to_string(program.text().size());
+        }
+      }
+      if (!difference.empty())
+      {
+        ++failures;
+        std::cout << "seed " << seed << ", edit " << n << " [" << begin << ", " << begin + length << ") -> \""
+                  << replacement << "\": " << difference << '\n';
+        break;
+      }
+    }
+  }
+  if (failures)
+  {
+    return 1;
+  }
+  std::cout << seeds << " seeds of " << edits << " edits compared\n";
+  return 0;
+}
@@ -0,0 +1,19 @@
+# runs SCRIPT through EXAMPLE twice, with REFERENCE and with FLAGS, and
+# fails unless both print the same. both are lists of command line flags.
+# FORBIDDEN is a regex the diagnostics of the FLAGS run must not match.
+#   cmake -DEXAMPLE=<path> -DSCRIPT=<path> [-DREFERENCE=...] -DFLAGS=... [-DFORBIDDEN=...] -P same_output.cmake
+
+execute_process(COMMAND ${EXAMPLE} ${REFERENCE} ${SCRIPT}
+    OUTPUT_VARIABLE expected RESULT_VARIABLE expected_status)
+execute_process(COMMAND ${EXAMPLE} ${FLAGS} ${SCRIPT}
+    OUTPUT_VARIABLE actual ERROR_VARIABLE diagnostics RESULT_VARIABLE actual_status)
+
+if(NOT expected_status EQUAL actual_status)
+    message(FATAL_ERROR "${SCRIPT}: exit status ${actual_status} with '${FLAGS}', ${expected_status} with '${REFERENCE}'")
+endif()
+if(NOT expected STREQUAL actual)
+    message(FATAL_ERROR "${SCRIPT}: output with '${FLAGS}' differs from '${REFERENCE}'\n--- ${REFERENCE}\n${expected}\n--- ${FLAGS}\n${actual}")
+endif()
+if(FORBIDDEN AND diagnostics MATCHES "${FORBIDDEN}")
+    message(FATAL_ERROR "${SCRIPT}: '${FLAGS}' reported\n${diagnostics}")
+endif()
@@ -0,0 +1,191 @@
+// differential check of fast_scanner against scanner: both have to give the
+// same tokens, lines and errors on every kernel set, serial and chunked on a
+// pool. the inputs are the files named on the command line and generated
+// edge cases around the 16 and 32 byte blocks of the kernels.
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "error.hpp"
+#include "fast_scanner.hpp"
+#include "scanner.hpp"
+#include "simd_scan.hpp"
+#include "thread_pool.hpp"
+
+namespace
+{
+  struct input
+  {
+    std::string name;
+    std::string text;
+  };
+
+  struct scanned
+  {
+    cwt::token_stream tokens;
+    std::string errors;
+  };
+
+  template<typename Scan>
+  scanned capture(Scan&& scan)
+  {
+    std::ostringstream errors;
+    cwt::error_state state;
+    state.diagnostics = &errors;
+    cwt::scoped_error_state scope(state);
+    scanned result{scan(), {}};
+    result.errors = errors.str();
+    return result;
+  }
+
+  std::string describe(const cwt::token_stream& s, std::size_t i)
+  {
+    if (i >= s.size())
+    {
+      return "<none>";
+    }
+    std::ostringstream out;
+    out << "type " << static_cast<int>(s.type(i)) << " '" << s.lexeme(i) << "' at " << s.offset(i) << " line " << s.line(i);
+    return out.str();
+  }
+
+  // empty if both agree
+  std::string compare(const scanned& expected, const scanned& actual)
+  {
+    if (expected.errors != actual.errors)
+    {
+      return "errors differ:\n" + expected.errors + "---\n" + actual.errors;
+    }
+    const std::size_t n = std::max(expected.tokens.size(), actual.tokens.size());
+    for (std::size_t i = 0 ; i < n ; ++i)
+    {
+      const cwt::token_stream& e = expected.tokens;
+      const cwt::token_stream& a = actual.tokens;
+      if (i >= e.size() || i >= a.size() || e.type(i) != a.type(i) || e.offset(i) != a.offset(i)
+        || e.lexeme(i) != a.lexeme(i) || e.line(i) != a.line(i))
+      {
+        return "token " + std::to_string(i) + ": expected " + describe(e, i) + ", got " + describe(a, i);
+      }
+    }
+    return {};
+  }
+
+  std::string replace_newlines(const std::string& s, const std::string& with)
+  {
+    std::string out;
+    for (const char c : s)
+    {
+      if (c == '\n') { out.append(with); }
+      else { out.push_back(c); }
+    }
+    return out;
+  }
+
+  std::vector<input> edge_cases(const std::vector<input>& files)
+  {
+    std::vector<input> cases;
+    // every offset up to past the second 32 byte block
+    for (std::size_t at = 0 ; at <= 70 ; ++at)
+    {
+      const std::string n = std::to_string(at);
+      cases.push_back({"unterminated string at " + n, std::string(at, ' ') + "\"never closed"});
+      cases.push_back({"unterminated string over lines at " + n, std::string(at, 'a') + " \"first\nsecond\nthird"});
+      cases.push_back({"string ends at " + n, "\"" + std::string(at, 'q') + "\" x"});
+      cases.push_back({"lone slash after spaces at " + n, std::string(at, ' ') + "/"});
+      cases.push_back({"lone slash after identifier at " + n, std::string(at, 'x') + "/"});
+      cases.push_back({"slash between numbers at " + n, std::string(at, '1') + "/2."});
+      cases.push_back({"slash before comment at " + n, "a" + std::string(at, ' ') + "/\n# comment / here\n/"});
+      cases.push_back({"crlf at " + n, std::string(at, ' ') + "\r\nvar x\r\n= 1;\r\n"});
+      cases.push_back({"crlf in string at " + n, "print \"" + std::string(at, 's') + "\r\n\";\r\n"});
+      cases.push_back({"crlf after comment at " + n, "# " + std::string(at, 'c') + "\r\nprint 1;"});
+      cases.push_back({"unexpected character at " + n, std::string(at, 'v') + "@" + std::string(at % 7, ' ') + "$"});
+    }
+    cases.push_back({"empty", ""});
+    cases.push_back({"only a comment", "# no newline at the end"});
+    cases.push_back({"number with trailing dot", "123."});
+
+    for (const input& f : files)
+    {
+      cases.push_back({f.name + " with crlf", replace_newlines(f.text, "\r\n")});
+    }
+
+    // big enough to be split into chunks on the pool, with strings running
+    // over the line ends the chunks are cut at
+    std::string big;
+    for (std::size_t round = 0 ; big.size() < 1024 * 1024 ; ++round)
+    {
+      for (const input& f : files)
+      {
+        big.append(f.text);
+        big.append("\nvar s" + std::to_string(round) + " = \"spans\n" + std::string(round % 80, 'l') + "\nlines\";\r\n");
+      }
+      if (files.empty())
+      {
+        big.append("var a = 1;\n");
+      }
+    }
+    cases.push_back({"concatenated inputs", big});
+    cases.push_back({"concatenated inputs, unterminated", big + "\"open\n" + big.substr(0, 200000)});
+    return cases;
+  }
+} // namespace
+
+int main(int argc, char** argv)
+{
+  std::vector<input> files;
+  for (int i = 1 ; i < argc ; ++i)
+  {
+    std::ifstream in(argv[i], std::ios::binary);
+    if (!in)
+    {
+      std::cerr << "cannot read " << argv[i] << '\n';
+      return 2;
+    }
+    std::ostringstream text;
+    text << in.rdbuf();
+    files.push_back({argv[i], text.str()});
+  }
+  std::vector<input> inputs = files;
+  for (input& c : edge_cases(files))
+  {
+    inputs.push_back(std::move(c));
+  }
+
+  cwt::thread_pool pool(4);
+  std::size_t failures = 0;
+  for (const char* kernels : {"scalar", "sse2", "avx2"})
+  {
+    if (!cwt::simd::use_kernels(kernels))
+    {
+      std::cout << kernels << ": not available, skipped\n";
+      continue;
+    }
+    for (const input& in : inputs)
+    {
+      const scanned expected = capture([&in]() { return cwt::scanner(in.text).scan_stream(); });
+      const scanned serial = capture([&in]() { return cwt::fast_scanner(in.text).scan_stream(); });
+      const scanned chunked = capture([&in, &pool]() { return cwt::fast_scanner(in.text).scan_stream(pool); });
+      for (const auto& [how, actual] : {std::pair<const char*, const scanned*>{"serial", &serial}, {"chunked", &chunked}})
+      {
+        const std::string difference = compare(expected, *actual);
+        if (!difference.empty())
+        {
+          ++failures;
+          std::cout << kernels << ", " << how << ", " << in.name << ": " << difference << '\n';
+        }
+      }
+    }
+    std::cout << kernels << ": " << inputs.size() << " inputs compared\n";
+  }
+  if (failures)
+  {
+    std::cout << failures << " mismatches\n";
+    return 1;
+  }
+  return 0;
+}